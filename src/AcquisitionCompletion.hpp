@@ -30,6 +30,8 @@ class AcquisitionCompletion final {
     AcquisitionCompletion(F cancelFunc)
         : AcquisitionCompletion(cancelFunc, [](std::string const &) {}) {}
 
+    void Log(std::string const &message) { logFunction(message); }
+
     std::shared_future<std::vector<std::string>> GetCompletion() {
         return completion;
     }
@@ -5,15 +5,21 @@
 #include "DataStream.hpp"
 #include "FIFOAcquisition.hpp"
 #include "MetadataJson.hpp"
+#include "PhasorFileWriter.hpp"
 #include "SPCFileWriter.hpp"
 #include "UniqueFileName.h"
 
+#include <FLIMEvents/MemoryArena.hpp>
+#include <FLIMEvents/SpatialBinner.hpp>
+
 #include <bitset>
 #include <chrono>
 #include <cmath>
 #include <fstream>
 #include <future>
+#include <stdexcept>
 #include <string>
+#include <utility>
 #include <vector>
 
 // C++ state that we store in our device private data. Members are kept
@@ -101,6 +107,17 @@ static OScDev_RichError *ConfigureMarkers(OScDev_Device *device) {
     return SetMarkerPolarities(data->moduleNr, enabled, risingEdgeActive);
 }
 
+// Return bit if the marker is assigned and enabled, or else UINT32_MAX (which
+// the pixellators take to mean that the marker is not used)
+static uint32_t GetEnabledMarkerBit(OScDev_Device *device, uint32_t bit) {
+    auto data = GetData(device);
+    if (bit >= NUM_MARKER_BITS ||
+        data->markerActiveEdges[bit] == MarkerPolarityDisabled) {
+        return UINT32_MAX;
+    }
+    return bit;
+}
+
 static OScDev_RichError *CheckMarkers(OScDev_Device *device) {
     auto data = GetData(device);
 
@@ -121,7 +138,29 @@ static OScDev_RichError *CheckMarkers(OScDev_Device *device) {
         }
     }
 
-    // Line marker must be assigned and enabled (until we support pixel marker)
+    // Pixel marker (in pixel marker mode) or line marker (otherwise) must be
+    // assigned and enabled; line and frame markers are optional in pixel
+    // marker mode, where they are used to resynchronize.
+    if (data->pixelMappingMode == PixelMappingModePixelMarkers) {
+        if (data->pixelMarkerBit >= NUM_MARKER_BITS) {
+            return OScDev_Error_Create("Pixel marker is required");
+        }
+        if (data->markerActiveEdges[data->pixelMarkerBit] ==
+            MarkerPolarityDisabled) {
+            return OScDev_Error_Create("Pixel marker is required");
+        }
+        return OScDev_RichError_OK;
+    }
+
+    if (data->frameMarkerResync) {
+        if (data->frameMarkerBit >= NUM_MARKER_BITS ||
+            data->markerActiveEdges[data->frameMarkerBit] ==
+                MarkerPolarityDisabled) {
+            return OScDev_Error_Create(
+                "Frame marker is required for frame marker resync");
+        }
+    }
+
     if (data->lineMarkerBit >= NUM_MARKER_BITS) {
         return OScDev_Error_Create("Line marker is required");
     }
@@ -157,6 +196,22 @@ static OScDev_RichError *WaitForCompletionAndLog(OScDev_Device *device,
     }
 }
 
+static void LogBufferPoolStats(OScDev_Device *device,
+                               EventBufferPoolStats const &stats) {
+    OScDev_Log_Info(
+        device,
+        ("Event buffers: " + std::to_string(stats.allocationCount) +
+         " allocated; peak " + std::to_string(stats.peakOutstandingCount) +
+         " in use")
+            .c_str());
+    if (stats.dropCount > 0) {
+        OScDev_Log_Error(
+            device, ("Event buffers exhausted " +
+                     std::to_string(stats.dropCount) + " time(s); data lost")
+                        .c_str());
+    }
+}
+
 extern "C" OScDev_RichError *StartAcquisition(OScDev_Device *device,
                                               OScDev_Acquisition *acq) {
     OScDev_Log_Info(device, "Starting acquisition setup");
@@ -183,7 +238,13 @@ extern "C" OScDev_RichError *StartAcquisition(OScDev_Device *device,
     err = CheckMarkers(device);
     if (err)
         return err;
-    uint32_t lineMarkerBit = GetData(device)->lineMarkerBit;
+    uint32_t pixelMarkerBit = GetData(device)->pixelMarkerBit;
+    // Line and frame markers are optional in pixel marker mode; if disabled,
+    // they must not be expected by the pixellator
+    uint32_t lineMarkerBit =
+        GetEnabledMarkerBit(device, GetData(device)->lineMarkerBit);
+    uint32_t frameMarkerBit =
+        GetEnabledMarkerBit(device, GetData(device)->frameMarkerBit);
 
     uint32_t nFrames = OScDev_Acquisition_GetNumberOfFrames(acq);
     double pixelRateHz = OScDev_Acquisition_GetPixelRate(acq);
@@ -196,22 +257,55 @@ extern "C" OScDev_RichError *StartAcquisition(OScDev_Device *device,
     }
 
     bool accumulateIntensity = GetData(device)->accumulateIntensity;
+    bool meanArrivalTime = GetData(device)->meanArrivalTimeImage;
 
-    bool lineMarkersAtLineEnds;
+    bool lineMarkersAtLineEnds = false;
+    bool usePixelMarkers = false;
+    bool bidirectional = false;
+    bool sinusoidal = false;
     switch (GetData(device)->pixelMappingMode) {
     case PixelMappingModeLineStartMarkers:
-        lineMarkersAtLineEnds = false;
         break;
     case PixelMappingModeLineEndMarkers:
         lineMarkersAtLineEnds = true;
         break;
+    case PixelMappingModePixelMarkers:
+        usePixelMarkers = true;
+        break;
+    case PixelMappingModeBidirectionalLineStartMarkers:
+        bidirectional = true;
+        break;
+    case PixelMappingModeSinusoidalLineStartMarkers:
+        sinusoidal = true;
+        break;
+    case PixelMappingModeSinusoidalBidirectionalLineStartMarkers:
+        sinusoidal = true;
+        bidirectional = true;
+        break;
     default:
         return OScDev_Error_Create("Unimplemented line marker mode");
     }
+    // Frame markers (if enabled) are used for resynchronization in pixel
+    // marker mode, and optionally in line marker modes. The pixellators take
+    // any bit >= 16 (not NUM_MARKER_BITS) to mean no frame marker.
+    bool frameMarkerResync =
+        usePixelMarkers || GetData(device)->frameMarkerResync;
+    uint32_t resyncFrameMarkerBit =
+        frameMarkerResync ? frameMarkerBit : UINT32_MAX;
     double lineDelayPixels = GetData(device)->lineDelayPx;
+    double fillFraction =
+        sinusoidal ? GetData(device)->sinusoidalFillFraction : 0.0;
     std::string fileNamePrefix(
         GetData(device)->saveFiles ? GetData(device)->fileNamePrefix : "");
     bool compressHistograms = GetData(device)->compressHistograms;
+    uint32_t histogramTimeBits = GetData(device)->histogramTimeBits;
+    uint32_t histogramBinning = GetData(device)->histogramBinning;
+    uint32_t microtimeGateBegin = GetData(device)->microtimeGateBegin;
+    uint32_t microtimeGateEnd = GetData(device)->microtimeGateEnd;
+    if (microtimeGateBegin >= microtimeGateEnd) {
+        return OScDev_Error_Create("Microtime gate is empty");
+    }
+    uint32_t phasorHarmonic = GetData(device)->phasorHarmonic;
     uint16_t senderPort = GetData(device)->senderPort;
     bool checkSync = GetData(device)->checkSyncBeforeAcq;
 
@@ -233,6 +327,19 @@ extern "C" OScDev_RichError *StartAcquisition(OScDev_Device *device,
     if (lineMarkersAtLineEnds) {
         lineDelay -= lineTime;
     }
+    uint32_t pixelTime =
+        PixelsToMacroTime(1.0, pixelRateHz, macroTimeUnitsTenthNs);
+
+    LineScanOptions lineScan;
+    lineScan.bidirectional = bidirectional;
+    if (sinusoidal) {
+        try {
+            lineScan.pixelTable =
+                MakeSinusoidalPixelTable(width, lineTime, fillFraction);
+        } catch (std::invalid_argument const &e) {
+            return OScDev_Error_Create(e.what());
+        }
+    }
 
     auto completion = std::make_shared<AcquisitionCompletion>(
         [acqState]() mutable { RequestAcquisitionStop(acqState); },
@@ -248,11 +355,12 @@ extern "C" OScDev_RichError *StartAcquisition(OScDev_Device *device,
     std::shared_ptr<SPCFileWriter> spcWriter;
     std::shared_ptr<SDTWriter> sdtWriter;
     std::shared_ptr<DataSender> dataSender;
+    std::shared_ptr<PhasorFileWriter> phasorWriter;
 
     if (!fileNamePrefix.empty()) {
-        const char *const extensions[] = {".spc", ".sdt", ".json"};
+        const char *const extensions[] = {".spc", ".sdt", ".json", ".phasor"};
         char temp[512];
-        if (UniqueFileName(fileNamePrefix.c_str(), extensions, 3, temp,
+        if (UniqueFileName(fileNamePrefix.c_str(), extensions, 4, temp,
                            sizeof(temp))) {
             std::string uniquePrefix = temp;
 
@@ -263,11 +371,19 @@ extern "C" OScDev_RichError *StartAcquisition(OScDev_Device *device,
                 uniquePrefix + ".sdt",
                 static_cast<unsigned>(channelMask.count()), completion);
             sdtWriter->SetPreacquisitionData(
-                GetData(device)->moduleNr, 8, width, height,
-                compressHistograms, pixelRateHz, false,
-                GetData(device)->pixelMarkerBit < NUM_MARKER_BITS,
-                GetData(device)->lineMarkerBit < NUM_MARKER_BITS,
-                GetData(device)->frameMarkerBit < NUM_MARKER_BITS);
+                GetData(device)->moduleNr, histogramTimeBits,
+                microtimeGateBegin, microtimeGateEnd,
+                SpatialBinner::GetBinnedSize(width, histogramBinning),
+                SpatialBinner::GetBinnedSize(height, histogramBinning),
+                compressHistograms, pixelRateHz, usePixelMarkers,
+                pixelMarkerBit < NUM_MARKER_BITS,
+                lineMarkerBit < NUM_MARKER_BITS,
+                frameMarkerBit < NUM_MARKER_BITS);
+
+            if (phasorHarmonic > 0) {
+                phasorWriter = std::make_shared<PhasorFileWriter>(
+                    uniquePrefix + ".phasor", completion);
+            }
 
             MetadataJsonWriter jsonWriter(uniquePrefix + ".json");
             jsonWriter.SetChannelMask(channelMask);
@@ -275,10 +391,16 @@ extern "C" OScDev_RichError *StartAcquisition(OScDev_Device *device,
             jsonWriter.SetPixelRateHz(pixelRateHz);
             jsonWriter.SetMacrotimeUnitsTenthNs(macroTimeUnitsTenthNs);
             jsonWriter.SetLineDelayAndTime(lineDelay, lineTime);
-            jsonWriter.SetMarkerSettings(false, NUM_MARKER_BITS,
-                                         GetData(device)->pixelMarkerBit,
-                                         GetData(device)->lineMarkerBit,
-                                         GetData(device)->frameMarkerBit);
+            jsonWriter.SetLineScan(bidirectional, fillFraction);
+            jsonWriter.SetFrameMarkerResync(frameMarkerResync);
+            jsonWriter.SetHistogramTimeBits(histogramTimeBits);
+            jsonWriter.SetHistogramBinning(histogramBinning);
+            jsonWriter.SetMicrotimeGate(microtimeGateBegin, microtimeGateEnd,
+                                        4096);
+            jsonWriter.SetPhasorHarmonic(phasorWriter ? phasorHarmonic : 0);
+            jsonWriter.SetMarkerSettings(usePixelMarkers, NUM_MARKER_BITS,
+                                         pixelMarkerBit, lineMarkerBit,
+                                         frameMarkerBit);
             jsonWriter.Save();
         }
     }
@@ -289,14 +411,19 @@ extern "C" OScDev_RichError *StartAcquisition(OScDev_Device *device,
             completion);
     }
 
-    std::shared_ptr<EventStream<BHSPCEvent>> stream;
+    std::shared_ptr<SPSCEventStream<BHSPCEvent>> stream;
     try {
         completion->AddProcess("ProcessingSetup");
         auto stream_and_done = SetUpProcessing(
             width, height, nFrames, channelMask, accumulateIntensity,
-            lineDelay, lineTime, lineMarkerBit, acq,
+            meanArrivalTime, histogramTimeBits, histogramBinning,
+            microtimeGateBegin, microtimeGateEnd, usePixelMarkers, lineDelay,
+            lineTime, pixelTime, pixelMarkerBit, lineMarkerBit,
+            resyncFrameMarkerBit,
+            std::move(lineScan), acq,
             [acqState]() mutable { RequestAcquisitionStop(acqState); },
-            spcWriter, sdtWriter, dataSender, completion);
+            spcWriter, sdtWriter, dataSender, phasorHarmonic, phasorWriter,
+            completion);
         stream = std::get<0>(stream_and_done);
         acqState->eventPumpingFinish = std::move(std::get<1>(stream_and_done));
         completion->HandleFinish("ProcessingSetup");
@@ -317,7 +444,48 @@ extern "C" OScDev_RichError *StartAcquisition(OScDev_Device *device,
     }
 
     // 48k events = ~5 ms at 10M events/s
-    auto pool = std::make_shared<EventBufferPool<BHSPCEvent>>(48 * 1024);
+    // At most 1024 buffers (192 MiB; ~5 s at 10M events/s) are used to hold
+    // data not yet processed. Beyond that, data is dropped (and processing
+    // will see a data lost event) rather than consuming unbounded memory.
+    // As many buffers as fit in the configured preallocation are allocated
+    // (and prefaulted, and optionally locked) up front so that the start of
+    // acquisition is not slowed by allocation and page faults; any further
+    // buffers are allocated on demand.
+    std::size_t const bufferEvents = 48 * 1024;
+    std::size_t const maxBuffers = 1024;
+    std::size_t const preallocBytes =
+        std::size_t(GetData(device)->eventBufferPreallocationMiB) << 20;
+    bool const lockBuffers = GetData(device)->lockEventBuffers;
+    std::shared_ptr<MemoryArena> arena;
+    if (preallocBytes > 0) {
+        try {
+            arena = std::make_shared<MemoryArena>(preallocBytes, lockBuffers);
+        } catch (std::bad_alloc const &) {
+            OScDev_Log_Warning(device, "Cannot preallocate event buffers; "
+                                       "buffers will be allocated on demand");
+        }
+    }
+    std::shared_ptr<EventBufferPool<BHSPCEvent>> pool;
+    if (arena) {
+        pool = std::make_shared<EventBufferPool<BHSPCEvent>>(
+            bufferEvents, arena, maxBuffers, EventBufferPoolPolicy::Drop);
+        OScDev_Log_Info(
+            device,
+            ("Preallocated " + std::to_string(arena->GetSize() >> 20) +
+             " MiB of event buffers (" +
+             std::to_string(pool->GetArenaBufferCount()) +
+             " buffers; huge pages: " +
+             (arena->IsUsingHugePages() ? "yes" : "no") +
+             "; locked: " + (arena->IsLocked() ? "yes" : "no") + ")")
+                .c_str());
+        if (lockBuffers && !arena->IsLocked()) {
+            OScDev_Log_Warning(
+                device, "Cannot lock event buffers in physical memory");
+        }
+    } else {
+        pool = std::make_shared<EventBufferPool<BHSPCEvent>>(
+            bufferEvents, 0, maxBuffers, EventBufferPoolPolicy::Drop);
+    }
 
     auto err_and_finish = StartAcquisitionStandardFIFO(
         GetData(device)->moduleNr, pool, stream, stopRequested, completion);
@@ -340,10 +508,11 @@ extern "C" OScDev_RichError *StartAcquisition(OScDev_Device *device,
 
     // Arrange to log the end of acquisition.
     acqState->logStopFinish =
-        std::async(std::launch::async, [device, acqState] {
+        std::async(std::launch::async, [device, acqState, pool] {
             OScDev_Log_Info(device, "Waiting for acquisition to finish");
             OScDev_Error_Destroy(
                 WaitForCompletionAndLog(device, acqState, "Acquisition"));
+            LogBufferPoolStats(device, pool->GetStats());
         });
 
     return 0;
@@ -51,9 +51,16 @@ static void PopulateDefaultParameters(struct BH_PrivateData *data) {
 
     data->pixelMappingMode = PixelMappingModeLineStartMarkers;
     data->lineDelayPx = 0.0;
+    data->sinusoidalFillFraction = 1.0;
     strcpy(data->fileNamePrefix, "OpenScan-BHSPC");
+    data->histogramTimeBits = 8;
+    data->histogramBinning = 1;
+    data->microtimeGateBegin = 0;
+    data->microtimeGateEnd = 4096;
     data->senderPort = 0;
     data->checkSyncBeforeAcq = true;
+    data->eventBufferPreallocationMiB = 32;
+    data->lockEventBuffers = false;
 }
 
 static OScDev_RichError *EnsureFLIMBoardInitialized(void) {
@@ -254,7 +261,12 @@ static OScDev_Error BH_GetPixelRates(OScDev_Device *device,
 
 static OScDev_Error BH_GetNumberOfChannels(OScDev_Device *device,
                                            uint32_t *nChannels) {
+    // Intensity, then mean arrival time and phasor G and S if enabled
     *nChannels = 1;
+    if (GetData(device)->meanArrivalTimeImage)
+        *nChannels += 1;
+    if (GetData(device)->phasorHarmonic > 0)
+        *nChannels += 2;
     return OScDev_OK;
 }
 
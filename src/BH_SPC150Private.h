@@ -32,7 +32,13 @@ enum ScanMarkerType {
 enum PixelMappingMode {
     PixelMappingModeLineStartMarkers,
     PixelMappingModeLineEndMarkers,
-    // In future, add pixel marker modes
+    PixelMappingModePixelMarkers, // Line/frame markers optional, for resync
+    // Bidirectional modes: line marker at start of forward line, each
+    // followed by a return line
+    PixelMappingModeBidirectionalLineStartMarkers,
+    // Sinusoidal modes: resonant scanner (see sinusoidalFillFraction)
+    PixelMappingModeSinusoidalLineStartMarkers,
+    PixelMappingModeSinusoidalBidirectionalLineStartMarkers,
     PixelMappingModeNumValues,
 };
 
@@ -42,6 +48,8 @@ struct BH_PrivateData {
     uint16_t channelMask;
 
     bool accumulateIntensity;
+    // Send mean arrival time image as a second channel
+    bool meanArrivalTimeImage;
 
     // External marker configuration
     enum MarkerPolarity markerActiveEdges[NUM_MARKER_BITS];
@@ -51,18 +59,43 @@ struct BH_PrivateData {
 
     // Pixel assignment configuration
     enum PixelMappingMode pixelMappingMode;
+    bool frameMarkerResync; // Start frames on frame markers (line modes)
     double lineDelayPx; // Delay of photons relative to markers
+    // Fraction of line time (centered) used for pixels in sinusoidal modes
+    double sinusoidalFillFraction;
 
     bool saveFiles;
     char fileNamePrefix[OScDev_MAX_STR_SIZE];
 
     bool compressHistograms;
 
+    // Time bits of FLIM histograms: 6, 8, 10, or 12 (of the 12-bit ADC)
+    uint32_t histogramTimeBits;
+
+    // FLIM histograms sum bins of this many pixels squared (1 = no binning)
+    uint32_t histogramBinning;
+
+    // Photons with microtime (ADC value) outside [begin, end) are discarded
+    // before any image or histogram is formed
+    uint32_t microtimeGateBegin;
+    uint32_t microtimeGateEnd;
+
+    // Harmonic for the phasor G and S images (sent as channels after the
+    // intensity and mean arrival time images) and the saved phasor image
+    // (.phasor file); no phasor iff 0
+    uint32_t phasorHarmonic;
+
     // Port number on local host to which UDP messages are sent
     uint16_t senderPort;
 
     bool checkSyncBeforeAcq;
 
+    // Event buffers preallocated (and prefaulted) before acquisition, in MiB
+    // of working set; 0 to allocate all buffers on demand
+    uint32_t eventBufferPreallocationMiB;
+    // Lock preallocated event buffers in physical memory
+    bool lockEventBuffers;
+
     // C++ data for rate counter monitoring. Manually initialized on device
     // open; deleted on device close.
     struct RateCounts *rates;
@@ -83,6 +83,40 @@ static OScDev_SettingImpl SettingImpl_IntensityImagesCumulative = {
     .SetBool = SetIntensityImagesCumulative,
 };
 
+static OScDev_Error GetMeanArrivalTimeImage(OScDev_Setting *setting,
+                                            bool *value) {
+    *value = GetSettingDeviceData(setting)->meanArrivalTimeImage;
+    return OScDev_OK;
+}
+
+static OScDev_Error SetMeanArrivalTimeImage(OScDev_Setting *setting,
+                                            bool value) {
+    GetSettingDeviceData(setting)->meanArrivalTimeImage = value;
+    return OScDev_OK;
+}
+
+static OScDev_SettingImpl SettingImpl_MeanArrivalTimeImage = {
+    .GetBool = GetMeanArrivalTimeImage,
+    .SetBool = SetMeanArrivalTimeImage,
+};
+
+static OScDev_Error GetFrameMarkerResync(OScDev_Setting *setting,
+                                         bool *value) {
+    *value = GetSettingDeviceData(setting)->frameMarkerResync;
+    return OScDev_OK;
+}
+
+static OScDev_Error SetFrameMarkerResync(OScDev_Setting *setting,
+                                         bool value) {
+    GetSettingDeviceData(setting)->frameMarkerResync = value;
+    return OScDev_OK;
+}
+
+static OScDev_SettingImpl SettingImpl_FrameMarkerResync = {
+    .GetBool = GetFrameMarkerResync,
+    .SetBool = SetFrameMarkerResync,
+};
+
 struct MarkerActiveEdgeSettingData {
     OScDev_Device *device;
     uint32_t markerBit;
@@ -271,6 +305,18 @@ static OScDev_Error GetPixelMappingModeNameForValue(OScDev_Setting *setting,
     case PixelMappingModeLineEndMarkers:
         strcpy(name, "LineEndMarkers");
         break;
+    case PixelMappingModePixelMarkers:
+        strcpy(name, "PixelMarkers");
+        break;
+    case PixelMappingModeBidirectionalLineStartMarkers:
+        strcpy(name, "BidirectionalLineStartMarkers");
+        break;
+    case PixelMappingModeSinusoidalLineStartMarkers:
+        strcpy(name, "SinusoidalLineStartMarkers");
+        break;
+    case PixelMappingModeSinusoidalBidirectionalLineStartMarkers:
+        strcpy(name, "SinusoidalBidirectionalLineStartMarkers");
+        break;
     default:
         return OScDev_Error_Illegal_Argument;
     }
@@ -284,6 +330,15 @@ static OScDev_Error GetPixelMappingModeValueForName(OScDev_Setting *setting,
         *value = PixelMappingModeLineStartMarkers;
     } else if (strcmp(name, "LineEndMarkers") == 0) {
         *value = PixelMappingModeLineEndMarkers;
+    } else if (strcmp(name, "PixelMarkers") == 0) {
+        *value = PixelMappingModePixelMarkers;
+    } else if (strcmp(name, "BidirectionalLineStartMarkers") == 0) {
+        *value = PixelMappingModeBidirectionalLineStartMarkers;
+    } else if (strcmp(name, "SinusoidalLineStartMarkers") == 0) {
+        *value = PixelMappingModeSinusoidalLineStartMarkers;
+    } else if (strcmp(name, "SinusoidalBidirectionalLineStartMarkers") ==
+               0) {
+        *value = PixelMappingModeSinusoidalBidirectionalLineStartMarkers;
     } else {
         return OScDev_Error_Illegal_Argument;
     }
@@ -335,6 +390,32 @@ static OScDev_SettingImpl SettingImpl_LineDelayPx = {
     .SetFloat64 = SetLineDelayPx,
 };
 
+static OScDev_Error GetSinusoidalFillFractionRange(OScDev_Setting *setting,
+                                                   double *min, double *max) {
+    *min = 0.01;
+    *max = 1.0;
+    return OScDev_OK;
+}
+
+static OScDev_Error GetSinusoidalFillFraction(OScDev_Setting *setting,
+                                              double *value) {
+    *value = GetSettingDeviceData(setting)->sinusoidalFillFraction;
+    return OScDev_OK;
+}
+
+static OScDev_Error SetSinusoidalFillFraction(OScDev_Setting *setting,
+                                              double value) {
+    GetSettingDeviceData(setting)->sinusoidalFillFraction = value;
+    return OScDev_OK;
+}
+
+static OScDev_SettingImpl SettingImpl_SinusoidalFillFraction = {
+    .GetNumericConstraintType = GetNumericConstraintTypeImpl_Range,
+    .GetFloat64Range = GetSinusoidalFillFractionRange,
+    .GetFloat64 = GetSinusoidalFillFraction,
+    .SetFloat64 = SetSinusoidalFillFraction,
+};
+
 static OScDev_Error GetCheckSync(OScDev_Setting *setting, bool *value) {
     *value = GetSettingDeviceData(setting)->checkSyncBeforeAcq;
     return OScDev_OK;
@@ -413,6 +494,207 @@ static OScDev_SettingImpl SettingImpl_SDTCompression = {
     .SetBool = SetSDTCompression,
 };
 
+// Histogram time bins are offered as the ADC resolutions supported by BH
+// SPCM (and thus valid in SDT files): 2^(6 + 2 * value) bins.
+static OScDev_Error GetHistogramTimeBinsNumValues(OScDev_Setting *setting,
+                                                  uint32_t *count) {
+    *count = 4;
+    return OScDev_OK;
+}
+
+static OScDev_Error GetHistogramTimeBinsNameForValue(OScDev_Setting *setting,
+                                                     uint32_t value,
+                                                     char *name) {
+    if (value >= 4)
+        return OScDev_Error_Illegal_Argument;
+    snprintf(name, OScDev_MAX_STR_SIZE, "%u", 1u << (6 + 2 * value));
+    return OScDev_OK;
+}
+
+static OScDev_Error GetHistogramTimeBinsValueForName(OScDev_Setting *setting,
+                                                     uint32_t *value,
+                                                     const char *name) {
+    for (uint32_t v = 0; v < 4; ++v) {
+        char valueName[16];
+        snprintf(valueName, sizeof(valueName), "%u", 1u << (6 + 2 * v));
+        if (strcmp(name, valueName) == 0) {
+            *value = v;
+            return OScDev_OK;
+        }
+    }
+    return OScDev_Error_Illegal_Argument;
+}
+
+static OScDev_Error GetHistogramTimeBins(OScDev_Setting *setting,
+                                         uint32_t *value) {
+    *value = (GetSettingDeviceData(setting)->histogramTimeBits - 6) / 2;
+    return OScDev_OK;
+}
+
+static OScDev_Error SetHistogramTimeBins(OScDev_Setting *setting,
+                                         uint32_t value) {
+    GetSettingDeviceData(setting)->histogramTimeBits = 6 + 2 * value;
+    return OScDev_OK;
+}
+
+static OScDev_SettingImpl SettingImpl_HistogramTimeBins = {
+    .GetEnumNumValues = GetHistogramTimeBinsNumValues,
+    .GetEnumNameForValue = GetHistogramTimeBinsNameForValue,
+    .GetEnumValueForName = GetHistogramTimeBinsValueForName,
+    .GetEnum = GetHistogramTimeBins,
+    .SetEnum = SetHistogramTimeBins,
+};
+
+static OScDev_Error GetHistogramBinning(OScDev_Setting *setting,
+                                        int32_t *value) {
+    *value = GetSettingDeviceData(setting)->histogramBinning;
+    return OScDev_OK;
+}
+
+static OScDev_Error SetHistogramBinning(OScDev_Setting *setting,
+                                        int32_t value) {
+    if (value < 1)
+        value = 1;
+    if (value > 16)
+        value = 16;
+    GetSettingDeviceData(setting)->histogramBinning = value;
+    return OScDev_OK;
+}
+
+static OScDev_SettingImpl SettingImpl_HistogramBinning = {
+    .GetInt32 = GetHistogramBinning,
+    .SetInt32 = SetHistogramBinning,
+};
+
+// The microtime gate is in ADC units (0-4096); an empty gate is rejected when
+// the acquisition is armed.
+static OScDev_Error GetMicrotimeGateBeginRange(OScDev_Setting *setting,
+                                               int32_t *min, int32_t *max) {
+    *min = 0;
+    *max = 4095;
+    return OScDev_OK;
+}
+
+static OScDev_Error GetMicrotimeGateBegin(OScDev_Setting *setting,
+                                          int32_t *value) {
+    *value = GetSettingDeviceData(setting)->microtimeGateBegin;
+    return OScDev_OK;
+}
+
+static OScDev_Error SetMicrotimeGateBegin(OScDev_Setting *setting,
+                                          int32_t value) {
+    if (value < 0)
+        value = 0;
+    if (value > 4095)
+        value = 4095;
+    GetSettingDeviceData(setting)->microtimeGateBegin = value;
+    return OScDev_OK;
+}
+
+static OScDev_SettingImpl SettingImpl_MicrotimeGateBegin = {
+    .GetNumericConstraintType = GetNumericConstraintTypeImpl_Range,
+    .GetInt32Range = GetMicrotimeGateBeginRange,
+    .GetInt32 = GetMicrotimeGateBegin,
+    .SetInt32 = SetMicrotimeGateBegin,
+};
+
+static OScDev_Error GetMicrotimeGateEndRange(OScDev_Setting *setting,
+                                             int32_t *min, int32_t *max) {
+    *min = 1;
+    *max = 4096;
+    return OScDev_OK;
+}
+
+static OScDev_Error GetMicrotimeGateEnd(OScDev_Setting *setting,
+                                        int32_t *value) {
+    *value = GetSettingDeviceData(setting)->microtimeGateEnd;
+    return OScDev_OK;
+}
+
+static OScDev_Error SetMicrotimeGateEnd(OScDev_Setting *setting,
+                                        int32_t value) {
+    if (value < 1)
+        value = 1;
+    if (value > 4096)
+        value = 4096;
+    GetSettingDeviceData(setting)->microtimeGateEnd = value;
+    return OScDev_OK;
+}
+
+static OScDev_SettingImpl SettingImpl_MicrotimeGateEnd = {
+    .GetNumericConstraintType = GetNumericConstraintTypeImpl_Range,
+    .GetInt32Range = GetMicrotimeGateEndRange,
+    .GetInt32 = GetMicrotimeGateEnd,
+    .SetInt32 = SetMicrotimeGateEnd,
+};
+
+static OScDev_Error GetPhasorHarmonic(OScDev_Setting *setting,
+                                      int32_t *value) {
+    *value = GetSettingDeviceData(setting)->phasorHarmonic;
+    return OScDev_OK;
+}
+
+static OScDev_Error SetPhasorHarmonic(OScDev_Setting *setting,
+                                      int32_t value) {
+    if (value < 0)
+        value = 0;
+    GetSettingDeviceData(setting)->phasorHarmonic = value;
+    return OScDev_OK;
+}
+
+static OScDev_SettingImpl SettingImpl_PhasorHarmonic = {
+    .GetInt32 = GetPhasorHarmonic,
+    .SetInt32 = SetPhasorHarmonic,
+};
+
+// At most 1024 buffers of 192 KiB are used (see StartAcquisition())
+static OScDev_Error GetEventBufferPreallocationRange(OScDev_Setting *setting,
+                                                     int32_t *min,
+                                                     int32_t *max) {
+    *min = 0;
+    *max = 192;
+    return OScDev_OK;
+}
+
+static OScDev_Error GetEventBufferPreallocation(OScDev_Setting *setting,
+                                                int32_t *value) {
+    *value = GetSettingDeviceData(setting)->eventBufferPreallocationMiB;
+    return OScDev_OK;
+}
+
+static OScDev_Error SetEventBufferPreallocation(OScDev_Setting *setting,
+                                                int32_t value) {
+    if (value < 0)
+        value = 0;
+    if (value > 192)
+        value = 192;
+    GetSettingDeviceData(setting)->eventBufferPreallocationMiB = value;
+    return OScDev_OK;
+}
+
+static OScDev_SettingImpl SettingImpl_EventBufferPreallocation = {
+    .GetNumericConstraintType = GetNumericConstraintTypeImpl_Range,
+    .GetInt32Range = GetEventBufferPreallocationRange,
+    .GetInt32 = GetEventBufferPreallocation,
+    .SetInt32 = SetEventBufferPreallocation,
+};
+
+static OScDev_Error GetLockEventBuffers(OScDev_Setting *setting,
+                                        bool *value) {
+    *value = GetSettingDeviceData(setting)->lockEventBuffers;
+    return OScDev_OK;
+}
+
+static OScDev_Error SetLockEventBuffers(OScDev_Setting *setting, bool value) {
+    GetSettingDeviceData(setting)->lockEventBuffers = value;
+    return OScDev_OK;
+}
+
+static OScDev_SettingImpl SettingImpl_LockEventBuffers = {
+    .GetBool = GetLockEventBuffers,
+    .SetBool = SetLockEventBuffers,
+};
+
 struct RateCounterData {
     OScDev_Device *device;
     int index;
@@ -468,6 +750,14 @@ OScDev_Error BH_MakeSettings(OScDev_Device *device,
         goto error;
     OScDev_PtrArray_Append(*settings, accumulateIntensity);
 
+    OScDev_Setting *meanArrivalTimeImage;
+    err = OScDev_Error_AsRichError(OScDev_Setting_Create(
+        &meanArrivalTimeImage, "MeanArrivalTimeImage", OScDev_ValueType_Bool,
+        &SettingImpl_MeanArrivalTimeImage, device));
+    if (err)
+        goto error;
+    OScDev_PtrArray_Append(*settings, meanArrivalTimeImage);
+
     for (int i = 0; i < NUM_MARKER_BITS; ++i) {
         struct MarkerActiveEdgeSettingData *data =
             calloc(1, sizeof(struct MarkerActiveEdgeSettingData));
@@ -514,6 +804,14 @@ OScDev_Error BH_MakeSettings(OScDev_Device *device,
         goto error;
     OScDev_PtrArray_Append(*settings, pixelMappingMode);
 
+    OScDev_Setting *frameMarkerResync;
+    err = OScDev_Error_AsRichError(OScDev_Setting_Create(
+        &frameMarkerResync, "FrameMarkerResync", OScDev_ValueType_Bool,
+        &SettingImpl_FrameMarkerResync, device));
+    if (err)
+        goto error;
+    OScDev_PtrArray_Append(*settings, frameMarkerResync);
+
     OScDev_Setting *lineDelayPx;
     err = OScDev_Error_AsRichError(OScDev_Setting_Create(
         &lineDelayPx, "LineDelay_px", OScDev_ValueType_Float64,
@@ -522,6 +820,15 @@ OScDev_Error BH_MakeSettings(OScDev_Device *device,
         goto error;
     OScDev_PtrArray_Append(*settings, lineDelayPx);
 
+    OScDev_Setting *sinusoidalFillFraction;
+    err = OScDev_Error_AsRichError(OScDev_Setting_Create(
+        &sinusoidalFillFraction, "SinusoidalFillFraction",
+        OScDev_ValueType_Float64, &SettingImpl_SinusoidalFillFraction,
+        device));
+    if (err)
+        goto error;
+    OScDev_PtrArray_Append(*settings, sinusoidalFillFraction);
+
     OScDev_Setting *checkSync;
     err = OScDev_Error_AsRichError(OScDev_Setting_Create(
         &checkSync, "CheckSyncBeforeAcquisition", OScDev_ValueType_Bool,
@@ -562,6 +869,63 @@ OScDev_Error BH_MakeSettings(OScDev_Device *device,
         goto error;
     OScDev_PtrArray_Append(*settings, sdtCompression);
 
+    OScDev_Setting *histogramTimeBins;
+    err = OScDev_Error_AsRichError(OScDev_Setting_Create(
+        &histogramTimeBins, "HistogramTimeBins", OScDev_ValueType_Enum,
+        &SettingImpl_HistogramTimeBins, device));
+    if (err)
+        goto error;
+    OScDev_PtrArray_Append(*settings, histogramTimeBins);
+
+    OScDev_Setting *histogramBinning;
+    err = OScDev_Error_AsRichError(OScDev_Setting_Create(
+        &histogramBinning, "HistogramSpatialBinning", OScDev_ValueType_Int32,
+        &SettingImpl_HistogramBinning, device));
+    if (err)
+        goto error;
+    OScDev_PtrArray_Append(*settings, histogramBinning);
+
+    OScDev_Setting *microtimeGateBegin;
+    err = OScDev_Error_AsRichError(OScDev_Setting_Create(
+        &microtimeGateBegin, "MicrotimeGateBegin", OScDev_ValueType_Int32,
+        &SettingImpl_MicrotimeGateBegin, device));
+    if (err)
+        goto error;
+    OScDev_PtrArray_Append(*settings, microtimeGateBegin);
+
+    OScDev_Setting *microtimeGateEnd;
+    err = OScDev_Error_AsRichError(OScDev_Setting_Create(
+        &microtimeGateEnd, "MicrotimeGateEnd", OScDev_ValueType_Int32,
+        &SettingImpl_MicrotimeGateEnd, device));
+    if (err)
+        goto error;
+    OScDev_PtrArray_Append(*settings, microtimeGateEnd);
+
+    OScDev_Setting *phasorHarmonic;
+    err = OScDev_Error_AsRichError(OScDev_Setting_Create(
+        &phasorHarmonic, "PhasorHarmonic", OScDev_ValueType_Int32,
+        &SettingImpl_PhasorHarmonic, device));
+    if (err)
+        goto error;
+    OScDev_PtrArray_Append(*settings, phasorHarmonic);
+
+    OScDev_Setting *eventBufferPreallocation;
+    err = OScDev_Error_AsRichError(OScDev_Setting_Create(
+        &eventBufferPreallocation, "EventBufferPreallocationMiB",
+        OScDev_ValueType_Int32, &SettingImpl_EventBufferPreallocation,
+        device));
+    if (err)
+        goto error;
+    OScDev_PtrArray_Append(*settings, eventBufferPreallocation);
+
+    OScDev_Setting *lockEventBuffers;
+    err = OScDev_Error_AsRichError(OScDev_Setting_Create(
+        &lockEventBuffers, "LockEventBuffers", OScDev_ValueType_Bool,
+        &SettingImpl_LockEventBuffers, device));
+    if (err)
+        goto error;
+    OScDev_PtrArray_Append(*settings, lockEventBuffers);
+
     const char *rateCounters[] = {"Sync", "CFD", "TAC", "ADC"};
     for (int i = 0; i < 4; ++i) {
         struct RateCounterData *data =
@@ -1,21 +1,55 @@
 #include "DataStream.hpp"
 
+#include <FLIMEvents/AdaptiveHistogram.hpp>
 #include <FLIMEvents/BHDeviceEvent.hpp>
 #include <FLIMEvents/Histogram.hpp>
+#include <FLIMEvents/IntensityCounter.hpp>
 #include <FLIMEvents/LineClockPixellator.hpp>
+#include <FLIMEvents/MeanArrivalTime.hpp>
+#include <FLIMEvents/MicrotimeGate.hpp>
+#include <FLIMEvents/Phasor.hpp>
+#include <FLIMEvents/PixelClockPixellator.hpp>
 #include <FLIMEvents/PixelPhotonRouter.hpp>
+#include <FLIMEvents/SpatialBinner.hpp>
 #include <FLIMEvents/StreamBuffer.hpp>
 
+#include <algorithm>
+#include <cstdint>
 #include <memory>
+#include <vector>
 
 using SampleType = uint16_t;
 
 namespace {
-class IntensityImageSink : public HistogramProcessor<SampleType> {
+// Sends the intensity image as channel 0. The image comes either from an
+// intensity (0-bit) histogram or from a mean arrival time image; in the
+// latter case the mean arrival time is sent as channel 1.
+class IntensityImageSink : public HistogramProcessor<SampleType>,
+                           public MeanArrivalTimeProcessor {
     OScDev_Acquisition *acquisition;
     std::function<void(void)> stopFunc;
     std::shared_ptr<AcquisitionCompletion> downstream;
 
+    std::vector<SampleType> samples;
+
+    void SendFrame(uint32_t channel, SampleType const *data) {
+        // TODO OScDev_Acquisition_CallFrameCallback() parameter should be
+        // const
+        OScDev_Acquisition_CallFrameCallback(
+            acquisition, channel,
+            const_cast<void *>(reinterpret_cast<void const *>(data)));
+    }
+
+    void Finish() {
+        if (stopFunc) {
+            stopFunc();
+        }
+        if (downstream) {
+            downstream->HandleFinish("IntensityImage");
+            downstream.reset();
+        }
+    }
+
   public:
     IntensityImageSink(OScDev_Acquisition *acquisition,
                        std::function<void(void)> stopFunction,
@@ -37,26 +71,113 @@ class IntensityImageSink : public HistogramProcessor<SampleType> {
     }
 
     void HandleFrame(Histogram<SampleType> const &histogram) override {
+        SendFrame(0, histogram.Get());
+    }
+
+    void HandleFrame(MeanArrivalTimeImage const &image) override {
+        std::size_t const width = image.GetWidth();
+        std::size_t const n = width * image.GetHeight();
+        samples.resize(n);
+
+        uint32_t const *counts = image.GetCounts();
+        for (std::size_t i = 0; i < n; ++i) {
+            samples[i] = static_cast<SampleType>(
+                std::min<uint32_t>(counts[i], UINT16_MAX));
+        }
+        SendFrame(0, samples.data());
+
+        for (std::size_t i = 0; i < n; ++i) {
+            samples[i] = static_cast<SampleType>(
+                image.GetMeanTime(i % width, i / width) + 0.5);
+        }
+        SendFrame(1, samples.data());
+    }
+
+    void HandleFinish(Histogram<SampleType> &&, bool) override { Finish(); }
+
+    void HandleFinish(MeanArrivalTimeImage &&, bool) override { Finish(); }
+};
+
+// Sends the phasor coordinates G and S as channels firstChannel and
+// firstChannel + 1, mapping [-1, 1] to [1, 65535] (so 32768 is zero, as are
+// pixels with no photons). All events are then forwarded to downstream.
+class PhasorImageSink : public PhasorProcessor {
+    OScDev_Acquisition *acquisition;
+    uint32_t firstChannel;
+    std::shared_ptr<AcquisitionCompletion> completion;
+    std::shared_ptr<PhasorProcessor> downstream;
+
+    std::vector<SampleType> samples;
+
+    static SampleType ToSample(double value) noexcept {
+        double const clamped = std::max(-1.0, std::min(value, 1.0));
+        return static_cast<SampleType>(32768.5 + 32767.0 * clamped);
+    }
+
+    void SendFrame(uint32_t channel) {
         // TODO OScDev_Acquisition_CallFrameCallback() parameter should be
         // const
-        OScDev_Acquisition_CallFrameCallback(
-            acquisition, 0,
-            const_cast<void *>(
-                reinterpret_cast<void const *>(histogram.Get())));
+        OScDev_Acquisition_CallFrameCallback(acquisition, channel,
+                                             samples.data());
     }
 
-    void HandleFinish(Histogram<SampleType> &&, bool) override {
-        if (stopFunc) {
-            stopFunc();
+  public:
+    PhasorImageSink(OScDev_Acquisition *acquisition, uint32_t firstChannel,
+                    std::shared_ptr<AcquisitionCompletion> completion,
+                    std::shared_ptr<PhasorProcessor> downstream)
+        : acquisition(acquisition), firstChannel(firstChannel),
+          completion(completion), downstream(downstream) {
+        if (completion) {
+            completion->AddProcess("PhasorImage");
+        }
+    }
+
+    void HandleError(std::string const &message) override {
+        if (completion) {
+            completion->HandleError(
+                "Stopping phasor images due to error: " + message,
+                "PhasorImage");
+            completion.reset();
         }
         if (downstream) {
-            downstream->HandleFinish("IntensityImage");
+            downstream->HandleError(message);
+            downstream.reset();
+        }
+    }
+
+    void HandleFrame(PhasorImage const &image) override {
+        std::size_t const width = image.GetWidth();
+        std::size_t const n = width * image.GetHeight();
+        samples.resize(n);
+
+        for (std::size_t i = 0; i < n; ++i) {
+            samples[i] = ToSample(image.GetG(i % width, i / width));
+        }
+        SendFrame(firstChannel);
+
+        for (std::size_t i = 0; i < n; ++i) {
+            samples[i] = ToSample(image.GetS(i % width, i / width));
+        }
+        SendFrame(firstChannel + 1);
+
+        if (downstream) {
+            downstream->HandleFrame(image);
+        }
+    }
+
+    void HandleFinish(PhasorImage &&image, bool isCompleteFrame) override {
+        if (completion) {
+            completion->HandleFinish("PhasorImage");
+            completion.reset();
+        }
+        if (downstream) {
+            downstream->HandleFinish(std::move(image), isCompleteFrame);
             downstream.reset();
         }
     }
 };
 
-class HistogramSink : public HistogramProcessor<SampleType> {
+class HistogramSink : public AdaptiveHistogramProcessor {
     unsigned channel;
     std::shared_ptr<SDTWriter> sdtWriter;
     std::shared_ptr<DataSender> dataSender;
@@ -77,7 +198,7 @@ class HistogramSink : public HistogramProcessor<SampleType> {
         }
     }
 
-    void HandleFrame(Histogram<SampleType> const &histogram) override {
+    void HandleFrame(AdaptiveHistogram const &histogram) override {
         // Only the final cumulative histogram is written to SDT.
 
         if (dataSender) {
@@ -85,7 +206,7 @@ class HistogramSink : public HistogramProcessor<SampleType> {
         }
     }
 
-    void HandleFinish(Histogram<SampleType> &&histogram,
+    void HandleFinish(AdaptiveHistogram &&histogram,
                       bool isCompleteFrame) override {
         // isCompleteFrame is always true because our upstream guarantees it
         if (sdtWriter) {
@@ -102,7 +223,7 @@ class HistogramSink : public HistogramProcessor<SampleType> {
 
 template <typename E>
 static void PumpDeviceEvents(
-    std::shared_ptr<EventStream<E>> stream,
+    std::shared_ptr<SPSCEventStream<E>> stream,
     std::vector<std::shared_ptr<DeviceEventProcessor>> processors) {
     for (;;) {
         std::shared_ptr<EventBuffer<E>> buffer;
@@ -129,58 +250,81 @@ static void PumpDeviceEvents(
     }
 }
 
-template <typename T>
-static std::shared_ptr<PixelPhotonProcessor> MakeNoncumulativeHistogrammer(
+// The cumulative histogram starts with 8-bit bins, widened as needed, so
+// that long acquisitions do not saturate.
+static std::shared_ptr<PixelPhotonProcessor> MakeCumulativeHistogrammer(
     uint32_t histoBits, uint32_t inputBits, uint32_t width, uint32_t height,
-    std::shared_ptr<HistogramProcessor<T>> downstream) {
-    Histogram<T> frameHisto(histoBits, inputBits, true, width, height);
-    return std::make_shared<Histogrammer<T>>(std::move(frameHisto),
-                                             downstream);
-}
-
-template <typename T>
-static std::shared_ptr<PixelPhotonProcessor>
-MakeCumulativeHistogrammer(uint32_t histoBits, uint32_t inputBits,
-                           uint32_t width, uint32_t height,
-                           std::shared_ptr<HistogramProcessor<T>> downstream) {
-    Histogram<T> cumulHisto(histoBits, inputBits, true, width, height);
+    std::shared_ptr<AdaptiveHistogramProcessor> downstream) {
+    AdaptiveHistogram cumulHisto(histoBits, inputBits, true, width, height);
     cumulHisto.Clear();
-    return MakeNoncumulativeHistogrammer<T>(
-        histoBits, inputBits, width, height,
-        std::make_shared<HistogramAccumulator<T>>(std::move(cumulHisto),
-                                                  downstream));
+    return std::make_shared<AdaptiveCumulativeHistogrammer>(
+        std::move(cumulHisto), downstream);
 }
 
 // Returns stream to which events should be sent
 // Second retval is completion of event pumping, which needs to be stored
 // until processing finishes (or else destructor will block).
-std::tuple<std::shared_ptr<EventStream<BHSPCEvent>>, std::future<void>>
+// If usePixelMarkers, lineDelay is the delay relative to each pixel marker,
+// and line and frame markers (if any) are used to resynchronize. Otherwise
+// frame markers (if frameMarkerBit is a valid bit) determine frame starts,
+// and lineScan gives the line scan geometry.
+// Photons with microtime outside [microtimeGateBegin, microtimeGateEnd) are
+// discarded before forming any image or histogram. Histograms (only) are
+// binned by histoBinning in x and y.
+// If phasorHarmonic > 0, phasor G and S images are sent as the 2 channels
+// after the intensity (and mean arrival time) images, and the cumulative
+// phasor image is also sent to phasorWriter (if any).
+std::tuple<std::shared_ptr<SPSCEventStream<BHSPCEvent>>, std::future<void>>
 SetUpProcessing(uint32_t width, uint32_t height, uint32_t maxFrames,
                 std::bitset<16> channelMask, bool accumulateIntensity,
-                int32_t lineDelay, uint32_t lineTime, uint32_t lineMarkerBit,
-                OScDev_Acquisition *acquisition,
+                bool meanArrivalTime, uint32_t histoBits, uint32_t histoBinning,
+                uint32_t microtimeGateBegin, uint32_t microtimeGateEnd,
+                bool usePixelMarkers, int32_t lineDelay, uint32_t lineTime,
+                uint32_t pixelTime, uint32_t pixelMarkerBit,
+                uint32_t lineMarkerBit, uint32_t frameMarkerBit,
+                LineScanOptions lineScan, OScDev_Acquisition *acquisition,
                 std::function<void(void)> stopFunc,
                 std::shared_ptr<DeviceEventProcessor> additionalProcessor,
                 std::shared_ptr<SDTWriter> histogramWriter,
                 std::shared_ptr<DataSender> histogramSender,
+                uint32_t phasorHarmonic,
+                std::shared_ptr<PhasorProcessor> phasorWriter,
                 std::shared_ptr<AcquisitionCompletion> completion) {
     uint32_t inputBits = 12;
-    uint32_t intensityBits = 0; // Intensity image is 0-bit histogram
-    uint32_t histoBits = 8;     // TODO Configurable
 
     // Construct our processing graph starting at downstream.
 
     auto intensitySink = std::make_shared<IntensityImageSink>(
         acquisition, stopFunc, completion);
-    auto intensityAccumulator =
-        accumulateIntensity
-            ? MakeCumulativeHistogrammer<SampleType>(
-                  intensityBits, inputBits, width, height, intensitySink)
-            : MakeNoncumulativeHistogrammer<SampleType>(
-                  intensityBits, inputBits, width, height, intensitySink);
-
-    // We construct a single-channel intensity image as the sum of all enabled
-    // channels (for now, at least).
+    std::shared_ptr<PixelPhotonProcessor> intensityAccumulator;
+    if (meanArrivalTime) {
+        std::shared_ptr<MeanArrivalTimeProcessor> imageSink = intensitySink;
+        if (accumulateIntensity) {
+            MeanArrivalTimeImage cumulImage(width, height);
+            cumulImage.Clear();
+            imageSink = std::make_shared<MeanArrivalTimeAccumulator>(
+                std::move(cumulImage), imageSink);
+        }
+        intensityAccumulator = std::make_shared<MeanArrivalTimeImager>(
+            MeanArrivalTimeImage(width, height), inputBits, true, imageSink);
+    } else {
+        // Intensity image is 0-bit histogram
+        std::shared_ptr<HistogramProcessor<SampleType>> histoSink =
+            intensitySink;
+        if (accumulateIntensity) {
+            Histogram<SampleType> cumulHisto(0, inputBits, true, width,
+                                             height);
+            cumulHisto.Clear();
+            histoSink = std::make_shared<HistogramAccumulator<SampleType>>(
+                std::move(cumulHisto), histoSink);
+        }
+        intensityAccumulator = std::make_shared<IntensityCounter<SampleType>>(
+            Histogram<SampleType>(0, inputBits, true, width, height),
+            histoSink);
+    }
+
+    // We construct a single-channel intensity (and mean arrival time) image
+    // as the sum of all enabled channels (for now, at least).
     std::vector<std::shared_ptr<PixelPhotonProcessor>> channelAccumulators;
     channelAccumulators.resize(channelMask.size());
     for (unsigned i = 0; i < channelMask.size(); ++i) {
@@ -203,20 +347,82 @@ SetUpProcessing(uint32_t width, uint32_t height, uint32_t maxFrames,
                 continue;
             auto histoSink = std::make_shared<HistogramSink>(
                 n, histogramWriter, histogramSender);
-            auto histoProc = MakeCumulativeHistogrammer<SampleType>(
-                histoBits, inputBits, width, height, histoSink);
+            auto histoProc = MakeCumulativeHistogrammer(
+                histoBits, inputBits,
+                SpatialBinner::GetBinnedSize(width, histoBinning),
+                SpatialBinner::GetBinnedSize(height, histoBinning), histoSink);
             histogrammers[i] = histoProc;
             ++n;
         }
-        auto histoProc = std::make_shared<PixelPhotonRouter>(histogrammers);
+        std::shared_ptr<PixelPhotonProcessor> histoProc =
+            std::make_shared<PixelPhotonRouter>(histogrammers);
+        if (histoBinning > 1) {
+            histoProc =
+                std::make_shared<SpatialBinner>(histoBinning, histoProc);
+        }
 
         pixelPhotonProcs = std::make_shared<BroadcastPixelPhotonProcessor<2>>(
             intensityProc, histoProc);
     }
 
-    auto pixellator = std::make_shared<LineClockPixellator>(
-        width, height, maxFrames, lineDelay, lineTime, lineMarkerBit,
-        pixelPhotonProcs);
+    // Phasor images are computed from the sum of enabled channels (like the
+    // intensity image). The phasor file is always cumulative, whereas the
+    // live images follow accumulateIntensity.
+    if (phasorHarmonic > 0) {
+        std::shared_ptr<PhasorProcessor> fileSink = phasorWriter;
+        if (phasorWriter && !accumulateIntensity) {
+            PhasorImage cumulPhasor(width, height);
+            cumulPhasor.Clear();
+            fileSink = std::make_shared<PhasorAccumulator>(
+                std::move(cumulPhasor), phasorWriter);
+        }
+        std::shared_ptr<PhasorProcessor> phasorSink =
+            std::make_shared<PhasorImageSink>(
+                acquisition, meanArrivalTime ? 2 : 1, completion, fileSink);
+        if (accumulateIntensity) {
+            PhasorImage cumulPhasor(width, height);
+            cumulPhasor.Clear();
+            phasorSink = std::make_shared<PhasorAccumulator>(
+                std::move(cumulPhasor), phasorSink);
+        }
+        auto phasorizer = std::make_shared<Phasorizer>(
+            PhasorImage(width, height), phasorHarmonic, inputBits, true,
+            phasorSink);
+        std::vector<std::shared_ptr<PixelPhotonProcessor>> channelPhasorizers;
+        channelPhasorizers.resize(channelMask.size());
+        for (unsigned i = 0; i < channelMask.size(); ++i) {
+            if (!channelMask[i])
+                continue;
+            channelPhasorizers[i] = phasorizer;
+        }
+        auto phasorProc =
+            std::make_shared<PixelPhotonRouter>(channelPhasorizers);
+
+        pixelPhotonProcs = std::make_shared<BroadcastPixelPhotonProcessor<2>>(
+            pixelPhotonProcs, phasorProc);
+    }
+
+    if (microtimeGateBegin > 0 || microtimeGateEnd < (1u << inputBits)) {
+        pixelPhotonProcs = std::make_shared<MicrotimeGate>(
+            microtimeGateBegin, microtimeGateEnd, pixelPhotonProcs);
+    }
+
+    std::shared_ptr<DecodedEventProcessor> pixellator;
+    std::shared_ptr<LineClockPixellator> lineClockPixellator;
+    std::shared_ptr<PixelClockPixellator> pixelClockPixellator;
+    if (usePixelMarkers) {
+        // In pixel marker mode, lineDelay is the delay relative to each
+        // pixel marker
+        pixelClockPixellator = std::make_shared<PixelClockPixellator>(
+            width, height, maxFrames, lineDelay, pixelTime, pixelMarkerBit,
+            lineMarkerBit, frameMarkerBit, pixelPhotonProcs);
+        pixellator = pixelClockPixellator;
+    } else {
+        lineClockPixellator = std::make_shared<LineClockPixellator>(
+            width, height, maxFrames, lineDelay, lineTime, lineMarkerBit,
+            frameMarkerBit, std::move(lineScan), pixelPhotonProcs);
+        pixellator = lineClockPixellator;
+    }
 
     auto decoder = std::make_shared<BHSPCEventDecoder>(pixellator);
 
@@ -226,11 +432,34 @@ SetUpProcessing(uint32_t width, uint32_t height, uint32_t maxFrames,
         procs.emplace_back(additionalProcessor);
     }
 
-    auto stream = std::make_shared<EventStream<BHSPCEvent>>();
+    auto stream = std::make_shared<SPSCEventStream<BHSPCEvent>>();
 
-    auto done =
-        std::async(std::launch::async, [stream, procs = std::move(procs)] {
+    auto done = std::async(
+        std::launch::async, [stream, procs = std::move(procs),
+                             lineClockPixellator, pixelClockPixellator,
+                             completion] {
             PumpDeviceEvents(stream, procs);
+            if (lineClockPixellator &&
+                (lineClockPixellator->GetDroppedLineCount() > 0 ||
+                 lineClockPixellator->GetExtraLineCount() > 0)) {
+                completion->Log(
+                    "Frame marker resync: " +
+                    std::to_string(lineClockPixellator->GetDroppedLineCount()) +
+                    " dropped lines, " +
+                    std::to_string(lineClockPixellator->GetExtraLineCount()) +
+                    " extra lines");
+            }
+            if (pixelClockPixellator &&
+                (pixelClockPixellator->GetSkippedPixelCount() > 0 ||
+                 pixelClockPixellator->GetExtraPixelCount() > 0)) {
+                completion->Log(
+                    "Line/frame marker resync: " +
+                    std::to_string(
+                        pixelClockPixellator->GetSkippedPixelCount()) +
+                    " skipped pixels, " +
+                    std::to_string(pixelClockPixellator->GetExtraPixelCount()) +
+                    " extra pixels");
+            }
         });
 
     return std::make_tuple(stream, std::move(done));
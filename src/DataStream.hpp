@@ -2,10 +2,12 @@
 
 #include "AcquisitionCompletion.hpp"
 #include "DataSender.hpp"
+#include "PhasorFileWriter.hpp"
 #include "SDTFileWriter.hpp"
 #include "SPCFileWriter.hpp"
 
 #include <FLIMEvents/BHDeviceEvent.hpp>
+#include <FLIMEvents/LineClockPixellator.hpp>
 #include <FLIMEvents/StreamBuffer.hpp>
 
 #include <OpenScanDeviceLib.h>
@@ -16,13 +18,19 @@
 #include <memory>
 #include <tuple>
 
-std::tuple<std::shared_ptr<EventStream<BHSPCEvent>>, std::future<void>>
+std::tuple<std::shared_ptr<SPSCEventStream<BHSPCEvent>>, std::future<void>>
 SetUpProcessing(uint32_t width, uint32_t height, uint32_t maxFrames,
                 std::bitset<16> channelMask, bool accumulateIntensity,
-                int32_t lineDelay, uint32_t lineTime, uint32_t lineMarkerBit,
-                OScDev_Acquisition *acquisition,
+                bool meanArrivalTime, uint32_t histoBits, uint32_t histoBinning,
+                uint32_t microtimeGateBegin, uint32_t microtimeGateEnd,
+                bool usePixelMarkers, int32_t lineDelay, uint32_t lineTime,
+                uint32_t pixelTime, uint32_t pixelMarkerBit,
+                uint32_t lineMarkerBit, uint32_t frameMarkerBit,
+                LineScanOptions lineScan, OScDev_Acquisition *acquisition,
                 std::function<void(void)> stopFunc,
                 std::shared_ptr<DeviceEventProcessor> additionalProcessor,
                 std::shared_ptr<SDTWriter> histogramWriter,
                 std::shared_ptr<DataSender> histogramSender,
+                uint32_t phasorHarmonic,
+                std::shared_ptr<PhasorProcessor> phasorWriter,
                 std::shared_ptr<AcquisitionCompletion> completion);
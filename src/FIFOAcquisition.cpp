@@ -4,8 +4,10 @@
 #include <Spcm_def.h>
 
 #include <chrono>
+#include <cstddef>
 #include <cstdlib>
 #include <exception>
+#include <memory>
 #include <stdexcept>
 #include <string>
 #include <thread>
@@ -175,7 +177,7 @@ bool IsSPC600FIFO32(short fifoType) { return fifoType == FIFO_32; }
 bool IsSPC600FIFO48(short fifoType) { return fifoType == FIFO_48; }
 
 template <typename E>
-static void PushError(short code, EventStream<E> *stream,
+static void PushError(short code, SPSCEventStream<E> *stream,
                       AcquisitionCompletion *completion) {
     std::string message;
     char buffer[512];
@@ -203,17 +205,38 @@ static short ReadFifo(short module, std::size_t *eventCount, T *buffer) {
     return ret;
 }
 
+// Set the GAP flag on the first event (that can carry it) in the given
+// events, so that downstream sees a data lost event at that point. Returns
+// false if there is no such event.
+static bool MarkDataLost(BHSPCEvent *events, std::size_t count) {
+    for (std::size_t i = 0; i < count; ++i) {
+        if (!events[i].IsMultipleMacroTimeOverflow()) {
+            events[i].SetGapFlag();
+            return true;
+        }
+    }
+    return false;
+}
+
 // Start measurement, read data, stop measurement
 // pool: buffer pool for data
 // stream: destination for data
 // stopRequested: setting this future's shared state stops the acquisition
 template <typename E>
 static void RunAcquisition(short module, EventBufferPool<E> *pool,
-                           EventStream<E> *stream,
+                           SPSCEventStream<E> *stream,
                            std::shared_future<void> stopRequested,
                            AcquisitionCompletion *completion) {
     short err;
 
+    // If the pool has no buffer available (because processing is not keeping
+    // up), we continue to read the device FIFO (so that it does not
+    // overflow) into this scratch buffer, discarding the data. The loss is
+    // then recorded in the next buffer sent, in the same way as the device
+    // would record a FIFO overflow.
+    std::unique_ptr<E[]> scratch;
+    bool dataLost = false;
+
     // Note that, in all code paths, we ensure that measurement is stopped
     // _before_ the stream is finished (successfully or with error).
 
@@ -232,6 +255,21 @@ static void RunAcquisition(short module, EventBufferPool<E> *pool,
         }
 
         auto buffer = pool->CheckOut();
+        if (!buffer) {
+            if (!scratch) {
+                scratch = std::make_unique<E[]>(pool->GetBufferSize());
+            }
+            std::size_t eventCount = pool->GetBufferSize();
+            err = ReadFifo<E>(module, &eventCount, scratch.get());
+            if (err < 0) {
+                goto error;
+            }
+            if (eventCount > 0) {
+                dataLost = true;
+            }
+            std::this_thread::sleep_for(20ms);
+            continue;
+        }
 
         std::size_t eventCount = buffer->GetCapacity();
         err = ReadFifo<E>(module, &eventCount, buffer->GetData());
@@ -262,6 +300,10 @@ static void RunAcquisition(short module, EventBufferPool<E> *pool,
 
         buffer->SetSize(eventsRead);
 
+        if (dataLost && MarkDataLost(buffer->GetData(), eventsRead)) {
+            dataLost = false;
+        }
+
         stream->Send(buffer);
     }
 
@@ -273,6 +315,16 @@ static void RunAcquisition(short module, EventBufferPool<E> *pool,
         return;
     }
 
+    if (dataLost) {
+        // No subsequent buffer in which to record the loss
+        std::string message = "Data lost due to exhausted event buffers";
+        std::runtime_error e(message);
+        stream->SendException(std::make_exception_ptr(e));
+        completion->HandleError("Acquisition stopped: " + message,
+                                "FIFOAcquisition");
+        return;
+    }
+
     // Indicate end of stream
     stream->Send({});
 
@@ -290,7 +342,7 @@ error:
 template <typename E>
 static std::tuple<OScDev_RichError *, std::future<void>>
 StartAcquisition(short module, std::shared_ptr<EventBufferPool<E>> pool,
-                 std::shared_ptr<EventStream<E>> stream,
+                 std::shared_ptr<SPSCEventStream<E>> stream,
                  std::shared_future<void> stopRequested,
                  std::shared_ptr<AcquisitionCompletion> completion) {
     if (completion) {
@@ -319,7 +371,7 @@ StartAcquisition(short module, std::shared_ptr<EventBufferPool<E>> pool,
 
 std::tuple<OScDev_RichError *, std::future<void>> StartAcquisitionStandardFIFO(
     short module, std::shared_ptr<EventBufferPool<BHSPCEvent>> pool,
-    std::shared_ptr<EventStream<BHSPCEvent>> stream,
+    std::shared_ptr<SPSCEventStream<BHSPCEvent>> stream,
     std::shared_future<void> stopRequested,
     std::shared_ptr<AcquisitionCompletion> completion) {
     return StartAcquisition<BHSPCEvent>(module, pool, stream, stopRequested,
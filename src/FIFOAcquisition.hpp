@@ -23,6 +23,6 @@ bool IsSPC600FIFO48(short fifoType);
 
 std::tuple<OScDev_RichError *, std::future<void>> StartAcquisitionStandardFIFO(
     short module, std::shared_ptr<EventBufferPool<BHSPCEvent>> pool,
-    std::shared_ptr<EventStream<BHSPCEvent>> stream,
+    std::shared_ptr<SPSCEventStream<BHSPCEvent>> stream,
     std::shared_future<void> stopRequested,
     std::shared_ptr<AcquisitionCompletion> completion);
@@ -8,6 +8,7 @@
 #include <bitset>
 #include <cstdio>
 #include <string>
+#include <utility>
 
 namespace rj = rapidjson;
 
@@ -64,6 +65,45 @@ class MetadataJsonWriter final {
         doc.AddMember("line_time_macrotime_units", time, doc.GetAllocator());
     }
 
+    // fillFraction 0 means linear sweep
+    void SetLineScan(bool bidirectional, double sinusoidalFillFraction) {
+        if (bidirectional)
+            doc.AddMember("bidirectional_scan", bidirectional,
+                          doc.GetAllocator());
+        if (sinusoidalFillFraction > 0.0)
+            doc.AddMember("sinusoidal_fill_fraction", sinusoidalFillFraction,
+                          doc.GetAllocator());
+    }
+
+    void SetFrameMarkerResync(bool resync) {
+        if (resync)
+            doc.AddMember("frame_marker_resync", resync, doc.GetAllocator());
+    }
+
+    void SetHistogramTimeBits(uint32_t timeBits) {
+        doc.AddMember("histogram_time_bits", timeBits, doc.GetAllocator());
+    }
+
+    // Not recorded if 1 (no binning)
+    void SetHistogramBinning(uint32_t factor) {
+        if (factor > 1)
+            doc.AddMember("histogram_binning", factor, doc.GetAllocator());
+    }
+
+    // Not recorded if the gate is the full microtime range
+    void SetMicrotimeGate(uint32_t begin, uint32_t end,
+                          uint32_t microtimeRange) {
+        if (begin > 0 || end < microtimeRange) {
+            doc.AddMember("microtime_gate_begin", begin, doc.GetAllocator());
+            doc.AddMember("microtime_gate_end", end, doc.GetAllocator());
+        }
+    }
+
+    void SetPhasorHarmonic(uint32_t harmonic) {
+        if (harmonic > 0)
+            doc.AddMember("phasor_harmonic", harmonic, doc.GetAllocator());
+    }
+
     void SetMarkerSettings(bool usePixelClock, uint32_t nMarkerBits,
                            uint32_t pixelMarkerBit, uint32_t lineMarkerBit,
                            uint32_t frameMarkerBit) {
@@ -175,6 +215,71 @@ class MetadataJsonReader final {
         return flag.GetBool();
     }
 
+    bool GetBidirectionalScan() const {
+        if (!doc.HasMember("bidirectional_scan"))
+            return false;
+        auto &flag = doc["bidirectional_scan"];
+        if (!flag.IsBool())
+            return false;
+        return flag.GetBool();
+    }
+
+    // Returns 0 for linear sweep
+    double GetSinusoidalFillFraction() const {
+        if (!doc.HasMember("sinusoidal_fill_fraction"))
+            return 0.0;
+        auto &fraction = doc["sinusoidal_fill_fraction"];
+        if (!fraction.IsNumber())
+            throw std::runtime_error(
+                "JSON sinusoidal_fill_fraction field must be real number");
+        return fraction.GetDouble();
+    }
+
+    bool GetFrameMarkerResync() const {
+        if (!doc.HasMember("frame_marker_resync"))
+            return false;
+        auto &flag = doc["frame_marker_resync"];
+        if (!flag.IsBool())
+            return false;
+        return flag.GetBool();
+    }
+
+    // Returns 8 (the bits used before this was recorded) if missing
+    uint32_t GetHistogramTimeBits() const {
+        if (!doc.HasMember("histogram_time_bits"))
+            return 8;
+        auto &bits = doc["histogram_time_bits"];
+        if (!bits.IsUint())
+            throw std::runtime_error(
+                "JSON histogram_time_bits field must be integer");
+        return bits.GetUint();
+    }
+
+    // Returns 1 (no binning) if missing
+    uint32_t GetHistogramBinning() const {
+        if (!doc.HasMember("histogram_binning"))
+            return 1;
+        auto &factor = doc["histogram_binning"];
+        if (!factor.IsUint())
+            throw std::runtime_error(
+                "JSON histogram_binning field must be integer");
+        return factor.GetUint();
+    }
+
+    // Returns the full range [0, microtimeRange) if missing
+    std::pair<uint32_t, uint32_t>
+    GetMicrotimeGate(uint32_t microtimeRange) const {
+        if (!doc.HasMember("microtime_gate_begin") ||
+            !doc.HasMember("microtime_gate_end"))
+            return {0, microtimeRange};
+        auto &begin = doc["microtime_gate_begin"];
+        auto &end = doc["microtime_gate_end"];
+        if (!begin.IsUint() || !end.IsUint())
+            throw std::runtime_error(
+                "JSON microtime gate fields must be integers");
+        return {begin.GetUint(), end.GetUint()};
+    }
+
     uint32_t GetLineMarkerBit() const {
         if (!doc.HasMember("line_marker_bit"))
             throw std::runtime_error("JSON field missting: line_marker_bit");
@@ -184,4 +289,16 @@ class MetadataJsonReader final {
                 "JSON line_marker_bit field must be integer");
         return bit.GetUint();
     }
+
+    // Returns notPresent if field is missing
+    uint32_t GetOptionalMarkerBit(char const *field,
+                                  uint32_t notPresent) const {
+        if (!doc.HasMember(field))
+            return notPresent;
+        auto &bit = doc[field];
+        if (!bit.IsUint())
+            throw std::runtime_error(std::string("JSON ") + field +
+                                     " field must be integer");
+        return bit.GetUint();
+    }
 };
@@ -0,0 +1,84 @@
+#pragma once
+
+#include "AcquisitionCompletion.hpp"
+
+#include <FLIMEvents/Phasor.hpp>
+
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Write the final (cumulative) phasor image to a raw binary file, consisting
+// of 3 row-major planes of width * height values (the image size is recorded
+// in the metadata JSON): G (float64), S (float64), and photon count
+// (uint32), all little-endian.
+class PhasorFileWriter final : public PhasorProcessor {
+    std::string filename;
+    std::shared_ptr<AcquisitionCompletion> downstream;
+
+    void SendError(std::string const &message) {
+        if (downstream) {
+            downstream->HandleError(message, "PhasorFileWriter");
+            downstream.reset();
+        }
+    }
+
+  public:
+    PhasorFileWriter(std::string const &filename,
+                     std::shared_ptr<AcquisitionCompletion> downstream)
+        : filename(filename), downstream(downstream) {
+        if (downstream) {
+            downstream->AddProcess("PhasorFileWriter");
+        }
+    }
+
+    void HandleError(std::string const &message) override {
+        SendError("Phasor image not saved due to error: " + message);
+    }
+
+    void HandleFrame(PhasorImage const &image) override {
+        // Only the final cumulative image is written.
+    }
+
+    void HandleFinish(PhasorImage &&image, bool isCompleteFrame) override {
+        std::size_t const width = image.GetWidth();
+        std::size_t const height = image.GetHeight();
+        std::vector<double> g;
+        std::vector<double> s;
+        std::vector<uint32_t> counts;
+        g.reserve(width * height);
+        s.reserve(width * height);
+        counts.reserve(width * height);
+        for (std::size_t y = 0; y < height; ++y) {
+            for (std::size_t x = 0; x < width; ++x) {
+                g.push_back(image.GetG(x, y));
+                s.push_back(image.GetS(x, y));
+                counts.push_back(image.GetPixel(x, y).count);
+            }
+        }
+
+        std::fstream file(filename, std::fstream::binary | std::fstream::out);
+        if (!file.is_open()) {
+            SendError("Cannot open phasor file");
+            return;
+        }
+        file.write(reinterpret_cast<char const *>(g.data()),
+                   sizeof(double) * g.size());
+        file.write(reinterpret_cast<char const *>(s.data()),
+                   sizeof(double) * s.size());
+        file.write(reinterpret_cast<char const *>(counts.data()),
+                   sizeof(uint32_t) * counts.size());
+        file.close();
+        if (!file.good()) {
+            SendError("Write error in phasor file");
+            return;
+        }
+
+        if (downstream) {
+            downstream->HandleFinish("PhasorFileWriter");
+            downstream.reset();
+        }
+    }
+};
@@ -1,9 +1,14 @@
 #include "BHSPCFile.hpp"
 #include "DataSender.hpp"
+#include "FLIMEvents/AdaptiveHistogram.hpp"
 #include "FLIMEvents/BHDeviceEvent.hpp"
 #include "FLIMEvents/Histogram.hpp"
 #include "FLIMEvents/LineClockPixellator.hpp"
+#include "FLIMEvents/MicrotimeGate.hpp"
+#include "FLIMEvents/ParallelBHEventDecoder.hpp"
+#include "FLIMEvents/PixelClockPixellator.hpp"
 #include "FLIMEvents/PixelPhotonRouter.hpp"
+#include "FLIMEvents/SpatialBinner.hpp"
 #include "FLIMEvents/StreamBuffer.hpp"
 #include "MetadataJson.hpp"
 
@@ -17,13 +22,12 @@
 
 void Usage() {
     std::cerr << "Replay .spc file and send histograms.\n"
-              << "Usage: ReplaySPC <port> <input>\n"
-              << "where input.spc and input.json must both exist.\n";
+              << "Usage: ReplaySPC <port> <input> [<decodeThreads>]\n"
+              << "where input.spc and input.json must both exist.\n"
+              << "If <decodeThreads> is given, raw events are decoded using that many threads (0 for all cores).\n";
 }
 
-using SampleType = uint16_t;
-
-template <typename T> class HistogramSink : public HistogramProcessor<T> {
+class HistogramSink : public AdaptiveHistogramProcessor {
     unsigned channel;
     std::shared_ptr<DataSender> dataSender;
 
@@ -38,13 +42,13 @@ template <typename T> class HistogramSink : public HistogramProcessor<T> {
         }
     }
 
-    void HandleFrame(Histogram<SampleType> const &histogram) override {
+    void HandleFrame(AdaptiveHistogram const &histogram) override {
         if (dataSender) {
             dataSender->SetHistogram(channel, histogram);
         }
     }
 
-    void HandleFinish(Histogram<SampleType> &&histogram,
+    void HandleFinish(AdaptiveHistogram &&histogram,
                       bool isCompleteFrame) override {
         // isCompleteFrame is always true because our upstream guarantees it
         if (dataSender) {
@@ -54,30 +58,18 @@ template <typename T> class HistogramSink : public HistogramProcessor<T> {
     }
 };
 
-template <typename T>
-static std::shared_ptr<PixelPhotonProcessor> MakeNoncumulativeHistogrammer(
+static std::shared_ptr<PixelPhotonProcessor> MakeCumulativeHistogrammer(
     uint32_t histoBits, uint32_t inputBits, uint32_t width, uint32_t height,
-    std::shared_ptr<HistogramProcessor<T>> downstream) {
-    Histogram<T> frameHisto(histoBits, inputBits, true, width, height);
-    return std::make_shared<Histogrammer<T>>(std::move(frameHisto),
-                                             downstream);
-}
-
-template <typename T>
-static std::shared_ptr<PixelPhotonProcessor>
-MakeCumulativeHistogrammer(uint32_t histoBits, uint32_t inputBits,
-                           uint32_t width, uint32_t height,
-                           std::shared_ptr<HistogramProcessor<T>> downstream) {
-    Histogram<T> cumulHisto(histoBits, inputBits, true, width, height);
+    std::shared_ptr<AdaptiveHistogramProcessor> downstream) {
+    AdaptiveHistogram cumulHisto(histoBits, inputBits, true, width, height);
     cumulHisto.Clear();
-    return MakeNoncumulativeHistogrammer<T>(
-        histoBits, inputBits, width, height,
-        std::make_shared<HistogramAccumulator<T>>(std::move(cumulHisto),
-                                                  downstream));
+    return std::make_shared<AdaptiveCumulativeHistogrammer>(
+        std::move(cumulHisto), downstream);
 }
 
 void replay(std::string const &inFilename,
-            MetadataJsonReader const &jsonReader, uint16_t port) {
+            MetadataJsonReader const &jsonReader, uint16_t port,
+            bool parallelDecode, unsigned decodeThreads) {
 
     std::fstream input(inFilename + ".spc",
                        std::fstream::binary | std::fstream::in);
@@ -93,18 +85,39 @@ void replay(std::string const &inFilename,
     std::bitset<16> channelMask = jsonReader.GetChannelMask();
 
     int32_t inputBits = 12;
-    int32_t histoBits = 8;
+    int32_t histoBits = jsonReader.GetHistogramTimeBits();
+    auto gate = jsonReader.GetMicrotimeGate(1u << inputBits);
+    uint32_t binning = jsonReader.GetHistogramBinning();
 
     uint32_t width = jsonReader.GetRasterWidth();
     uint32_t height = jsonReader.GetRasterHeight();
 
-    if (jsonReader.GetUsePixelClock())
-        throw std::runtime_error(
-            "JSON specifies use of pixel clock, which is not currently supported");
-
-    uint32_t lineMarkerBit = jsonReader.GetLineMarkerBit();
-    if (lineMarkerBit > 4)
-        throw std::runtime_error("Line marker bit out of range");
+    // Marker bits >= 16 mean not used (by PixelClockPixellator)
+    bool usePixelClock = jsonReader.GetUsePixelClock();
+    uint32_t pixelMarkerBit = UINT32_MAX;
+    uint32_t lineMarkerBit;
+    uint32_t frameMarkerBit = UINT32_MAX;
+    if (usePixelClock) {
+        pixelMarkerBit =
+            jsonReader.GetOptionalMarkerBit("pixel_marker_bit", UINT32_MAX);
+        if (pixelMarkerBit > 4)
+            throw std::runtime_error("Pixel marker bit out of range");
+        lineMarkerBit =
+            jsonReader.GetOptionalMarkerBit("line_marker_bit", UINT32_MAX);
+        frameMarkerBit =
+            jsonReader.GetOptionalMarkerBit("frame_marker_bit", UINT32_MAX);
+    } else {
+        lineMarkerBit = jsonReader.GetLineMarkerBit();
+        if (lineMarkerBit > 4)
+            throw std::runtime_error("Line marker bit out of range");
+        if (jsonReader.GetFrameMarkerResync()) {
+            frameMarkerBit = jsonReader.GetOptionalMarkerBit(
+                "frame_marker_bit", UINT32_MAX);
+            if (frameMarkerBit > 4)
+                throw std::runtime_error(
+                    "Frame marker resync requires frame_marker_bit");
+        }
+    }
 
     int32_t lineDelay = jsonReader.GetLineDelay();
     uint32_t lineTime = jsonReader.GetLineTime();
@@ -125,40 +138,89 @@ void replay(std::string const &inFilename,
     for (unsigned i = 0; i < channelMask.size(); ++i) {
         if (!channelMask[i])
             continue;
-        auto histoSink =
-            std::make_shared<HistogramSink<SampleType>>(n, sender);
-        auto histoProc = MakeCumulativeHistogrammer<SampleType>(
-            histoBits, inputBits, width, height, histoSink);
+        auto histoSink = std::make_shared<HistogramSink>(n, sender);
+        auto histoProc = MakeCumulativeHistogrammer(
+            histoBits, inputBits, SpatialBinner::GetBinnedSize(width, binning),
+            SpatialBinner::GetBinnedSize(height, binning), histoSink);
         histogrammers[n] = histoProc;
         ++n;
     }
 
-    auto histProc = std::make_shared<PixelPhotonRouter>(histogrammers);
+    std::shared_ptr<PixelPhotonProcessor> histProc =
+        std::make_shared<PixelPhotonRouter>(histogrammers);
+    if (binning > 1) {
+        histProc = std::make_shared<SpatialBinner>(binning, histProc);
+    }
+    if (gate.first > 0 || gate.second < (1u << inputBits)) {
+        histProc = std::make_shared<MicrotimeGate>(gate.first, gate.second,
+                                                   histProc);
+    }
 
-    auto pixellator = std::make_shared<LineClockPixellator>(
-        width, height, UINT32_MAX, lineDelay, lineTime, lineMarkerBit,
-        histProc);
+    LineScanOptions lineScan;
+    lineScan.bidirectional = jsonReader.GetBidirectionalScan();
+    double fillFraction = jsonReader.GetSinusoidalFillFraction();
+    if (fillFraction > 0.0) {
+        lineScan.pixelTable =
+            MakeSinusoidalPixelTable(width, lineTime, fillFraction);
+    }
+
+    std::shared_ptr<DecodedEventProcessor> pixellator;
+    if (usePixelClock) {
+        // Delay is relative to each pixel marker
+        auto pixelTime = static_cast<uint32_t>(
+            std::round(1e10 / pixelRateHz / macrotimeUnitsTenthNs));
+        pixellator = std::make_shared<PixelClockPixellator>(
+            width, height, UINT32_MAX, lineDelay, pixelTime, pixelMarkerBit,
+            lineMarkerBit, frameMarkerBit, histProc);
+    } else {
+        pixellator = std::make_shared<LineClockPixellator>(
+            width, height, UINT32_MAX, lineDelay, lineTime, lineMarkerBit,
+            frameMarkerBit, std::move(lineScan), histProc);
+    }
 
-    auto decoder = std::make_shared<BHSPCEventDecoder>(pixellator);
+    std::shared_ptr<DeviceEventProcessor> decoder;
+    if (parallelDecode) {
+        decoder = std::make_shared<ParallelBHSPCEventDecoder>(decodeThreads,
+                                                              pixellator);
+    } else {
+        decoder = std::make_shared<BHSPCEventDecoder>(pixellator);
+    }
 
-    EventStream<BHSPCEvent> stream;
-    auto processorDone = std::async(std::launch::async, [&stream, decoder] {
-        for (;;) {
-            auto eventBuffer = stream.ReceiveBlocking();
-            if (!eventBuffer) {
-                break;
+    // Parallel decoding needs large buffers to be split among threads. The
+    // number of buffers is limited so that reading waits for processing,
+    // rather than loading the whole file into memory. (The pool must outlive
+    // the stream, which may still hold buffers if processing fails.)
+    EventBufferPool<BHSPCEvent> pool(
+        parallelDecode ? 4 * 1024 * 1024 : 48 * 1024, 0, 16,
+        EventBufferPoolPolicy::Block);
+
+    SPSCEventStream<BHSPCEvent> stream;
+    auto processorDone =
+        std::async(std::launch::async, [&stream, &pool, decoder] {
+            try {
+                for (;;) {
+                    auto eventBuffer = stream.ReceiveBlocking();
+                    if (!eventBuffer) {
+                        break;
+                    }
+                    decoder->HandleDeviceEvents(
+                        reinterpret_cast<char const *>(eventBuffer->GetData()),
+                        eventBuffer->GetSize());
+                }
+            } catch (...) {
+                // Stop the reading loop, which may be waiting for a buffer
+                pool.Cancel();
+                throw;
             }
-            decoder->HandleDeviceEvents(
-                reinterpret_cast<char const *>(eventBuffer->GetData()),
-                eventBuffer->GetSize());
-        }
 
-        decoder->HandleFinish();
-    });
+            decoder->HandleFinish();
+        });
 
-    EventBufferPool<BHSPCEvent> pool(48 * 1024);
     while (input.good()) {
         auto buf = pool.CheckOut();
+        if (!buf) {
+            break; // Processing failed; error is thrown below
+        }
         auto const maxSize = buf->GetCapacity() * sizeof(BHSPCEvent);
         input.read(reinterpret_cast<char *>(buf->GetData()), maxSize);
         auto const readSize = input.gcount() / sizeof(BHSPCEvent);
@@ -173,7 +235,7 @@ void replay(std::string const &inFilename,
 }
 
 int main(int argc, char *argv[]) {
-    if (argc != 3) {
+    if (argc != 3 && argc != 4) {
         Usage();
         return 1;
     }
@@ -183,6 +245,12 @@ int main(int argc, char *argv[]) {
 
     std::string inFilename(argv[2]);
 
+    bool parallelDecode = argc > 3;
+    unsigned decodeThreads = 0;
+    if (parallelDecode) {
+        std::istringstream(argv[3]) >> decodeThreads;
+    }
+
     MetadataJsonReader jsonReader(inFilename + ".json");
     if (!jsonReader.IsValid()) {
         std::cerr << "Cannot read " << inFilename << ".json\n";
@@ -190,7 +258,7 @@ int main(int argc, char *argv[]) {
     }
 
     try {
-        replay(inFilename, jsonReader, port);
+        replay(inFilename, jsonReader, port, parallelDecode, decodeThreads);
     } catch (std::exception const &e) {
         std::cerr << e.what();
         return 1;
@@ -56,10 +56,11 @@ static int WriteSDTIdentification(FILE *fp, const struct SDTFileData *data) {
             "  Revision  : %u bits ADC" NEWLINE "  Date      : %s" NEWLINE
             "  Time      : %s" NEWLINE "  Author    : Unknown" NEWLINE
             "  Company   : Unknown" NEWLINE
-            "  Contents  : FLIM histogram(s) generated by OpenScan" NEWLINE
-            "*END" NEWLINE NEWLINE,
+            "  Contents  : FLIM histogram(s) generated by OpenScan"
+            " (ADC values %u-%u)" NEWLINE "*END" NEWLINE NEWLINE,
             fcs_data_identifier, // FIFO Image mode data
-            data->histogramBits, data->date, data->time);
+            data->histogramBits, data->date, data->time,
+            data->microtimeGateBegin, data->microtimeGateEnd - 1);
 
         size_t len = strlen(buf);
         if (len >= bufSize - 1) { // May not have fit in buf
@@ -330,13 +331,17 @@ WriteSDTMeasurementDescBlock(FILE *fp, const struct SDTFileData *data,
     return 0;
 }
 
+static size_t HistogramSampleSize(const struct SDTFileData *data) {
+    return data->wideHistogram ? sizeof(uint32_t) : sizeof(uint16_t);
+}
+
 static int WriteSDTHistogramDataBlock(
     FILE *fp, bool useCompression, const struct SDTFileData *data,
-    const struct SDTFileChannelData *channelData, const uint16_t *histogram,
+    const struct SDTFileChannelData *channelData, const void *histogram,
     unsigned *nextBlockOffsetFieldOffset) {
     size_t numSamples =
         data->width * data->height * (1 << data->histogramBits);
-    size_t uncompressedSize = sizeof(uint16_t) * numSamples;
+    size_t uncompressedSize = HistogramSampleSize(data) * numSamples;
 
     // Attempt the compression first, so that we can fall back to uncompressed
     // on failure.
@@ -363,7 +368,8 @@ static int WriteSDTHistogramDataBlock(
     header.data_offs = headerOffset + sizeof(header);
     *nextBlockOffsetFieldOffset =
         headerOffset + offsetof(BHFileBlockHeader, next_block_offs);
-    header.block_type = FIFO_DATA | IMG_BLOCK | DATA_USHORT;
+    header.block_type = FIFO_DATA | IMG_BLOCK |
+                        (data->wideHistogram ? DATA_ULONG : DATA_USHORT);
     if (compressedHisto != NULL) {
         header.block_type |= DATA_ZIPPED;
     }
@@ -456,7 +462,7 @@ static unsigned short HeaderChecksum(const bhfile_header *header) {
 static int
 WriteSDTFileP(FILE *fp, const struct SDTFileData *data,
               const struct SDTFileChannelData *const channelDataArray[],
-              const uint16_t *const channelHistograms[],
+              const void *const channelHistograms[],
               const SPCdata *fifoModeParams) {
     bhfile_header header;
     memset(&header, 0, sizeof(header));
@@ -498,7 +504,8 @@ WriteSDTFileP(FILE *fp, const struct SDTFileData *data,
 
     header.no_of_data_blocks = data->numChannels;
     header.data_block_length = data->width * data->height *
-                               (1 << data->histogramBits) * sizeof(uint16_t);
+                               (1 << data->histogramBits) *
+                               HistogramSampleSize(data);
     header.reserved1 = data->numChannels;
 
     header.data_block_offs = ftell(fp);
@@ -543,7 +550,7 @@ WriteSDTFileP(FILE *fp, const struct SDTFileData *data,
 
 int WriteSDTFile(const char *filename, const struct SDTFileData *data,
                  const struct SDTFileChannelData *const channelDataArray[],
-                 const uint16_t *const channelHistograms[],
+                 const void *const channelHistograms[],
                  const SPCdata *fifoModeParams) {
     FILE *fp = fopen(filename, "wb");
     if (!fp) {
@@ -11,7 +11,13 @@ extern "C" {
 
 // Channel-independent data needed to write an SDT file
 struct SDTFileData {
-    unsigned histogramBits; // 8 to 12
+    unsigned histogramBits; // 6 to 12
+    bool wideHistogram;     // 32-bit (DATA_ULONG) rather than 16-bit bins
+
+    // Photons with ADC value outside [begin, end) were discarded
+    unsigned microtimeGateBegin;
+    unsigned microtimeGateEnd;
+
     unsigned width;
     unsigned height;
     unsigned numChannels;
@@ -69,7 +75,7 @@ struct SDTFileChannelData {
 
 int WriteSDTFile(const char *filename, const struct SDTFileData *data,
                  const struct SDTFileChannelData *const channelDataArray[],
-                 const uint16_t *const channelHistograms[],
+                 const void *const channelHistograms[],
                  const SPCdata *fifoModeParams);
 
 #ifdef __cplusplus
@@ -3,8 +3,10 @@
 #include "AcquisitionCompletion.hpp"
 #include "SDTFile.h"
 
-#include <FLIMEvents/Histogram.hpp>
+#include <FLIMEvents/AdaptiveHistogram.hpp>
 
+#include <algorithm>
+#include <cstdint>
 #include <cstring>
 #include <ctime>
 #include <future>
@@ -23,7 +25,7 @@ class SDTWriter final : public std::enable_shared_from_this<SDTWriter> {
     SPCdata params;
 
     std::mutex mutex; // Protects the next 3 members that are set by upstream
-    std::vector<Histogram<uint16_t>> histograms;
+    std::vector<AdaptiveHistogram> histograms;
     bool finishedRecordingPostAcquisitionData;
     bool canceled;
     bool writeStarted;
@@ -80,12 +82,15 @@ class SDTWriter final : public std::enable_shared_from_this<SDTWriter> {
     // Should be called after setting all SPC parameters but before starting
     // measurement.
     void SetPreacquisitionData(short module, uint32_t histogramBits,
-                               uint32_t width, uint32_t height,
-                               bool useCompression, double pixelRateHz,
-                               bool usePixelMarkers, bool recordPixelMarkers,
-                               bool recordLineMarkers,
+                               uint32_t microtimeGateBegin,
+                               uint32_t microtimeGateEnd, uint32_t width,
+                               uint32_t height, bool useCompression,
+                               double pixelRateHz, bool usePixelMarkers,
+                               bool recordPixelMarkers, bool recordLineMarkers,
                                bool recordFrameMarkers) {
         data.histogramBits = histogramBits;
+        data.microtimeGateBegin = microtimeGateBegin;
+        data.microtimeGateEnd = microtimeGateEnd;
         data.width = width;
         data.height = height;
         data.useCompression = useCompression;
@@ -161,7 +166,7 @@ class SDTWriter final : public std::enable_shared_from_this<SDTWriter> {
 
     // Return value indicates write finish; caller must keep histogram valid
     // until the future completes. Not thread safe.
-    void SetHistogram(unsigned channel, Histogram<uint16_t> &&histogram) {
+    void SetHistogram(unsigned channel, AdaptiveHistogram &&histogram) {
         {
             std::lock_guard<std::mutex> hold(mutex);
             histograms[channel] = std::move(histogram);
@@ -196,9 +201,26 @@ class SDTWriter final : public std::enable_shared_from_this<SDTWriter> {
 
         asyncWriteCompletion =
             std::async(std::launch::async, [self = shared_from_this()] {
-                std::vector<uint16_t const *> histoDataPtrs;
+                // Bins are written as 16-bit unless any count needs 32 bits
+                uint32_t maxCount = 0;
                 for (auto const &h : self->histograms) {
-                    histoDataPtrs.emplace_back(h.Get());
+                    maxCount = std::max(maxCount, h.GetMaxCount());
+                }
+                self->data.wideHistogram = maxCount > UINT16_MAX;
+
+                std::vector<std::vector<uint16_t>> narrowData;
+                std::vector<std::vector<uint32_t>> wideData;
+                std::vector<void const *> histoDataPtrs;
+                for (auto const &h : self->histograms) {
+                    if (self->data.wideHistogram) {
+                        wideData.emplace_back(h.GetNumberOfElements());
+                        h.CopyTo(wideData.back().data());
+                        histoDataPtrs.emplace_back(wideData.back().data());
+                    } else {
+                        narrowData.emplace_back(h.GetNumberOfElements());
+                        h.CopyTo(narrowData.back().data());
+                        histoDataPtrs.emplace_back(narrowData.back().data());
+                    }
                 }
 
                 std::vector<SDTFileChannelData const *> chanDataPtrs;
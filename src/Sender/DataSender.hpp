@@ -5,7 +5,7 @@
 #include "TempDir.hpp"
 #include "UDPSender.hpp"
 
-#include <FLIMEvents/Histogram.hpp>
+#include <FLIMEvents/AdaptiveHistogram.hpp>
 
 #include <chrono>
 #include <future>
@@ -71,7 +71,8 @@ class DataSender final : public std::enable_shared_from_this<DataSender> {
     }
 
     // Assumes channels come in in cyclic order
-    void SetHistogram(unsigned channel, Histogram<uint16_t> const &histogram) {
+    // Counts are sent as 16-bit, clamped
+    void SetHistogram(unsigned channel, AdaptiveHistogram const &histogram) {
         {
             std::lock_guard<std::mutex> hold(mutex);
             if (canceled)
@@ -88,8 +89,7 @@ class DataSender final : public std::enable_shared_from_this<DataSender> {
         }
 
         std::size_t offset = sizeof(uint16_t) * nElems * channel;
-        memcpy(mapped->Get() + offset, histogram.Get(),
-               sizeof(uint16_t) * nElems);
+        histogram.CopyTo(reinterpret_cast<uint16_t *>(mapped->Get() + offset));
 
         if (channel + 1 == nChannels) {
             if (nextSeqNo == 0) {
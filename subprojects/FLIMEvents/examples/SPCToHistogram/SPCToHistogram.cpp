@@ -2,9 +2,12 @@
 #include "FLIMEvents/BHDeviceEvent.hpp"
 #include "FLIMEvents/Histogram.hpp"
 #include "FLIMEvents/LineClockPixellator.hpp"
+#include "FLIMEvents/ParallelBHEventDecoder.hpp"
+#include "FLIMEvents/ParallelHistogrammer.hpp"
 #include "FLIMEvents/StreamBuffer.hpp"
 
 #include <ctime>
+#include <exception>
 #include <fstream>
 #include <future>
 #include <iostream>
@@ -14,8 +17,10 @@
 void Usage() {
     std::cerr
         << "Test driver for histogramming.\n"
-        << "Usage: SPCToHistogram <width> <height> <lineDelay> <lineTime> input.spc output.raw\n"
+        << "Usage: SPCToHistogram <width> <height> <lineDelay> <lineTime> input.spc output.raw [<decodeThreads> [<histogramThreads>]]\n"
         << "where <lineDelay> and <lineTime> are in macro-time units.\n"
+        << "If <decodeThreads> is given, raw events are decoded using that many threads (0 for all cores).\n"
+        << "If <histogramThreads> is given, each frame is histogrammed using that many threads (0 for all cores).\n"
         << "Currently the output contains only the raw cumulative histogram.\n"
         << "Additional numbered files are written, containing the cumulative histogram up to each frame.";
 }
@@ -90,7 +95,7 @@ template <typename T> class HistogramSaver : public HistogramProcessor<T> {
 };
 
 int main(int argc, char *argv[]) {
-    if (argc != 7) {
+    if (argc < 7 || argc > 9) {
         Usage();
         return 1;
     }
@@ -105,47 +110,51 @@ int main(int argc, char *argv[]) {
     std::istringstream(argv[4]) >> lineTime;
     std::string inFilename(argv[5]);
     std::string outFilename(argv[6]);
+    bool parallelDecode = argc > 7;
+    unsigned decodeThreads = 0;
+    if (parallelDecode) {
+        std::istringstream(argv[7]) >> decodeThreads;
+    }
+    bool parallelHistogram = argc > 8;
+    unsigned histogramThreads = 0;
+    if (parallelHistogram) {
+        std::istringstream(argv[8]) >> histogramThreads;
+    }
 
     uint32_t maxFrames = UINT32_MAX;
 
     using SampleType = uint16_t;
     int32_t inputBits = 12;
     int32_t histoBits = 8;
-    Histogram<SampleType> frameHisto(histoBits, inputBits, true, width,
-                                     height);
     Histogram<SampleType> cumulHisto(histoBits, inputBits, true, width,
                                      height);
     cumulHisto.Clear();
 
-    auto processor = std::make_shared<LineClockPixellator>(
-        width, height, maxFrames, lineDelay, lineTime, 1,
-        std::make_shared<Histogrammer<SampleType>>(
-            std::move(frameHisto),
+    auto saver = std::make_shared<HistogramSaver<SampleType>>(outFilename);
+    std::shared_ptr<PixelPhotonProcessor> histogrammer;
+    if (parallelHistogram) {
+        // Each frame is histogrammed by the worker threads and then added to
+        // the cumulative histogram
+        histogrammer = std::make_shared<ParallelHistogrammer<SampleType>>(
+            Histogram<SampleType>(histoBits, inputBits, true, width, height),
+            histogramThreads,
             std::make_shared<HistogramAccumulator<SampleType>>(
-                std::move(cumulHisto),
-                std::make_shared<HistogramSaver<SampleType>>(outFilename))));
-
-    auto decoder = std::make_shared<BHSPCEventDecoder>(processor);
-
-    EventStream<BHSPCEvent> stream;
-    auto processorDone = std::async(std::launch::async, [&stream, decoder] {
-        std::clock_t start = std::clock();
-        for (;;) {
-            auto eventBuffer = stream.ReceiveBlocking();
-            if (!eventBuffer) {
-                break;
-            }
-            decoder->HandleDeviceEvents(
-                reinterpret_cast<char const *>(eventBuffer->GetData()),
-                eventBuffer->GetSize());
-        }
-        std::clock_t elapsed = std::clock() - start;
+                std::move(cumulHisto), saver));
+    } else {
+        histogrammer = std::make_shared<CumulativeHistogrammer<SampleType>>(
+            std::move(cumulHisto), saver);
+    }
 
-        std::cerr << "Approx histogram CPU time: "
-                  << 1000.0 * elapsed / CLOCKS_PER_SEC << " ms\n";
+    auto processor = std::make_shared<LineClockPixellator>(
+        width, height, maxFrames, lineDelay, lineTime, 1, histogrammer);
 
-        decoder->HandleFinish();
-    });
+    std::shared_ptr<DeviceEventProcessor> decoder;
+    if (parallelDecode) {
+        decoder = std::make_shared<ParallelBHSPCEventDecoder>(decodeThreads,
+                                                              processor);
+    } else {
+        decoder = std::make_shared<BHSPCEventDecoder>(processor);
+    }
 
     std::fstream input(inFilename, std::fstream::binary | std::fstream::in);
     if (!input.is_open()) {
@@ -153,11 +162,47 @@ int main(int argc, char *argv[]) {
         return 1;
     }
 
-    EventBufferPool<BHSPCEvent> pool(48 * 1024);
+    // Parallel decoding needs large buffers to be split among threads. The
+    // number of buffers is limited so that reading waits for processing,
+    // rather than loading the whole file into memory. (The pool must outlive
+    // the stream, which may still hold buffers if processing fails.)
+    EventBufferPool<BHSPCEvent> pool(
+        parallelDecode ? 4 * 1024 * 1024 : 48 * 1024, 0, 16,
+        EventBufferPoolPolicy::Block);
+
+    SPSCEventStream<BHSPCEvent> stream;
+    auto processorDone =
+        std::async(std::launch::async, [&stream, &pool, decoder] {
+            std::clock_t start = std::clock();
+            try {
+                for (;;) {
+                    auto eventBuffer = stream.ReceiveBlocking();
+                    if (!eventBuffer) {
+                        break;
+                    }
+                    decoder->HandleDeviceEvents(
+                        reinterpret_cast<char const *>(eventBuffer->GetData()),
+                        eventBuffer->GetSize());
+                }
+            } catch (...) {
+                // Stop the reading loop, which may be waiting for a buffer
+                pool.Cancel();
+                throw;
+            }
+            std::clock_t elapsed = std::clock() - start;
+
+            std::cerr << "Approx histogram CPU time: "
+                      << 1000.0 * elapsed / CLOCKS_PER_SEC << " ms\n";
+
+            decoder->HandleFinish();
+        });
 
     input.seekg(sizeof(BHSPCFileHeader));
     while (input.good()) {
         auto buf = pool.CheckOut();
+        if (!buf) {
+            break; // Processing failed; error is thrown below
+        }
         auto const maxSize = buf->GetCapacity() * sizeof(BHSPCEvent);
         input.read(reinterpret_cast<char *>(buf->GetData()), maxSize);
         auto const readSize = input.gcount() / sizeof(BHSPCEvent);
@@ -166,6 +211,11 @@ int main(int argc, char *argv[]) {
     }
     stream.Send({});
 
-    processorDone.get();
+    try {
+        processorDone.get();
+    } catch (std::exception const &e) {
+        std::cerr << e.what() << '\n';
+        return 1;
+    }
     return 0;
 }
@@ -0,0 +1,307 @@
+#pragma once
+
+#include "Histogram.hpp"
+#include "PixelPhotonEvent.hpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+/**
+ * \brief Histogram with exact counts, stored as 8-bit bins that are widened
+ * on overflow.
+ *
+ * Bins are grouped into blocks of 64 consecutive bins (one cache line of 8-bit
+ * bins). When a bin of an 8-bit block would overflow, the whole block is
+ * promoted to 32-bit bins, stored separately. Histograms with few counts per
+ * bin (short frames, or sparse regions of long acquisitions) thus take half
+ * the memory (and memory traffic) of 16-bit bins, while hot bins count up to
+ * 2^32 - 1 without the silent clipping of Histogram<uint16_t>. Promoted
+ * blocks are allocated in chunks, so that promotion never moves (or copies)
+ * previously promoted blocks.
+ *
+ * Bin indices are as for Histogram: (y * width + x) * nBins + t, the order
+ * used in SDT files and by DataSender.
+ */
+class AdaptiveHistogram {
+    static constexpr std::size_t blockBits = 6;
+    static constexpr std::size_t blockSize = std::size_t(1) << blockBits;
+    static constexpr uint32_t unpromoted = std::numeric_limits<uint32_t>::max();
+    // Promoted blocks per chunk (16 KiB)
+    static constexpr std::size_t chunkBits = 6;
+    static constexpr std::size_t chunkSize = std::size_t(1) << chunkBits;
+
+    uint32_t timeBits;
+    uint32_t inputTimeBits;
+    bool reverseTime;
+    std::size_t width;
+    std::size_t height;
+
+    std::unique_ptr<uint8_t[]> narrow;
+    // For each block, the promotion order of the block (locating its 32-bit
+    // bins in wideChunks), or unpromoted
+    std::vector<uint32_t> blockMap;
+    std::vector<std::unique_ptr<uint32_t[]>> wideChunks;
+    uint32_t promotedCount = 0;
+
+    uint32_t Promote(std::size_t block) {
+        uint32_t const promoted = promotedCount;
+        if ((promoted & (chunkSize - 1)) == 0) {
+            wideChunks.emplace_back(
+                std::make_unique<uint32_t[]>(chunkSize << blockBits));
+        }
+        std::size_t const begin = block << blockBits;
+        std::size_t const end =
+            std::min(begin + blockSize, GetNumberOfElements());
+        std::copy(narrow.get() + begin, narrow.get() + end,
+                  &WideAt(promoted, begin));
+        blockMap[block] = promoted;
+        ++promotedCount;
+        return promoted;
+    }
+
+    uint32_t &WideAt(uint32_t promoted, std::size_t index) noexcept {
+        return wideChunks[promoted >> chunkBits]
+                         [((promoted & (chunkSize - 1)) << blockBits) +
+                          (index & (blockSize - 1))];
+    }
+
+    uint32_t WideAt(uint32_t promoted, std::size_t index) const noexcept {
+        return wideChunks[promoted >> chunkBits]
+                         [((promoted & (chunkSize - 1)) << blockBits) +
+                          (index & (blockSize - 1))];
+    }
+
+  public:
+    ~AdaptiveHistogram() = default;
+    AdaptiveHistogram(AdaptiveHistogram const &rhs) = delete;
+    AdaptiveHistogram &operator=(AdaptiveHistogram const &rhs) = delete;
+    AdaptiveHistogram(AdaptiveHistogram &&rhs) = default;
+    AdaptiveHistogram &operator=(AdaptiveHistogram &&rhs) = default;
+
+    // Default constructor creates a "moved out" object.
+    AdaptiveHistogram() = default;
+
+    // Warning: Newly constructed histogram is not zeroed (for efficiency)
+    AdaptiveHistogram(uint32_t timeBits, uint32_t inputTimeBits,
+                      bool reverseTime, std::size_t width, std::size_t height)
+        : timeBits(timeBits), inputTimeBits(inputTimeBits),
+          reverseTime(reverseTime), width(width), height(height),
+          narrow(std::make_unique<uint8_t[]>(GetNumberOfElements())),
+          blockMap((GetNumberOfElements() + blockSize - 1) >> blockBits,
+                   uint32_t(unpromoted)) {
+        if (timeBits > inputTimeBits) {
+            throw std::invalid_argument(
+                "Histogram time bits must not be greater than input bits");
+        }
+    }
+
+    bool IsValid() const noexcept { return narrow.get(); }
+
+    // Zero all bins, returning all blocks to 8 bits
+    void Clear() noexcept {
+        memset(narrow.get(), 0, GetNumberOfElements());
+        std::fill(blockMap.begin(), blockMap.end(), uint32_t(unpromoted));
+        wideChunks.clear();
+        promotedCount = 0;
+    }
+
+    uint32_t GetTimeBits() const noexcept { return timeBits; }
+
+    uint32_t GetNumberOfTimeBins() const noexcept { return 1 << timeBits; }
+
+    std::size_t GetWidth() const noexcept { return width; }
+
+    std::size_t GetHeight() const noexcept { return height; }
+
+    std::size_t GetNumberOfElements() const noexcept {
+        return GetNumberOfTimeBins() * width * height;
+    }
+
+    // Number of blocks of bins that have been widened to 32 bits
+    std::size_t GetNumberOfPromotedBlocks() const noexcept {
+        return promotedCount;
+    }
+
+    // Index of the bin for the given (input) time and pixel, as for
+    // Histogram
+    std::size_t GetIndex(std::size_t t, std::size_t x,
+                         std::size_t y) const noexcept {
+        auto tReduced = uint16_t(t >> (inputTimeBits - timeBits));
+        auto tReversed =
+            reverseTime ? (1 << timeBits) - 1 - tReduced : tReduced;
+        return (y * width + x) * GetNumberOfTimeBins() + tReversed;
+    }
+
+    HistogramIndexer GetIndexer() const noexcept {
+        return HistogramIndexer(timeBits, inputTimeBits, reverseTime, width);
+    }
+
+    uint32_t GetAt(std::size_t index) const noexcept {
+        uint32_t const promoted = blockMap[index >> blockBits];
+        if (promoted == unpromoted) {
+            return narrow[index];
+        }
+        return WideAt(promoted, index);
+    }
+
+    // Return false if the bin was already at the 32-bit maximum (and so not
+    // changed). Throws std::bad_alloc if a block cannot be promoted.
+    bool IncrementAt(std::size_t index) { return AddAt(index, 1); }
+
+    // Return false if the bin reached the 32-bit maximum (so that not all of
+    // count was added). Throws std::bad_alloc if a block cannot be promoted.
+    bool AddAt(std::size_t index, uint32_t count) {
+        uint32_t promoted = blockMap[index >> blockBits];
+        if (promoted == unpromoted) {
+            if (count <= uint32_t(std::numeric_limits<uint8_t>::max() -
+                                  narrow[index])) {
+                narrow[index] += static_cast<uint8_t>(count);
+                return true;
+            }
+            promoted = Promote(index >> blockBits);
+        }
+        uint32_t &bin = WideAt(promoted, index);
+        if (count > std::numeric_limits<uint32_t>::max() - bin) {
+            bin = std::numeric_limits<uint32_t>::max();
+            return false;
+        }
+        bin += count;
+        return true;
+    }
+
+    uint32_t GetMaxCount() const noexcept {
+        uint32_t result = 0;
+        std::size_t const n = GetNumberOfElements();
+        for (std::size_t block = 0; block < blockMap.size(); ++block) {
+            std::size_t const begin = block << blockBits;
+            std::size_t const end = std::min(begin + blockSize, n);
+            uint32_t const promoted = blockMap[block];
+            for (std::size_t i = begin; i < end; ++i) {
+                uint32_t const count = promoted == unpromoted
+                                           ? narrow[i]
+                                           : WideAt(promoted, i);
+                result = std::max(result, count);
+            }
+        }
+        return result;
+    }
+
+    // Copy the counts to dest (of GetNumberOfElements() elements), clamping
+    // to the maximum value of T
+    template <typename T,
+              typename = std::enable_if_t<std::is_unsigned<T>::value>>
+    void CopyTo(T *dest) const noexcept {
+        uint32_t const maxValue = static_cast<uint32_t>(
+            std::min<uint64_t>(std::numeric_limits<T>::max(),
+                               std::numeric_limits<uint32_t>::max()));
+        std::size_t const n = GetNumberOfElements();
+        for (std::size_t block = 0; block < blockMap.size(); ++block) {
+            std::size_t const begin = block << blockBits;
+            std::size_t const end = std::min(begin + blockSize, n);
+            uint32_t const promoted = blockMap[block];
+            if (promoted == unpromoted) {
+                std::copy(narrow.get() + begin, narrow.get() + end,
+                          dest + begin);
+            } else {
+                for (std::size_t i = begin; i < end; ++i) {
+                    dest[i] = static_cast<T>(
+                        std::min(WideAt(promoted, i), maxValue));
+                }
+            }
+        }
+    }
+};
+
+// Receiver of frame-by-frame adaptive histogram events
+class AdaptiveHistogramProcessor {
+  public:
+    virtual ~AdaptiveHistogramProcessor() = default;
+
+    virtual void HandleError(std::string const &message) = 0;
+    virtual void HandleFrame(AdaptiveHistogram const &histogram) = 0;
+
+    // Upon finishing, the histogram is moved out of its producer.
+    virtual void HandleFinish(AdaptiveHistogram &&histogram,
+                              bool isCompleteFrame) = 0;
+};
+
+// Accumulate photons directly into a cumulative adaptive histogram. Behaves
+// like CumulativeHistogrammer (including counting each frame in a FrameCounts
+// so that an incomplete last frame can be discarded), but counts are exact up
+// to 2^32 - 1 per bin while most bins stay 8 bits wide.
+class AdaptiveCumulativeHistogrammer : public PixelPhotonProcessor {
+    AdaptiveHistogram cumulative;
+    HistogramIndexer const indexer;
+    FrameCounts frame;
+    bool frameInProgress;
+
+    std::shared_ptr<AdaptiveHistogramProcessor> downstream;
+
+  public:
+    // The histogram must be zeroed (or contain counts to continue from)
+    AdaptiveCumulativeHistogrammer(
+        AdaptiveHistogram &&histogram,
+        std::shared_ptr<AdaptiveHistogramProcessor> downstream)
+        : cumulative(std::move(histogram)),
+          indexer(cumulative.GetIndexer()),
+          frame(cumulative.GetNumberOfElements()), frameInProgress(false),
+          downstream(downstream) {}
+
+    void HandleBeginFrame() override {
+        frame.Clear();
+        frameInProgress = true;
+    }
+
+    void HandleEndFrame() override {
+        frame.Drain([this](std::size_t index, uint32_t count) {
+            cumulative.AddAt(index, count);
+        });
+        frameInProgress = false;
+        if (downstream) {
+            downstream->HandleFrame(cumulative);
+        }
+    }
+
+    // Photons outside of frames are ignored, as in CumulativeHistogrammer
+    void HandlePixelPhoton(PixelPhotonEvent const &event) override {
+        if (frameInProgress) {
+            frame.Increment(indexer(event));
+        }
+    }
+
+    void HandlePixelPhotons(PixelPhotonEvent const *events,
+                            std::size_t count) override {
+        if (!frameInProgress) {
+            return;
+        }
+        for (std::size_t i = 0; i < count; ++i) {
+            frame.Increment(indexer(events[i]));
+        }
+    }
+
+    void HandleError(std::string const &message) override {
+        if (downstream) {
+            downstream->HandleError(message);
+            downstream.reset();
+        }
+    }
+
+    void HandleFinish() override {
+        // Discard any incomplete frame, guaranteeing complete frame (all
+        // zeros if there was no frame)
+        frame.Clear();
+        if (downstream) {
+            downstream->HandleFinish(std::move(cumulative), true);
+            downstream.reset();
+        }
+    }
+};
@@ -1,7 +1,17 @@
 #pragma once
 
+#include "CPUFeatures.hpp"
 #include "DeviceEvent.hpp"
 
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <type_traits>
+#include <vector>
+
 // Raw photon event data formats are documented in The bh TCSPC Handbook (see
 // section on FIFO Files in the chapter on Data file structure).
 
@@ -44,6 +54,10 @@ struct BHSPCEvent {
 
     bool GetGapFlag() const noexcept { return bytes[3] & (1 << 5); }
 
+    // Mark data loss before this event, as the device does after a FIFO
+    // overflow. Must not be used on a multiple macro-time overflow record.
+    void SetGapFlag() noexcept { bytes[3] |= 1 << 5; }
+
     bool GetMacroTimeOverflowFlag() const noexcept {
         return bytes[3] & (1 << 6);
     }
@@ -142,6 +156,264 @@ struct BHSPC600Event32 {
     uint32_t GetMultipleMacroTimeOverflowCount() const noexcept { return 0; }
 };
 
+/**
+ * \brief Flag bits of BHSPCEvent, as stored in BHSPCEventLanes::flags.
+ */
+enum BHSPCEventFlag : uint8_t {
+    BHSPCEventFlagMarker = 1 << 0,
+    BHSPCEventFlagGap = 1 << 1,
+    BHSPCEventFlagMacroTimeOverflow = 1 << 2,
+    BHSPCEventFlagInvalid = 1 << 3,
+};
+
+/**
+ * \brief Fields of a buffer of BHSPCEvent records, extracted into separate
+ * arrays.
+ *
+ * Element i of each array corresponds to record i. The fields are extracted
+ * uniformly from every record, so for multiple macro-time overflow records
+ * they contain pieces of the overflow count and should be ignored.
+ */
+struct BHSPCEventLanes {
+    std::vector<uint16_t> macrotime; // GetMacroTime()
+    std::vector<uint16_t> adcValue;  // GetADCValue()
+    std::vector<uint8_t> route;      // GetRoutingSignals() (or marker bits)
+    std::vector<uint8_t> flags;      // BHSPCEventFlag bits
+
+    // Macro-time of the last overflow, including any overflow recorded in
+    // this record (same as the decoder's running macro-time base). The
+    // absolute macro-time of the record is macrotimeBase + macrotime.
+    std::vector<uint64_t> macrotimeBase;
+
+    void Resize(std::size_t count) {
+        macrotime.resize(count);
+        adcValue.resize(count);
+        route.resize(count);
+        flags.resize(count);
+        macrotimeBase.resize(count);
+    }
+};
+
+// Classify records [begin, end); lanes must have at least end elements.
+// Returns the macro-time base after the last record.
+inline uint64_t ClassifyBHSPCEventsScalar(BHSPCEvent const *events,
+                                          std::size_t begin, std::size_t end,
+                                          uint64_t macrotimeBase,
+                                          BHSPCEventLanes &lanes) noexcept {
+    for (std::size_t i = begin; i < end; ++i) {
+        BHSPCEvent const &e = events[i];
+        lanes.macrotime[i] = e.GetMacroTime();
+        lanes.adcValue[i] = e.GetADCValue();
+        lanes.route[i] = e.GetRoutingSignals();
+        lanes.flags[i] = e.bytes[3] >> 4;
+        if (e.IsMultipleMacroTimeOverflow()) {
+            macrotimeBase += BHSPCEvent::MacroTimeOverflowPeriod *
+                             e.GetMultipleMacroTimeOverflowCount();
+        } else if (e.GetMacroTimeOverflowFlag()) {
+            macrotimeBase += BHSPCEvent::MacroTimeOverflowPeriod;
+        }
+        lanes.macrotimeBase[i] = macrotimeBase;
+    }
+    return macrotimeBase;
+}
+
+// The vectorized kernels load each 4-byte record as a little-endian 32-bit
+// integer (x86 is little-endian), in which the fields are:
+//   bits 0-11: macro-time, 12-15: route, 16-27: ADC value, 28-31: flags
+// and bits 0-27 are the count of a multiple macro-time overflow record.
+
+#ifdef FLIMEVENTS_X86_64
+
+// Processes 4 records per iteration.
+inline uint64_t ClassifyBHSPCEventsSSE2(BHSPCEvent const *events,
+                                        std::size_t begin, std::size_t end,
+                                        uint64_t macrotimeBase,
+                                        BHSPCEventLanes &lanes) noexcept {
+    __m128i const mask12 = _mm_set1_epi32(0x0fff);
+    __m128i const mask4 = _mm_set1_epi32(0x0f);
+    __m128i const mask28 = _mm_set1_epi32(0x0fffffff);
+    __m128i const one = _mm_set1_epi32(1);
+    __m128i const flagMask = _mm_set1_epi32(
+        BHSPCEventFlagInvalid | BHSPCEventFlagMacroTimeOverflow |
+        BHSPCEventFlagMarker);
+    __m128i const multipleFlags = _mm_set1_epi32(
+        BHSPCEventFlagInvalid | BHSPCEventFlagMacroTimeOverflow);
+    __m128i const overflowFlag =
+        _mm_set1_epi32(BHSPCEventFlagMacroTimeOverflow);
+
+    std::size_t i = begin;
+    for (; i + 4 <= end; i += 4) {
+        __m128i v = _mm_loadu_si128(
+            reinterpret_cast<__m128i const *>(events + i));
+
+        __m128i mt = _mm_and_si128(v, mask12);
+        __m128i route = _mm_and_si128(_mm_srli_epi32(v, 12), mask4);
+        __m128i adc = _mm_and_si128(_mm_srli_epi32(v, 16), mask12);
+        __m128i flags = _mm_srli_epi32(v, 28);
+
+        // Values are small, so signed saturation in packs is harmless
+        _mm_storel_epi64(
+            reinterpret_cast<__m128i *>(lanes.macrotime.data() + i),
+            _mm_packs_epi32(mt, mt));
+        _mm_storel_epi64(
+            reinterpret_cast<__m128i *>(lanes.adcValue.data() + i),
+            _mm_packs_epi32(adc, adc));
+        __m128i route16 = _mm_packs_epi32(route, route);
+        int route8 = _mm_cvtsi128_si32(_mm_packus_epi16(route16, route16));
+        std::memcpy(lanes.route.data() + i, &route8, 4);
+        __m128i flags16 = _mm_packs_epi32(flags, flags);
+        int flags8 = _mm_cvtsi128_si32(_mm_packus_epi16(flags16, flags16));
+        std::memcpy(lanes.flags.data() + i, &flags8, 4);
+
+        // Number of overflows in each record
+        __m128i isMultiple = _mm_cmpeq_epi32(_mm_and_si128(flags, flagMask),
+                                             multipleFlags);
+        __m128i isSingle = _mm_cmpeq_epi32(
+            _mm_and_si128(flags, overflowFlag), overflowFlag);
+        __m128i n = _mm_or_si128(
+            _mm_and_si128(isMultiple, _mm_and_si128(v, mask28)),
+            _mm_andnot_si128(isMultiple, _mm_and_si128(isSingle, one)));
+
+        // Inclusive prefix sum (4 x 28 bits does not overflow 32 bits)
+        n = _mm_add_epi32(n, _mm_slli_si128(n, 4));
+        n = _mm_add_epi32(n, _mm_slli_si128(n, 8));
+
+        // Widen to 64 bits, scale by period, and add base
+        __m128i base = _mm_set1_epi64x(static_cast<long long>(macrotimeBase));
+        __m128i zero = _mm_setzero_si128();
+        __m128i lo = _mm_add_epi64(
+            base, _mm_slli_epi64(_mm_unpacklo_epi32(n, zero), 12));
+        __m128i hi = _mm_add_epi64(
+            base, _mm_slli_epi64(_mm_unpackhi_epi32(n, zero), 12));
+        _mm_storeu_si128(
+            reinterpret_cast<__m128i *>(lanes.macrotimeBase.data() + i), lo);
+        _mm_storeu_si128(
+            reinterpret_cast<__m128i *>(lanes.macrotimeBase.data() + i + 2),
+            hi);
+
+        macrotimeBase = lanes.macrotimeBase[i + 3];
+    }
+    return ClassifyBHSPCEventsScalar(events, i, end, macrotimeBase, lanes);
+}
+
+// Processes 8 records per iteration.
+FLIMEVENTS_TARGET_AVX2 inline uint64_t
+ClassifyBHSPCEventsAVX2(BHSPCEvent const *events, std::size_t begin,
+                        std::size_t end, uint64_t macrotimeBase,
+                        BHSPCEventLanes &lanes) noexcept {
+    __m256i const mask12 = _mm256_set1_epi32(0x0fff);
+    __m256i const mask4 = _mm256_set1_epi32(0x0f);
+    __m256i const mask28 = _mm256_set1_epi32(0x0fffffff);
+    __m256i const one = _mm256_set1_epi32(1);
+    __m256i const flagMask = _mm256_set1_epi32(
+        BHSPCEventFlagInvalid | BHSPCEventFlagMacroTimeOverflow |
+        BHSPCEventFlagMarker);
+    __m256i const multipleFlags = _mm256_set1_epi32(
+        BHSPCEventFlagInvalid | BHSPCEventFlagMacroTimeOverflow);
+    __m256i const overflowFlag =
+        _mm256_set1_epi32(BHSPCEventFlagMacroTimeOverflow);
+    // Gathers dwords 0 and 4 (the low 4 bytes of each 128-bit lane)
+    __m256i const gatherLanes = _mm256_setr_epi32(0, 4, 0, 0, 0, 0, 0, 0);
+    __m256i const broadcast3 = _mm256_set1_epi32(3);
+
+    std::size_t i = begin;
+    for (; i + 8 <= end; i += 8) {
+        __m256i v = _mm256_loadu_si256(
+            reinterpret_cast<__m256i const *>(events + i));
+
+        __m256i mt = _mm256_and_si256(v, mask12);
+        __m256i route = _mm256_and_si256(_mm256_srli_epi32(v, 12), mask4);
+        __m256i adc = _mm256_and_si256(_mm256_srli_epi32(v, 16), mask12);
+        __m256i flags = _mm256_srli_epi32(v, 28);
+
+        // Packing works within 128-bit lanes, so reorder afterwards
+        __m256i mt16 =
+            _mm256_permute4x64_epi64(_mm256_packs_epi32(mt, mt), 0x08);
+        _mm_storeu_si128(
+            reinterpret_cast<__m128i *>(lanes.macrotime.data() + i),
+            _mm256_castsi256_si128(mt16));
+        __m256i adc16 =
+            _mm256_permute4x64_epi64(_mm256_packs_epi32(adc, adc), 0x08);
+        _mm_storeu_si128(
+            reinterpret_cast<__m128i *>(lanes.adcValue.data() + i),
+            _mm256_castsi256_si128(adc16));
+        __m256i route16 = _mm256_packs_epi32(route, route);
+        __m256i route8 = _mm256_permutevar8x32_epi32(
+            _mm256_packus_epi16(route16, route16), gatherLanes);
+        _mm_storel_epi64(reinterpret_cast<__m128i *>(lanes.route.data() + i),
+                         _mm256_castsi256_si128(route8));
+        __m256i flags16 = _mm256_packs_epi32(flags, flags);
+        __m256i flags8 = _mm256_permutevar8x32_epi32(
+            _mm256_packus_epi16(flags16, flags16), gatherLanes);
+        _mm_storel_epi64(reinterpret_cast<__m128i *>(lanes.flags.data() + i),
+                         _mm256_castsi256_si128(flags8));
+
+        // Number of overflows in each record
+        __m256i isMultiple = _mm256_cmpeq_epi32(
+            _mm256_and_si256(flags, flagMask), multipleFlags);
+        __m256i isSingle = _mm256_cmpeq_epi32(
+            _mm256_and_si256(flags, overflowFlag), overflowFlag);
+        __m256i n = _mm256_blendv_epi8(_mm256_and_si256(isSingle, one),
+                                       _mm256_and_si256(v, mask28),
+                                       isMultiple);
+
+        // Inclusive prefix sum within each 128-bit lane, then carry the low
+        // lane's total into the high lane (8 x 28 bits fits in 32 bits)
+        n = _mm256_add_epi32(n, _mm256_slli_si256(n, 4));
+        n = _mm256_add_epi32(n, _mm256_slli_si256(n, 8));
+        __m256i carry = _mm256_blend_epi32(
+            _mm256_setzero_si256(),
+            _mm256_permutevar8x32_epi32(n, broadcast3), 0xf0);
+        n = _mm256_add_epi32(n, carry);
+
+        // Widen to 64 bits, scale by period, and add base
+        __m256i base =
+            _mm256_set1_epi64x(static_cast<long long>(macrotimeBase));
+        __m256i lo = _mm256_add_epi64(
+            base, _mm256_slli_epi64(
+                      _mm256_cvtepu32_epi64(_mm256_castsi256_si128(n)), 12));
+        __m256i hi = _mm256_add_epi64(
+            base,
+            _mm256_slli_epi64(
+                _mm256_cvtepu32_epi64(_mm256_extracti128_si256(n, 1)), 12));
+        _mm256_storeu_si256(
+            reinterpret_cast<__m256i *>(lanes.macrotimeBase.data() + i), lo);
+        _mm256_storeu_si256(
+            reinterpret_cast<__m256i *>(lanes.macrotimeBase.data() + i + 4),
+            hi);
+
+        macrotimeBase = lanes.macrotimeBase[i + 7];
+    }
+    return ClassifyBHSPCEventsScalar(events, i, end, macrotimeBase, lanes);
+}
+
+#endif // FLIMEVENTS_X86_64
+
+/**
+ * \brief Extract the fields of a buffer of BHSPCEvent records into
+ * BHSPCEventLanes, using the widest available SIMD instruction set.
+ *
+ * \param macrotimeBase the macro-time base before the first record; updated
+ * to the base after the last record
+ */
+inline void ClassifyBHSPCEvents(BHSPCEvent const *events, std::size_t count,
+                                uint64_t &macrotimeBase,
+                                BHSPCEventLanes &lanes) {
+    lanes.Resize(count);
+#ifdef FLIMEVENTS_X86_64
+    if (CPUFeatures::Get().avx2) {
+        macrotimeBase =
+            ClassifyBHSPCEventsAVX2(events, 0, count, macrotimeBase, lanes);
+    } else {
+        macrotimeBase =
+            ClassifyBHSPCEventsSSE2(events, 0, count, macrotimeBase, lanes);
+    }
+#else
+    macrotimeBase =
+        ClassifyBHSPCEventsScalar(events, 0, count, macrotimeBase, lanes);
+#endif
+}
+
 /**
  * \brief Decode BH SPC event stream.
  *
@@ -154,67 +426,167 @@ template <typename E> class BHEventDecoder : public DeviceEventDecoder {
     uint64_t macrotimeBase; // Time of last overflow
     uint64_t lastMacrotime;
 
-  public:
-    BHEventDecoder(std::shared_ptr<DecodedEventProcessor> downstream)
-        : DeviceEventDecoder(downstream), macrotimeBase(0), lastMacrotime(0) {}
-
-    std::size_t GetEventSize() const noexcept override { return sizeof(E); }
+    // Valid photons are collected here and sent downstream as a batch. Any
+    // other event causes the pending batch to be sent first, so that
+    // downstream sees all events in their original order.
+    std::array<ValidPhotonEvent, 1024> photonBatch;
+    std::size_t photonBatchSize;
+
+    // For BHSPCEvent, records are classified (using SIMD) in chunks of this
+    // size, small enough for the lanes to stay in L1 cache
+    static constexpr std::size_t classifyChunkSize = 1024;
+    BHSPCEventLanes lanes;
+
+    void SendPendingPhotons() {
+        if (photonBatchSize > 0) {
+            SendValidPhotons(photonBatch.data(), photonBatchSize);
+            photonBatchSize = 0;
+        }
+    }
 
-    void HandleDeviceEvent(char const *event) override {
-        E const *devEvt = reinterpret_cast<E const *>(event);
+    void AddValidPhoton(uint64_t macrotime, uint16_t microtime,
+                        uint8_t route) {
+        ValidPhotonEvent &e = photonBatch[photonBatchSize++];
+        e.macrotime = macrotime;
+        e.microtime = microtime;
+        e.route = route;
+        if (photonBatchSize == photonBatch.size()) {
+            SendPendingPhotons();
+        }
+    }
 
-        if (devEvt->IsMultipleMacroTimeOverflow()) {
+    // Non-virtual so that it can be inlined into the batch loop
+    void DecodeEvent(E const &devEvt) {
+        if (devEvt.IsMultipleMacroTimeOverflow()) {
             macrotimeBase += E::MacroTimeOverflowPeriod *
-                             devEvt->GetMultipleMacroTimeOverflowCount();
+                             devEvt.GetMultipleMacroTimeOverflowCount();
 
+            SendPendingPhotons();
             DecodedEvent e;
             e.macrotime = macrotimeBase;
             SendTimestamp(e);
             return;
         }
 
-        if (devEvt->GetMacroTimeOverflowFlag()) {
+        if (devEvt.GetMacroTimeOverflowFlag()) {
             macrotimeBase += E::MacroTimeOverflowPeriod;
         }
 
-        uint64_t macrotime = macrotimeBase + devEvt->GetMacroTime();
+        uint64_t macrotime = macrotimeBase + devEvt.GetMacroTime();
 
         // Validate input: ensure macrotime is non-decreasing (a common
         // assumption made by downstream processors)
         if (macrotime < lastMacrotime) {
+            SendPendingPhotons();
             SendError("Decreasing macro-time encountered");
             return;
         }
         lastMacrotime = macrotime;
 
-        if (devEvt->GetGapFlag()) {
+        if (devEvt.GetGapFlag()) {
+            SendPendingPhotons();
             DataLostEvent e;
             e.macrotime = macrotime;
             SendDataLost(e);
         }
 
-        if (devEvt->GetMarkerFlag()) {
+        if (devEvt.GetMarkerFlag()) {
+            SendPendingPhotons();
             MarkerEvent e;
             e.macrotime = macrotime;
-            e.bits = devEvt->GetMarkerBits();
+            e.bits = devEvt.GetMarkerBits();
             SendMarker(e);
             return;
         }
 
-        if (devEvt->GetInvalidFlag()) {
+        if (devEvt.GetInvalidFlag()) {
+            SendPendingPhotons();
             InvalidPhotonEvent e;
             e.macrotime = macrotime;
-            e.microtime = devEvt->GetADCValue();
-            e.route = devEvt->GetRoutingSignals();
+            e.microtime = devEvt.GetADCValue();
+            e.route = devEvt.GetRoutingSignals();
             SendInvalidPhoton(e);
         } else {
-            ValidPhotonEvent e;
-            e.macrotime = macrotime;
-            e.microtime = devEvt->GetADCValue();
-            e.route = devEvt->GetRoutingSignals();
-            SendValidPhoton(e);
+            AddValidPhoton(macrotime, devEvt.GetADCValue(),
+                           devEvt.GetRoutingSignals());
+        }
+    }
+
+    void DecodeEvents(E const *devEvts, std::size_t count, std::false_type) {
+        for (std::size_t i = 0; i < count; ++i) {
+            DecodeEvent(devEvts[i]);
+        }
+    }
+
+    // BHSPCEvent: valid photons (the vast majority of records) are decoded
+    // directly from the classified lanes; other records by DecodeEvent().
+    void DecodeEvents(E const *devEvts, std::size_t count, std::true_type) {
+        for (std::size_t begin = 0; begin < count;
+             begin += classifyChunkSize) {
+            std::size_t const n = std::min(classifyChunkSize, count - begin);
+            uint64_t const chunkBase = macrotimeBase;
+            uint64_t endBase = macrotimeBase;
+            ClassifyBHSPCEvents(devEvts + begin, n, endBase, lanes);
+            // Local copies, so that the compiler can keep them in registers
+            uint64_t const *bases = lanes.macrotimeBase.data();
+            uint16_t const *macrotimes = lanes.macrotime.data();
+            uint16_t const *adcValues = lanes.adcValue.data();
+            uint8_t const *routes = lanes.route.data();
+            uint8_t const *flags = lanes.flags.data();
+            uint64_t last = lastMacrotime;
+            for (std::size_t i = 0; i < n; ++i) {
+                uint64_t const macrotime = bases[i] + macrotimes[i];
+                if ((flags[i] & ~BHSPCEventFlagMacroTimeOverflow) == 0 &&
+                    macrotime >= last) {
+                    last = macrotime;
+                    ValidPhotonEvent &e = photonBatch[photonBatchSize++];
+                    e.macrotime = macrotime;
+                    e.microtime = adcValues[i];
+                    e.route = routes[i];
+                    if (photonBatchSize == photonBatch.size()) {
+                        SendPendingPhotons();
+                    }
+                } else {
+                    // Base before this record, which DecodeEvent() updates
+                    macrotimeBase = i > 0 ? bases[i - 1] : chunkBase;
+                    lastMacrotime = last;
+                    DecodeEvent(devEvts[begin + i]);
+                    last = lastMacrotime;
+                }
+            }
+            lastMacrotime = last;
+            macrotimeBase = endBase;
         }
     }
+
+  public:
+    BHEventDecoder(std::shared_ptr<DecodedEventProcessor> downstream)
+        : DeviceEventDecoder(downstream), macrotimeBase(0), lastMacrotime(0),
+          photonBatchSize(0) {}
+
+    // Start in the given state, for decoding part of a stream (the state can
+    // be obtained from a decoder that handled the preceding records).
+    BHEventDecoder(std::shared_ptr<DecodedEventProcessor> downstream,
+                   uint64_t macrotimeBase, uint64_t lastMacrotime)
+        : DeviceEventDecoder(downstream), macrotimeBase(macrotimeBase),
+          lastMacrotime(lastMacrotime), photonBatchSize(0) {}
+
+    uint64_t GetMacrotimeBase() const noexcept { return macrotimeBase; }
+
+    uint64_t GetLastMacrotime() const noexcept { return lastMacrotime; }
+
+    std::size_t GetEventSize() const noexcept override { return sizeof(E); }
+
+    void HandleDeviceEvent(char const *event) override {
+        DecodeEvent(*reinterpret_cast<E const *>(event));
+        SendPendingPhotons();
+    }
+
+    void HandleDeviceEvents(char const *events, std::size_t count) override {
+        DecodeEvents(reinterpret_cast<E const *>(events), count,
+                     std::is_same<E, BHSPCEvent>());
+        SendPendingPhotons();
+    }
 };
 
 using BHSPCEventDecoder = BHEventDecoder<BHSPCEvent>;
@@ -0,0 +1,64 @@
+#pragma once
+
+// Runtime detection of x86 SIMD instruction set extensions, for choosing
+// between vectorized and scalar code paths.
+
+// SSE2 is part of the x86-64 baseline and is used unconditionally on that
+// architecture. Wider instruction sets (AVX2) are only used after checking
+// CPU (and OS) support at run time. On other architectures only scalar code
+// is used.
+
+#if defined(_M_X64) || defined(__x86_64__)
+#define FLIMEVENTS_X86_64 1
+#endif
+
+#ifdef FLIMEVENTS_X86_64
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+// Functions using AVX2 intrinsics must be marked with this. GCC and Clang
+// (including clang-cl) otherwise refuse to compile AVX2 intrinsics unless the
+// whole translation unit is built for AVX2; MSVC needs no annotation.
+#if defined(FLIMEVENTS_X86_64) && (defined(__GNUC__) || defined(__clang__))
+#define FLIMEVENTS_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define FLIMEVENTS_TARGET_AVX2
+#endif
+
+struct CPUFeatures {
+    bool avx2;
+
+    // Detected once, on first call
+    static CPUFeatures const &Get() {
+        static CPUFeatures const features = Detect();
+        return features;
+    }
+
+  private:
+    static CPUFeatures Detect() noexcept {
+        CPUFeatures f;
+        f.avx2 = false;
+#if defined(FLIMEVENTS_X86_64) && defined(_MSC_VER)
+        int regs[4];
+        __cpuid(regs, 0);
+        int maxLeaf = regs[0];
+        if (maxLeaf >= 7) {
+            __cpuid(regs, 1);
+            bool osxsave = regs[2] & (1 << 27);
+            bool avx = regs[2] & (1 << 28);
+            // The OS must save the YMM registers on context switch
+            bool ymmEnabled =
+                osxsave && avx && (_xgetbv(0) & 0x6) == 0x6;
+            __cpuidex(regs, 7, 0);
+            f.avx2 = ymmEnabled && (regs[1] & (1 << 5));
+        }
+#elif defined(FLIMEVENTS_X86_64)
+        __builtin_cpu_init();
+        f.avx2 = __builtin_cpu_supports("avx2");
+#endif
+        return f;
+    }
+};
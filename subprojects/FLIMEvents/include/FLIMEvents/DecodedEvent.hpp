@@ -1,5 +1,6 @@
 #pragma once
 
+#include <cstddef>
 #include <cstdint>
 #include <string>
 
@@ -111,6 +112,23 @@ class DecodedEventProcessor {
     virtual void HandleTimestamp(DecodedEvent const &event) = 0;
 
     virtual void HandleValidPhoton(ValidPhotonEvent const &event) = 0;
+
+    /**
+     * \brief Receive a run of consecutive valid photons.
+     *
+     * Decoders call this instead of HandleValidPhoton() when they have
+     * several photons with no other event in between, so that the cost of a
+     * virtual call is paid once per batch rather than once per photon.
+     *
+     * The default implementation calls HandleValidPhoton() for each photon.
+     */
+    virtual void HandleValidPhotons(ValidPhotonEvent const *events,
+                                    std::size_t count) {
+        for (std::size_t i = 0; i < count; ++i) {
+            HandleValidPhoton(events[i]);
+        }
+    }
+
     virtual void HandleInvalidPhoton(InvalidPhotonEvent const &event) = 0;
     virtual void HandleMarker(MarkerEvent const &event) = 0;
     virtual void HandleDataLost(DataLostEvent const &event) = 0;
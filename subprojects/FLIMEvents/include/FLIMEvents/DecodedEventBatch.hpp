@@ -0,0 +1,286 @@
+#pragma once
+
+#include "DecodedEvent.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+/**
+ * \brief A batch of decoded events, with valid photons stored column-wise.
+ *
+ * Valid photons, which make up the vast majority of events, are stored in the
+ * parallel arrays macrotime, microtime, and route, so that processors can
+ * operate on a whole column at a time.
+ *
+ * All other events (timestamps, invalid photons, markers, and data lost
+ * events) are stored in a separate, sparse list. Each of these records the
+ * number of valid photons that precede it in the batch, so that the original
+ * order of events can be reconstructed.
+ */
+struct DecodedEventBatch {
+    std::vector<uint64_t> macrotime;
+    std::vector<uint16_t> microtime;
+    std::vector<uint16_t> route;
+
+    enum class OtherEventType : uint8_t {
+        Timestamp,
+        InvalidPhoton,
+        Marker,
+        DataLost,
+    };
+
+    struct OtherEvent {
+        uint64_t macrotime;
+        std::size_t photonIndex; // Number of valid photons before this event
+        OtherEventType type;
+        uint16_t microtime; // InvalidPhoton only
+        uint16_t route;     // InvalidPhoton only
+        uint16_t bits;      // Marker only
+    };
+
+    std::vector<OtherEvent> others;
+
+    std::size_t GetNumberOfPhotons() const noexcept { return macrotime.size(); }
+
+    bool IsEmpty() const noexcept {
+        return macrotime.empty() && others.empty();
+    }
+
+    void Clear() noexcept {
+        macrotime.clear();
+        microtime.clear();
+        route.clear();
+        others.clear();
+    }
+
+    void ReservePhotons(std::size_t count) {
+        macrotime.reserve(count);
+        microtime.reserve(count);
+        route.reserve(count);
+    }
+
+    void AddValidPhoton(ValidPhotonEvent const &event) {
+        macrotime.push_back(event.macrotime);
+        microtime.push_back(event.microtime);
+        route.push_back(event.route);
+    }
+
+    void AddTimestamp(DecodedEvent const &event) {
+        AddOther(OtherEventType::Timestamp, event.macrotime, 0, 0, 0);
+    }
+
+    void AddInvalidPhoton(InvalidPhotonEvent const &event) {
+        AddOther(OtherEventType::InvalidPhoton, event.macrotime,
+                 event.microtime, event.route, 0);
+    }
+
+    void AddMarker(MarkerEvent const &event) {
+        AddOther(OtherEventType::Marker, event.macrotime, 0, 0, event.bits);
+    }
+
+    void AddDataLost(DataLostEvent const &event) {
+        AddOther(OtherEventType::DataLost, event.macrotime, 0, 0, 0);
+    }
+
+  private:
+    void AddOther(OtherEventType type, uint64_t mt, uint16_t microtime,
+                  uint16_t route, uint16_t bits) {
+        OtherEvent e;
+        e.macrotime = mt;
+        e.photonIndex = macrotime.size();
+        e.type = type;
+        e.microtime = microtime;
+        e.route = route;
+        e.bits = bits;
+        others.push_back(e);
+    }
+};
+
+/**
+ * \brief Receiver of batches of decoded events.
+ */
+class DecodedBatchProcessor {
+  public:
+    virtual ~DecodedBatchProcessor() = default;
+
+    virtual void HandleDecodedEventBatch(DecodedEventBatch const &batch) = 0;
+    virtual void HandleError(std::string const &message) = 0;
+    virtual void HandleFinish() = 0;
+};
+
+/**
+ * \brief Adapter collecting decoded events into batches.
+ *
+ * A batch is sent downstream when it contains the given number of valid
+ * photons, or when a timestamp is received. Decoders of raw device events
+ * send timestamps on each macro-time overflow, so this bounds the latency.
+ */
+class DecodedEventToBatchAdapter : public DecodedEventProcessor {
+    std::size_t const maxPhotons;
+    DecodedEventBatch batch;
+
+    std::shared_ptr<DecodedBatchProcessor> downstream;
+
+    void SendBatchIfFull() {
+        if (batch.GetNumberOfPhotons() >= maxPhotons) {
+            Flush();
+        }
+    }
+
+  public:
+    explicit DecodedEventToBatchAdapter(
+        std::size_t maxPhotons,
+        std::shared_ptr<DecodedBatchProcessor> downstream)
+        : maxPhotons(maxPhotons), downstream(downstream) {
+        batch.ReservePhotons(maxPhotons);
+    }
+
+    // Send any buffered events downstream
+    void Flush() {
+        if (!batch.IsEmpty() && downstream) {
+            downstream->HandleDecodedEventBatch(batch);
+        }
+        batch.Clear();
+    }
+
+    void HandleTimestamp(DecodedEvent const &event) override {
+        batch.AddTimestamp(event);
+        Flush();
+    }
+
+    void HandleValidPhoton(ValidPhotonEvent const &event) override {
+        batch.AddValidPhoton(event);
+        SendBatchIfFull();
+    }
+
+    void HandleValidPhotons(ValidPhotonEvent const *events,
+                            std::size_t count) override {
+        for (std::size_t i = 0; i < count; ++i) {
+            batch.AddValidPhoton(events[i]);
+        }
+        SendBatchIfFull();
+    }
+
+    void HandleInvalidPhoton(InvalidPhotonEvent const &event) override {
+        batch.AddInvalidPhoton(event);
+    }
+
+    void HandleMarker(MarkerEvent const &event) override {
+        batch.AddMarker(event);
+    }
+
+    void HandleDataLost(DataLostEvent const &event) override {
+        batch.AddDataLost(event);
+    }
+
+    void HandleError(std::string const &message) override {
+        Flush();
+        if (downstream) {
+            downstream->HandleError(message);
+            downstream.reset();
+        }
+    }
+
+    void HandleFinish() override {
+        Flush();
+        if (downstream) {
+            downstream->HandleFinish();
+            downstream.reset();
+        }
+    }
+};
+
+/**
+ * \brief Adapter sending the events of each batch, in their original order,
+ * to a DecodedEventProcessor.
+ *
+ * Consecutive valid photons are sent with HandleValidPhotons().
+ */
+class DecodedBatchToEventAdapter : public DecodedBatchProcessor {
+    std::vector<ValidPhotonEvent> photons; // Scratch space
+
+    std::shared_ptr<DecodedEventProcessor> downstream;
+
+    void SendPhotons(DecodedEventBatch const &batch, std::size_t begin,
+                     std::size_t end) {
+        if (begin == end) {
+            return;
+        }
+        photons.resize(end - begin);
+        for (std::size_t i = begin; i < end; ++i) {
+            ValidPhotonEvent &e = photons[i - begin];
+            e.macrotime = batch.macrotime[i];
+            e.microtime = batch.microtime[i];
+            e.route = batch.route[i];
+        }
+        downstream->HandleValidPhotons(photons.data(), photons.size());
+    }
+
+    void SendOther(DecodedEventBatch::OtherEvent const &other) {
+        using Type = DecodedEventBatch::OtherEventType;
+        switch (other.type) {
+        case Type::Timestamp: {
+            DecodedEvent e;
+            e.macrotime = other.macrotime;
+            downstream->HandleTimestamp(e);
+            break;
+        }
+        case Type::InvalidPhoton: {
+            InvalidPhotonEvent e;
+            e.macrotime = other.macrotime;
+            e.microtime = other.microtime;
+            e.route = other.route;
+            downstream->HandleInvalidPhoton(e);
+            break;
+        }
+        case Type::Marker: {
+            MarkerEvent e;
+            e.macrotime = other.macrotime;
+            e.bits = other.bits;
+            downstream->HandleMarker(e);
+            break;
+        }
+        case Type::DataLost: {
+            DataLostEvent e;
+            e.macrotime = other.macrotime;
+            downstream->HandleDataLost(e);
+            break;
+        }
+        }
+    }
+
+  public:
+    explicit DecodedBatchToEventAdapter(
+        std::shared_ptr<DecodedEventProcessor> downstream)
+        : downstream(downstream) {}
+
+    void HandleDecodedEventBatch(DecodedEventBatch const &batch) override {
+        if (!downstream) {
+            return;
+        }
+        std::size_t sent = 0;
+        for (auto const &other : batch.others) {
+            SendPhotons(batch, sent, other.photonIndex);
+            sent = other.photonIndex;
+            SendOther(other);
+        }
+        SendPhotons(batch, sent, batch.GetNumberOfPhotons());
+    }
+
+    void HandleError(std::string const &message) override {
+        if (downstream) {
+            downstream->HandleError(message);
+            downstream.reset();
+        }
+    }
+
+    void HandleFinish() override {
+        if (downstream) {
+            downstream->HandleFinish();
+            downstream.reset();
+        }
+    }
+};
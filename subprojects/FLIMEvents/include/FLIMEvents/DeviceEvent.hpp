@@ -40,6 +40,12 @@ class DeviceEventDecoder : public DeviceEventProcessor {
         }
     }
 
+    void SendValidPhotons(ValidPhotonEvent const *events, std::size_t count) {
+        if (downstream) {
+            downstream->HandleValidPhotons(events, count);
+        }
+    }
+
     void SendInvalidPhoton(InvalidPhotonEvent const &event) {
         if (downstream) {
             downstream->HandleInvalidPhoton(event);
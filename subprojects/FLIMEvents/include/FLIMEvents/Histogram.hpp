@@ -1,10 +1,16 @@
 #pragma once
 
+#include "CPUFeatures.hpp"
 #include "PixelPhotonEvent.hpp"
 
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
 #include <cstring>
 #include <deque>
+#include <limits>
 #include <memory>
+#include <stdexcept>
 #include <string>
 #include <type_traits>
 #include <vector>
@@ -19,6 +25,175 @@ inline T SaturatingAdd(T a, U b) {
     return c;
 }
 
+// Kernels computing dst[i] = SaturatingAdd(dst[i], src[i]) for i in [begin,
+// end). The SIMD versions are provided for 8-, 16-, and 32-bit elements.
+
+template <typename T>
+inline void SaturatingAddArraysScalar(T *dst, T const *src, std::size_t begin,
+                                      std::size_t end) noexcept {
+    for (std::size_t i = begin; i < end; ++i) {
+        dst[i] = SaturatingAdd(dst[i], src[i]);
+    }
+}
+
+#ifdef FLIMEVENTS_X86_64
+
+// Processes 16 bytes per iteration.
+inline void SaturatingAddArraysSSE2(uint8_t *dst, uint8_t const *src,
+                                    std::size_t begin,
+                                    std::size_t end) noexcept {
+    std::size_t i = begin;
+    for (; i + 16 <= end; i += 16) {
+        __m128i a = _mm_loadu_si128(reinterpret_cast<__m128i const *>(dst + i));
+        __m128i b = _mm_loadu_si128(reinterpret_cast<__m128i const *>(src + i));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i),
+                         _mm_adds_epu8(a, b));
+    }
+    SaturatingAddArraysScalar(dst, src, i, end);
+}
+
+inline void SaturatingAddArraysSSE2(uint16_t *dst, uint16_t const *src,
+                                    std::size_t begin,
+                                    std::size_t end) noexcept {
+    std::size_t i = begin;
+    for (; i + 8 <= end; i += 8) {
+        __m128i a = _mm_loadu_si128(reinterpret_cast<__m128i const *>(dst + i));
+        __m128i b = _mm_loadu_si128(reinterpret_cast<__m128i const *>(src + i));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i),
+                         _mm_adds_epu16(a, b));
+    }
+    SaturatingAddArraysScalar(dst, src, i, end);
+}
+
+// SSE2 has no unsigned 32-bit saturating add or compare; overflow (sum < a)
+// is detected by a signed compare after flipping the sign bits.
+inline void SaturatingAddArraysSSE2(uint32_t *dst, uint32_t const *src,
+                                    std::size_t begin,
+                                    std::size_t end) noexcept {
+    __m128i const signBit = _mm_set1_epi32(INT32_MIN);
+    std::size_t i = begin;
+    for (; i + 4 <= end; i += 4) {
+        __m128i a = _mm_loadu_si128(reinterpret_cast<__m128i const *>(dst + i));
+        __m128i b = _mm_loadu_si128(reinterpret_cast<__m128i const *>(src + i));
+        __m128i sum = _mm_add_epi32(a, b);
+        __m128i overflow = _mm_cmpgt_epi32(_mm_xor_si128(a, signBit),
+                                           _mm_xor_si128(sum, signBit));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i),
+                         _mm_or_si128(sum, overflow));
+    }
+    SaturatingAddArraysScalar(dst, src, i, end);
+}
+
+// Processes 32 bytes per iteration.
+FLIMEVENTS_TARGET_AVX2 inline void
+SaturatingAddArraysAVX2(uint8_t *dst, uint8_t const *src, std::size_t begin,
+                        std::size_t end) noexcept {
+    std::size_t i = begin;
+    for (; i + 32 <= end; i += 32) {
+        __m256i a =
+            _mm256_loadu_si256(reinterpret_cast<__m256i const *>(dst + i));
+        __m256i b =
+            _mm256_loadu_si256(reinterpret_cast<__m256i const *>(src + i));
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + i),
+                            _mm256_adds_epu8(a, b));
+    }
+    SaturatingAddArraysSSE2(dst, src, i, end);
+}
+
+FLIMEVENTS_TARGET_AVX2 inline void
+SaturatingAddArraysAVX2(uint16_t *dst, uint16_t const *src, std::size_t begin,
+                        std::size_t end) noexcept {
+    std::size_t i = begin;
+    for (; i + 16 <= end; i += 16) {
+        __m256i a =
+            _mm256_loadu_si256(reinterpret_cast<__m256i const *>(dst + i));
+        __m256i b =
+            _mm256_loadu_si256(reinterpret_cast<__m256i const *>(src + i));
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + i),
+                            _mm256_adds_epu16(a, b));
+    }
+    SaturatingAddArraysSSE2(dst, src, i, end);
+}
+
+// a + min(b, ~a) never wraps and equals the saturated sum.
+FLIMEVENTS_TARGET_AVX2 inline void
+SaturatingAddArraysAVX2(uint32_t *dst, uint32_t const *src, std::size_t begin,
+                        std::size_t end) noexcept {
+    __m256i const ones = _mm256_set1_epi32(-1);
+    std::size_t i = begin;
+    for (; i + 8 <= end; i += 8) {
+        __m256i a =
+            _mm256_loadu_si256(reinterpret_cast<__m256i const *>(dst + i));
+        __m256i b =
+            _mm256_loadu_si256(reinterpret_cast<__m256i const *>(src + i));
+        __m256i headroom = _mm256_xor_si256(a, ones);
+        _mm256_storeu_si256(
+            reinterpret_cast<__m256i *>(dst + i),
+            _mm256_add_epi32(a, _mm256_min_epu32(b, headroom)));
+    }
+    SaturatingAddArraysSSE2(dst, src, i, end);
+}
+
+#endif // FLIMEVENTS_X86_64
+
+// Saturating element-wise add, using the widest available instruction set
+template <typename T>
+inline void SaturatingAddArrays(T *dst, T const *src,
+                                std::size_t count) noexcept {
+    SaturatingAddArraysScalar(dst, src, 0, count);
+}
+
+#ifdef FLIMEVENTS_X86_64
+
+template <typename T>
+inline void SaturatingAddArraysX86(T *dst, T const *src,
+                                   std::size_t count) noexcept {
+    if (CPUFeatures::Get().avx2) {
+        SaturatingAddArraysAVX2(dst, src, 0, count);
+    } else {
+        SaturatingAddArraysSSE2(dst, src, 0, count);
+    }
+}
+
+inline void SaturatingAddArrays(uint8_t *dst, uint8_t const *src,
+                                std::size_t count) noexcept {
+    SaturatingAddArraysX86(dst, src, count);
+}
+
+inline void SaturatingAddArrays(uint16_t *dst, uint16_t const *src,
+                                std::size_t count) noexcept {
+    SaturatingAddArraysX86(dst, src, count);
+}
+
+inline void SaturatingAddArrays(uint32_t *dst, uint32_t const *src,
+                                std::size_t count) noexcept {
+    SaturatingAddArraysX86(dst, src, count);
+}
+
+#endif // FLIMEVENTS_X86_64
+
+// Computes histogram bin indices ((y * width + x) * nBins + t) of photons,
+// with the time bin shift and reversal computed once rather than per photon
+class HistogramIndexer {
+    uint32_t timeBits;
+    uint32_t shift;
+    std::size_t reverseMask;
+    std::size_t width;
+
+  public:
+    HistogramIndexer(uint32_t timeBits, uint32_t inputTimeBits,
+                     bool reverseTime, std::size_t width) noexcept
+        : timeBits(timeBits), shift(inputTimeBits - timeBits),
+          // Reversal of t < 2^timeBits is (2^timeBits - 1 - t)
+          reverseMask(reverseTime ? (std::size_t(1) << timeBits) - 1 : 0),
+          width(width) {}
+
+    std::size_t operator()(PixelPhotonEvent const &event) const noexcept {
+        std::size_t const t = (event.microtime >> shift) ^ reverseMask;
+        return ((event.y * width + event.x) << timeBits) + t;
+    }
+};
+
 template <typename T, typename = std::enable_if_t<std::is_unsigned<T>::value>>
 class Histogram {
     uint32_t timeBits;
@@ -29,6 +204,35 @@ class Histogram {
 
     std::unique_ptr<T[]> hist;
 
+    // Increment loop with the time bin computation fixed at compile time
+    template <uint32_t TimeBits, uint32_t InputTimeBits, bool ReverseTime>
+    void IncrementEventsStatic(PixelPhotonEvent const *events,
+                               std::size_t count) noexcept {
+        constexpr uint32_t shift = InputTimeBits - TimeBits;
+        // Reversal of t < 2^TimeBits is (2^TimeBits - 1 - t)
+        constexpr std::size_t reverseMask =
+            ReverseTime ? (std::size_t(1) << TimeBits) - 1 : 0;
+        T *const h = hist.get();
+        for (std::size_t i = 0; i < count; ++i) {
+            std::size_t const t = (events[i].microtime >> shift) ^ reverseMask;
+            std::size_t const index =
+                ((events[i].y * width + events[i].x) << TimeBits) + t;
+            h[index] = SaturatingAdd(h[index], T(1));
+        }
+    }
+
+    template <uint32_t TimeBits, uint32_t InputTimeBits>
+    void IncrementEventsStatic(PixelPhotonEvent const *events,
+                               std::size_t count) noexcept {
+        if (reverseTime) {
+            IncrementEventsStatic<TimeBits, InputTimeBits, true>(events,
+                                                                 count);
+        } else {
+            IncrementEventsStatic<TimeBits, InputTimeBits, false>(events,
+                                                                  count);
+        }
+    }
+
   public:
     ~Histogram() = default;
     Histogram(Histogram const &rhs) = delete;
@@ -57,6 +261,13 @@ class Histogram {
         memset(hist.get(), 0, GetNumberOfElements() * sizeof(T));
     }
 
+    // Zero rows yBegin through yEnd - 1 (all pixels and time bins)
+    void ClearRows(std::size_t yBegin, std::size_t yEnd) noexcept {
+        std::size_t const rowSize = GetNumberOfTimeBins() * width;
+        memset(hist.get() + yBegin * rowSize, 0,
+               (yEnd - yBegin) * rowSize * sizeof(T));
+    }
+
     uint32_t GetTimeBits() const noexcept { return timeBits; }
 
     uint32_t GetNumberOfTimeBins() const noexcept { return 1 << timeBits; }
@@ -69,12 +280,67 @@ class Histogram {
         return GetNumberOfTimeBins() * width * height;
     }
 
-    void Increment(std::size_t t, std::size_t x, std::size_t y) noexcept {
+    // Index into Get() of the bin for the given (input) time and pixel
+    std::size_t GetIndex(std::size_t t, std::size_t x,
+                         std::size_t y) const noexcept {
         auto tReduced = uint16_t(t >> (inputTimeBits - timeBits));
         auto tReversed =
             reverseTime ? (1 << timeBits) - 1 - tReduced : tReduced;
-        auto index = (y * width + x) * GetNumberOfTimeBins() + tReversed;
-        hist[index] = SaturatingAdd(hist[index], T(1));
+        return (y * width + x) * GetNumberOfTimeBins() + tReversed;
+    }
+
+    void Increment(std::size_t t, std::size_t x, std::size_t y) noexcept {
+        IncrementAt(GetIndex(t, x, y));
+    }
+
+    // Same as calling Increment() for each event. Common configurations of
+    // input bits (12) and time bins (6, 8, 10, or 12 bits, or 0 for
+    // intensity) are dispatched to loops specialized at compile time.
+    void IncrementEvents(PixelPhotonEvent const *events,
+                         std::size_t count) noexcept {
+        if (inputTimeBits == 12) {
+            switch (timeBits) {
+            case 0:
+                IncrementEventsStatic<0, 12>(events, count);
+                return;
+            case 6:
+                IncrementEventsStatic<6, 12>(events, count);
+                return;
+            case 8:
+                IncrementEventsStatic<8, 12>(events, count);
+                return;
+            case 10:
+                IncrementEventsStatic<10, 12>(events, count);
+                return;
+            case 12:
+                IncrementEventsStatic<12, 12>(events, count);
+                return;
+            default:
+                break;
+            }
+        }
+        for (std::size_t i = 0; i < count; ++i) {
+            Increment(events[i].microtime, events[i].x, events[i].y);
+        }
+    }
+
+    HistogramIndexer GetIndexer() const noexcept {
+        return HistogramIndexer(timeBits, inputTimeBits, reverseTime, width);
+    }
+
+    // Return false if the bin was already saturated (and so not changed)
+    bool IncrementAt(std::size_t index) noexcept {
+        T const value = hist[index];
+        T const incremented = SaturatingAdd(value, T(1));
+        hist[index] = incremented;
+        return incremented != value;
+    }
+
+    void ClearAt(std::size_t index) noexcept { hist[index] = 0; }
+
+    // Saturating add to a single bin
+    void AddAt(std::size_t index, T count) noexcept {
+        hist[index] = SaturatingAdd(hist[index], count);
     }
 
     T const *Get() const noexcept { return hist.get(); }
@@ -85,12 +351,69 @@ class Histogram {
             abort(); // Programming error
         }
 
-        std::size_t n = GetNumberOfElements();
+        SaturatingAddArrays(hist.get(), rhs.hist.get(),
+                            GetNumberOfElements());
+
+        return *this;
+    }
+};
+
+// Sparse form of a histogram: the indices (into Histogram<T>::Get()) of the
+// nonzero bins, in increasing order, and their counts.
+template <typename T> class SparseHistogram {
+    std::vector<std::size_t> indices;
+    std::vector<T> counts;
+
+  public:
+    // Set from the given bins of dense, which must include all nonzero bins
+    // (and no duplicates). The vector of indices is sorted in place.
+    void Gather(Histogram<T> const &dense,
+                std::vector<std::size_t> &binIndices) {
+        std::sort(binIndices.begin(), binIndices.end());
+        indices.clear();
+        counts.clear();
+        T const *const hist = dense.Get();
+        for (auto index : binIndices) {
+            if (hist[index] != 0) {
+                indices.push_back(index);
+                counts.push_back(hist[index]);
+            }
+        }
+    }
+
+    // Set from all nonzero bins of dense
+    void GatherAll(Histogram<T> const &dense) {
+        indices.clear();
+        counts.clear();
+        T const *const hist = dense.Get();
+        std::size_t const n = dense.GetNumberOfElements();
         for (std::size_t i = 0; i < n; ++i) {
-            hist[i] = SaturatingAdd(hist[i], rhs.hist[i]);
+            if (hist[i] != 0) {
+                indices.push_back(i);
+                counts.push_back(hist[i]);
+            }
         }
+    }
 
-        return *this;
+    std::size_t GetSize() const noexcept { return indices.size(); }
+
+    std::vector<std::size_t> const &GetIndices() const noexcept {
+        return indices;
+    }
+
+    std::vector<T> const &GetCounts() const noexcept { return counts; }
+
+    // Overwrite dense (which must have the original shape) with this
+    void ToDense(Histogram<T> &dense) const noexcept {
+        dense.Clear();
+        AddTo(dense);
+    }
+
+    // Saturating add to dense (which must have the original shape)
+    void AddTo(Histogram<T> &dense) const noexcept {
+        for (std::size_t i = 0; i < indices.size(); ++i) {
+            dense.AddAt(indices[i], counts[i]);
+        }
     }
 };
 
@@ -102,6 +425,14 @@ template <typename T> class HistogramProcessor {
     virtual void HandleError(std::string const &message) = 0;
     virtual void HandleFrame(Histogram<T> const &histogram) = 0;
 
+    // Called instead of HandleFrame() when the producer also has the frame
+    // in sparse form (sparse has the same content as histogram). Receivers
+    // that can take advantage of the sparse form override this.
+    virtual void HandleSparseFrame(Histogram<T> const &histogram,
+                                   SparseHistogram<T> const &) {
+        HandleFrame(histogram);
+    }
+
     // Upon finishing, the histogram is moved out of its producer.
     // (It can then be saved, reused, etc.)
     virtual void HandleFinish(Histogram<T> &&histogram,
@@ -109,32 +440,81 @@ template <typename T> class HistogramProcessor {
 };
 
 // Collect pixel-assiend photon events into a series of histograms
+// While a frame has few nonzero bins (at most 1/sparseDivisor of the
+// histogram), their indices are recorded. The next frame then clears only
+// those bins instead of the whole histogram, and the frame is also sent
+// downstream in sparse form (HandleSparseFrame()).
 template <typename T> class Histogrammer : public PixelPhotonProcessor {
     Histogram<T> histogram;
     bool frameInProgress;
 
+    static constexpr std::size_t sparseDivisor = 64;
+    std::size_t const maxSparseBins;
+    // Whether nonzeroBins lists all nonzero bins (false also before the
+    // first frame, when the histogram is not yet cleared)
+    bool isSparse;
+    std::vector<std::size_t> nonzeroBins;
+    SparseHistogram<T> sparseFrame;
+
     std::shared_ptr<HistogramProcessor<T>> downstream;
 
+    void Increment(PixelPhotonEvent const &event) {
+        auto const index =
+            histogram.GetIndex(event.microtime, event.x, event.y);
+        if (isSparse && histogram.Get()[index] == 0) {
+            if (nonzeroBins.size() < maxSparseBins) {
+                nonzeroBins.push_back(index);
+            } else {
+                isSparse = false;
+            }
+        }
+        histogram.IncrementAt(index);
+    }
+
   public:
     Histogrammer(Histogram<T> &&histogram,
                  std::shared_ptr<HistogramProcessor<T>> downstream)
         : histogram(std::move(histogram)), frameInProgress(false),
-          downstream(downstream) {}
+          maxSparseBins(this->histogram.GetNumberOfElements() /
+                        sparseDivisor),
+          isSparse(false), downstream(downstream) {}
 
     void HandleBeginFrame() override {
-        histogram.Clear();
+        if (isSparse) {
+            for (auto index : nonzeroBins) {
+                histogram.ClearAt(index);
+            }
+        } else {
+            histogram.Clear();
+        }
+        nonzeroBins.clear();
+        isSparse = true;
         frameInProgress = true;
     }
 
     void HandleEndFrame() override {
         frameInProgress = false;
         if (downstream) {
-            downstream->HandleFrame(histogram);
+            if (isSparse) {
+                sparseFrame.Gather(histogram, nonzeroBins);
+                downstream->HandleSparseFrame(histogram, sparseFrame);
+            } else {
+                downstream->HandleFrame(histogram);
+            }
         }
     }
 
     void HandlePixelPhoton(PixelPhotonEvent const &event) override {
-        histogram.Increment(event.microtime, event.x, event.y);
+        Increment(event);
+    }
+
+    void HandlePixelPhotons(PixelPhotonEvent const *events,
+                            std::size_t count) override {
+        std::size_t i = 0;
+        for (; i < count && isSparse; ++i) {
+            Increment(events[i]);
+        }
+        histogram.IncrementEvents(events + i, count - i);
     }
 
     void HandleError(std::string const &message) override {
@@ -179,6 +559,14 @@ class HistogramAccumulator : public HistogramProcessor<T> {
         }
     }
 
+    void HandleSparseFrame(Histogram<T> const &,
+                           SparseHistogram<T> const &sparse) override {
+        sparse.AddTo(cumulative);
+        if (downstream) {
+            downstream->HandleFrame(cumulative);
+        }
+    }
+
     void HandleFinish(Histogram<T> &&histogram,
                       bool isCompleteFrame) override {
         // We discard any incomplete frame from upstream
@@ -188,3 +576,144 @@ class HistogramAccumulator : public HistogramProcessor<T> {
         }
     }
 };
+
+// Photon counts of a single frame, indexed like the histogram they will be
+// added to, kept apart until the frame is complete so that an incomplete
+// frame can be discarded. Counts are 8-bit; each time a bin wraps around
+// (every 256 counts), its index is recorded. The blocks of bins touched
+// during the frame are also recorded, so that draining (or clearing) costs
+// time proportional to the number of touched blocks rather than the number
+// of bins.
+class FrameCounts {
+    static constexpr std::size_t blockBits = 6;
+    static constexpr std::size_t blockSize = std::size_t(1) << blockBits;
+
+    std::size_t size;
+    std::unique_ptr<uint8_t[]> counts; // Zero outside of touched blocks
+    std::unique_ptr<bool[]> isBlockTouched;
+    std::vector<std::size_t> touchedBlocks;
+    std::vector<std::size_t> wrappedBins; // One entry per 256 counts
+
+  public:
+    explicit FrameCounts(std::size_t size)
+        : size(size), counts(std::make_unique<uint8_t[]>(size)),
+          isBlockTouched(
+              std::make_unique<bool[]>((size + blockSize - 1) >> blockBits)) {
+        // Value-initialized (zeroed) by make_unique
+        touchedBlocks.reserve((size + blockSize - 1) >> blockBits);
+    }
+
+    void Increment(std::size_t index) {
+        std::size_t const block = index >> blockBits;
+        if (!isBlockTouched[block]) {
+            isBlockTouched[block] = true;
+            touchedBlocks.push_back(block);
+        }
+        if (++counts[index] == 0) {
+            wrappedBins.push_back(index);
+        }
+    }
+
+    // Call add(index, count) (count <= 256; the same index may be passed
+    // more than once) so as to add all counts, and clear the counts
+    template <typename F> void Drain(F add) {
+        for (auto index : wrappedBins) {
+            add(index, uint32_t(256));
+        }
+        wrappedBins.clear();
+        for (auto block : touchedBlocks) {
+            std::size_t const begin = block << blockBits;
+            std::size_t const end = std::min(begin + blockSize, size);
+            for (std::size_t i = begin; i < end; ++i) {
+                if (counts[i] != 0) {
+                    add(i, uint32_t(counts[i]));
+                    counts[i] = 0;
+                }
+            }
+            isBlockTouched[block] = false;
+        }
+        touchedBlocks.clear();
+    }
+
+    void Clear() noexcept {
+        Drain([](std::size_t, uint32_t) {});
+    }
+};
+
+// Accumulate photons directly into a cumulative histogram, producing the
+// same results as Histogrammer followed by HistogramAccumulator, but with
+// per-frame cost proportional to the number of photons (and the bins they
+// touch) rather than the histogram size.
+// To be able to discard an incomplete last frame, each frame is counted in
+// an 8-bit FrameCounts, which is added to the cumulative histogram when the
+// frame ends.
+template <typename T>
+class CumulativeHistogrammer : public PixelPhotonProcessor {
+    Histogram<T> cumulative;
+    HistogramIndexer const indexer;
+    FrameCounts frame;
+    bool frameInProgress;
+
+    std::shared_ptr<HistogramProcessor<T>> downstream;
+
+  public:
+    // The histogram must be zeroed (or contain counts to continue from)
+    CumulativeHistogrammer(Histogram<T> &&histogram,
+                           std::shared_ptr<HistogramProcessor<T>> downstream)
+        : cumulative(std::move(histogram)),
+          indexer(cumulative.GetIndexer()),
+          frame(cumulative.GetNumberOfElements()), frameInProgress(false),
+          downstream(downstream) {}
+
+    void HandleBeginFrame() override {
+        frame.Clear();
+        frameInProgress = true;
+    }
+
+    void HandleEndFrame() override {
+        frame.Drain([this](std::size_t index, uint32_t count) {
+            cumulative.AddAt(index,
+                             static_cast<T>(std::min<uint32_t>(
+                                 count, std::numeric_limits<T>::max())));
+        });
+        frameInProgress = false;
+        if (downstream) {
+            downstream->HandleFrame(cumulative);
+        }
+    }
+
+    // Photons outside of frames are ignored (Histogrammer would clear them
+    // at the next frame, or they would be discarded as an incomplete frame)
+    void HandlePixelPhoton(PixelPhotonEvent const &event) override {
+        if (frameInProgress) {
+            frame.Increment(indexer(event));
+        }
+    }
+
+    void HandlePixelPhotons(PixelPhotonEvent const *events,
+                            std::size_t count) override {
+        if (!frameInProgress) {
+            return;
+        }
+        for (std::size_t i = 0; i < count; ++i) {
+            frame.Increment(indexer(events[i]));
+        }
+    }
+
+    void HandleError(std::string const &message) override {
+        if (downstream) {
+            downstream->HandleError(message);
+            downstream.reset();
+        }
+    }
+
+    void HandleFinish() override {
+        // Discard any incomplete frame, guaranteeing complete frame (all
+        // zeros if there was no frame)
+        frame.Clear();
+        if (downstream) {
+            downstream->HandleFinish(std::move(cumulative), true);
+            downstream.reset();
+        }
+    }
+};
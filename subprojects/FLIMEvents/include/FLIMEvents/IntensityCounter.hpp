@@ -0,0 +1,71 @@
+#pragma once
+
+#include "Histogram.hpp"
+#include "PixelPhotonEvent.hpp"
+
+#include <cstddef>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+// Count pixel-assigned photon events into a series of intensity images.
+// Produces the same frames as Histogrammer with a histogram of 0 time bits,
+// but indexes pixels directly, without the time bin arithmetic. The output is
+// such a 0-bit histogram, so it can be accumulated with HistogramAccumulator.
+template <typename T> class IntensityCounter : public PixelPhotonProcessor {
+    Histogram<T> image;
+    std::size_t const width;
+    bool frameInProgress;
+
+    std::shared_ptr<HistogramProcessor<T>> downstream;
+
+  public:
+    // The histogram must have 0 time bits
+    IntensityCounter(Histogram<T> &&histogram,
+                     std::shared_ptr<HistogramProcessor<T>> downstream)
+        : image(std::move(histogram)), width(image.GetWidth()),
+          frameInProgress(false), downstream(downstream) {
+        if (image.GetTimeBits() != 0) {
+            throw std::invalid_argument(
+                "Intensity histogram must have 0 time bits");
+        }
+    }
+
+    void HandleBeginFrame() override {
+        image.Clear();
+        frameInProgress = true;
+    }
+
+    void HandleEndFrame() override {
+        frameInProgress = false;
+        if (downstream) {
+            downstream->HandleFrame(image);
+        }
+    }
+
+    void HandlePixelPhoton(PixelPhotonEvent const &event) override {
+        image.IncrementAt(event.y * width + event.x);
+    }
+
+    void HandlePixelPhotons(PixelPhotonEvent const *events,
+                            std::size_t count) override {
+        for (std::size_t i = 0; i < count; ++i) {
+            image.IncrementAt(events[i].y * width + events[i].x);
+        }
+    }
+
+    void HandleError(std::string const &message) override {
+        if (downstream) {
+            downstream->HandleError(message);
+            downstream.reset();
+        }
+    }
+
+    void HandleFinish() override {
+        if (downstream) {
+            downstream->HandleFinish(std::move(image), !frameInProgress);
+            downstream.reset();
+        }
+    }
+};
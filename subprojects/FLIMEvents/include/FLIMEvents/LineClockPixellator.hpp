@@ -1,13 +1,42 @@
 #pragma once
 
 #include "DecodedEvent.hpp"
+#include "LinePixelMapper.hpp"
 #include "PixelPhotonEvent.hpp"
+#include "RingBuffer.hpp"
 
-#include <deque>
+#include <cstddef>
+#include <cstdint>
 #include <memory>
 #include <stdexcept>
+#include <utility>
+#include <vector>
+
+// Assign pixels to photons using line clock, optionally with frame clock.
+//
+// Without frame markers, frames are determined by counting lines. With frame
+// markers, a frame starts only at a line marker preceded by (or coinciding
+// with) a frame marker: a frame cut short by a frame marker is ended early
+// (the missing lines are counted as dropped), and lines after a complete
+// frame but before the next frame marker are discarded (counted as extra).
+// This keeps frames aligned when line markers are missed or spurious.
+//
+// See LineScanOptions for bidirectional and nonlinear (e.g. sinusoidal)
+// line sweeps.
+
+// Line scan geometry; the default is a unidirectional, linear sweep.
+struct LineScanOptions {
+    // If true, each line marker starts a forward line, immediately followed
+    // (after lineTime) by a return line, whose x coordinates are reversed.
+    // linesPerFrame should be even.
+    bool bidirectional = false;
+
+    // If not empty, the x coordinate for each macro-time in the (forward)
+    // line; lineTime elements. Values >= pixelsPerLine mean no pixel (the
+    // photon is discarded). See MakeSinusoidalPixelTable().
+    std::vector<uint32_t> pixelTable;
+};
 
-// Assign pixels to photons using line clock only
 class LineClockPixellator : public DecodedEventProcessor {
     uint32_t const pixelsPerLine;
     uint32_t const linesPerFrame;
@@ -16,6 +45,10 @@ class LineClockPixellator : public DecodedEventProcessor {
     int32_t const lineDelay; // in macro-time units
     uint32_t const lineTime; // in macro-time units
     decltype(MarkerEvent::bits) const lineMarkerMask;
+    decltype(MarkerEvent::bits) const frameMarkerMask; // 0 if not used
+    bool const bidirectional;
+
+    LinePixelMapper const pixelMapper; // Time in line to x
 
     uint64_t latestTimestamp = 0; // Latest observed macro-time
 
@@ -31,12 +64,41 @@ class LineClockPixellator : public DecodedEventProcessor {
     // Start time of current line, or -1 if no line started.
     uint64_t lineStartTime = -1;
     uint64_t lastLineStartTime = 0;
+    bool lineReversed = false; // Current line is a return line
+
+    // With frame markers: whether lines are being discarded until the next
+    // frame marker, and whether any frame marker has been seen
+    bool awaitingFrameStart;
+    bool seenFrameStart = false;
+    uint64_t droppedLineCount = 0;
+    uint64_t extraLineCount = 0;
+
+    // Compact copy of ValidPhotonEvent for buffering
+    struct PendingPhoton {
+        uint64_t macrotime;
+        uint16_t microtime;
+        uint16_t route;
+    };
 
     // Buffer received photons until we can assign to pixel
-    std::deque<ValidPhotonEvent> pendingPhotons;
+    RingBuffer<PendingPhoton> pendingPhotons;
+
+    struct PendingLine {
+        uint64_t markerTime;
+        bool frameStart; // Frame marker since previous line marker
+        bool reversed;   // Return line of bidirectional scan
+    };
 
     // Buffer line marks until we are ready to process
-    std::deque<uint64_t> pendingLines; // marker macro-times
+    RingBuffer<PendingLine> pendingLines;
+
+    // Frame marker seen since the last line marker
+    bool pendingFrameStart = false;
+
+    // Photons of a line being sent downstream (reused to avoid allocation)
+    std::vector<uint32_t> emitTimes; // Time in line
+    std::vector<uint32_t> emitXs;
+    std::vector<PixelPhotonEvent> emitBuffer;
 
     std::shared_ptr<PixelPhotonProcessor> downstream;
 
@@ -52,14 +114,29 @@ class LineClockPixellator : public DecodedEventProcessor {
         if (!downstream) {
             return; // Avoid buffering post-error
         }
-        pendingPhotons.emplace_back(event);
+        PendingPhoton p;
+        p.macrotime = event.macrotime;
+        p.microtime = event.microtime;
+        p.route = event.route;
+        pendingPhotons.PushBack(p);
     }
 
     void EnqueueLineMarker(uint64_t macrotime) {
         if (!downstream) {
             return; // Avoid buffering post-error
         }
-        pendingLines.emplace_back(macrotime);
+        PendingLine line;
+        line.markerTime = macrotime;
+        line.frameStart = pendingFrameStart;
+        line.reversed = false;
+        pendingLines.PushBack(line);
+        pendingFrameStart = false;
+        if (bidirectional) {
+            line.markerTime += lineTime;
+            line.frameStart = false;
+            line.reversed = true;
+            pendingLines.PushBack(line);
+        }
     }
 
     uint64_t CheckLineStart(uint64_t lineMarkerTime) {
@@ -100,38 +177,120 @@ class LineClockPixellator : public DecodedEventProcessor {
         }
     }
 
+    // Called when currentLine has just been advanced to a frame boundary
+    void EndFrame() {
+        if (downstream) {
+            downstream->HandleEndFrame();
+        }
+
+        // Check for last frame here to send finish as soon as possible.
+        // (The case of maxFrames == 0 is not handled here.)
+        if (currentLine / linesPerFrame == maxFrames) {
+            if (downstream) {
+                downstream->HandleFinish();
+                downstream.reset();
+            }
+        }
+
+        if (frameMarkerMask) {
+            awaitingFrameStart = true;
+        }
+    }
+
     void FinishLine() {
         ++currentLine;
 
         bool endFrame = currentLine % linesPerFrame == 0;
         if (endFrame) {
-            if (downstream) {
-                downstream->HandleEndFrame();
-            }
+            EndFrame();
+        }
+    }
 
-            // Check for last frame here to send finish as soon as possible.
-            // (The case of maxFrames == 0 is not handled here.)
-            if (currentLine / linesPerFrame == maxFrames) {
-                if (downstream) {
-                    downstream->HandleFinish();
-                    downstream.reset();
-                }
-            }
+    // Line preceded by frame marker: end the current frame if incomplete
+    void ResyncFrame() {
+        awaitingFrameStart = false;
+        seenFrameStart = true;
+        auto const lineInFrame = currentLine % linesPerFrame;
+        if (lineInFrame != 0) {
+            auto const missing = linesPerFrame - lineInFrame;
+            droppedLineCount += missing;
+            currentLine += missing;
+            nextLine = currentLine;
+            EndFrame();
+            awaitingFrameStart = false;
         }
     }
 
-    void EmitPhoton(ValidPhotonEvent const &event) {
-        PixelPhotonEvent newEvent;
-        newEvent.frame = static_cast<uint32_t>(currentLine / linesPerFrame);
-        newEvent.y = static_cast<uint32_t>(currentLine % linesPerFrame);
-        auto timeInLine = event.macrotime - lineStartTime;
-        newEvent.x =
-            static_cast<uint32_t>(pixelsPerLine * timeInLine / lineTime);
-        newEvent.route = event.route;
-        newEvent.microtime = event.microtime;
+    // Line not belonging to any frame: discard it and its photons
+    void SkipLine(uint64_t lineMarkerTime) {
+        if (seenFrameStart) {
+            ++extraLineCount;
+        }
+        lineStartTime = CheckLineStart(lineMarkerTime);
+        lastLineStartTime = lineStartTime;
+        auto const lineEndTime = lineStartTime + lineTime;
+        std::size_t const pendingCount = pendingPhotons.GetSize();
+        std::size_t discard = 0;
+        while (discard < pendingCount &&
+               pendingPhotons[discard].macrotime < lineEndTime) {
+            ++discard;
+        }
+        pendingPhotons.PopFront(discard);
+    }
+
+    // Emit the first count buffered photons, which must all be in the
+    // current line, and remove them from the buffer
+    void EmitPhotons(std::size_t count) {
+        if (count == 0) {
+            return;
+        }
         if (downstream) {
-            downstream->HandlePixelPhoton(newEvent);
+            auto const frame =
+                static_cast<uint32_t>(currentLine / linesPerFrame);
+            auto const y = static_cast<uint32_t>(currentLine % linesPerFrame);
+
+            // Time in line is less than lineTime, so fits in 32 bits
+            emitTimes.resize(count);
+            for (std::size_t i = 0; i < count; ++i) {
+                emitTimes[i] = static_cast<uint32_t>(
+                    pendingPhotons[i].macrotime - lineStartTime);
+            }
+            emitXs.resize(count);
+            pixelMapper.Map(emitTimes.data(), emitXs.data(), count);
+
+            // Output x = xBase + xStep * x (modulo 2^32), to reverse return
+            // lines without branching
+            uint32_t const xBase = lineReversed ? pixelsPerLine - 1 : 0;
+            uint32_t const xStep = lineReversed ? UINT32_MAX : 1;
+            auto setEvent = [&](PixelPhotonEvent &newEvent, std::size_t i) {
+                auto const &photon = pendingPhotons[i];
+                newEvent.frame = frame;
+                newEvent.y = y;
+                newEvent.x = xBase + xStep * emitXs[i];
+                newEvent.route = photon.route;
+                newEvent.microtime = photon.microtime;
+            };
+
+            emitBuffer.resize(count);
+            std::size_t emitCount = 0;
+            if (!pixelMapper.HasTable()) {
+                for (std::size_t i = 0; i < count; ++i) {
+                    setEvent(emitBuffer[i], i);
+                }
+                emitCount = count;
+            } else {
+                // Skip photons outside of any pixel
+                for (std::size_t i = 0; i < count; ++i) {
+                    if (emitXs[i] < pixelsPerLine) {
+                        setEvent(emitBuffer[emitCount++], i);
+                    }
+                }
+            }
+            if (emitCount > 0) {
+                downstream->HandlePixelPhotons(emitBuffer.data(), emitCount);
+            }
         }
+        pendingPhotons.PopFront(count);
     }
 
     // If in line, process photons in current line.
@@ -140,36 +299,44 @@ class LineClockPixellator : public DecodedEventProcessor {
     // Return false if nothing more to process.
     bool ProcessLinePhotons() {
         if (nextLine == currentLine) { // Between lines
-            if (pendingLines.empty()) {
+            if (pendingLines.IsEmpty()) {
                 // Nothing to do until a new line can be started
                 return false;
             }
-            uint64_t lineMarkerTime = pendingLines.front();
-            pendingLines.pop_front();
-
-            StartLine(lineMarkerTime);
+            PendingLine line = pendingLines.Front();
+            pendingLines.PopFront();
+
+            if (frameMarkerMask) {
+                if (line.frameStart) {
+                    ResyncFrame();
+                } else if (awaitingFrameStart) {
+                    SkipLine(line.markerTime);
+                    return true; // There may be more lines to process
+                }
+            }
+            StartLine(line.markerTime);
+            lineReversed = line.reversed;
         }
         // Else we are already in a line
 
         // Discard all photons before current line
-        while (!pendingPhotons.empty()) {
-            auto const &photon = pendingPhotons.front();
-            if (photon.macrotime >= lineStartTime) {
-                break;
-            }
-            pendingPhotons.pop_front();
+        std::size_t const pendingCount = pendingPhotons.GetSize();
+        std::size_t discard = 0;
+        while (discard < pendingCount &&
+               pendingPhotons[discard].macrotime < lineStartTime) {
+            ++discard;
         }
+        pendingPhotons.PopFront(discard);
 
         // Emit all buffered photons for current line
         auto lineEndTime = lineStartTime + lineTime;
-        while (!pendingPhotons.empty()) {
-            auto const &photon = pendingPhotons.front();
-            if (photon.macrotime >= lineEndTime) {
-                break;
-            }
-            EmitPhoton(photon);
-            pendingPhotons.pop_front();
+        std::size_t const remaining = pendingCount - discard;
+        std::size_t inLine = 0;
+        while (inLine < remaining &&
+               pendingPhotons[inLine].macrotime < lineEndTime) {
+            ++inLine;
         }
+        EmitPhotons(inLine);
 
         // Finish line if we have seen all photons within it
         if (latestTimestamp >= lineEndTime) {
@@ -205,13 +372,20 @@ class LineClockPixellator : public DecodedEventProcessor {
     }
 
   public:
+    // frameMarkerBit >= 16 means frame markers are not used
     LineClockPixellator(uint32_t pixelsPerLine, uint32_t linesPerFrame,
                         uint32_t maxFrames, int32_t lineDelay,
                         uint32_t lineTime, uint32_t lineMarkerBit,
+                        uint32_t frameMarkerBit, LineScanOptions scanOptions,
                         std::shared_ptr<PixelPhotonProcessor> downstream)
         : pixelsPerLine(pixelsPerLine), linesPerFrame(linesPerFrame),
           maxFrames(maxFrames), lineDelay(lineDelay), lineTime(lineTime),
-          lineMarkerMask(1 << lineMarkerBit), downstream(downstream) {
+          lineMarkerMask(1 << lineMarkerBit),
+          frameMarkerMask(frameMarkerBit < 16 ? 1 << frameMarkerBit : 0),
+          bidirectional(scanOptions.bidirectional),
+          pixelMapper(pixelsPerLine, lineTime,
+                      std::move(scanOptions.pixelTable)),
+          awaitingFrameStart(frameMarkerMask != 0), downstream(downstream) {
         if (pixelsPerLine < 1) {
             throw std::invalid_argument("pixelsPerLine must be positive");
         }
@@ -221,8 +395,36 @@ class LineClockPixellator : public DecodedEventProcessor {
         if (lineTime < 1) {
             throw std::invalid_argument("lineTime must be positive");
         }
+        if (lineMarkerMask & frameMarkerMask) {
+            throw std::invalid_argument("Marker bits must differ");
+        }
+    }
+
+    LineClockPixellator(uint32_t pixelsPerLine, uint32_t linesPerFrame,
+                        uint32_t maxFrames, int32_t lineDelay,
+                        uint32_t lineTime, uint32_t lineMarkerBit,
+                        uint32_t frameMarkerBit,
+                        std::shared_ptr<PixelPhotonProcessor> downstream)
+        : LineClockPixellator(pixelsPerLine, linesPerFrame, maxFrames,
+                              lineDelay, lineTime, lineMarkerBit,
+                              frameMarkerBit, LineScanOptions(), downstream) {
     }
 
+    LineClockPixellator(uint32_t pixelsPerLine, uint32_t linesPerFrame,
+                        uint32_t maxFrames, int32_t lineDelay,
+                        uint32_t lineTime, uint32_t lineMarkerBit,
+                        std::shared_ptr<PixelPhotonProcessor> downstream)
+        : LineClockPixellator(pixelsPerLine, linesPerFrame, maxFrames,
+                              lineDelay, lineTime, lineMarkerBit, 16,
+                              downstream) {}
+
+    // Lines missing from frames ended early by a frame marker
+    uint64_t GetDroppedLineCount() const noexcept { return droppedLineCount; }
+
+    // Lines discarded between a complete frame and the next frame marker
+    // (not counting lines before the first frame marker)
+    uint64_t GetExtraLineCount() const noexcept { return extraLineCount; }
+
     void HandleTimestamp(DecodedEvent const &event) override {
         auto prevTimestamp = latestTimestamp;
         UpdateTimeRange(event.macrotime);
@@ -254,7 +456,29 @@ class LineClockPixellator : public DecodedEventProcessor {
         EnqueuePhoton(event);
         // A small amount of buffering can improve performance (buffering
         // larger numbers is less effective)
-        if (pendingPhotons.size() > 64) {
+        if (pendingPhotons.GetSize() > 64) {
+            ProcessPhotonsAndLines();
+        }
+    }
+
+    void HandleValidPhotons(ValidPhotonEvent const *events,
+                            std::size_t count) override {
+        if (count == 0) {
+            return;
+        }
+        // Photons are in macro-time order, so the last one is the latest
+        UpdateTimeRange(events[count - 1].macrotime);
+        if (!downstream) {
+            return; // Avoid buffering post-error
+        }
+        pendingPhotons.PushBack(events, count, [](ValidPhotonEvent const &e) {
+            PendingPhoton p;
+            p.macrotime = e.macrotime;
+            p.microtime = e.microtime;
+            p.route = e.route;
+            return p;
+        });
+        if (pendingPhotons.GetSize() > 64) {
             ProcessPhotonsAndLines();
         }
     }
@@ -267,6 +491,9 @@ class LineClockPixellator : public DecodedEventProcessor {
 
     void HandleMarker(MarkerEvent const &event) override {
         UpdateTimeRange(event.macrotime);
+        if ((event.bits & frameMarkerMask) && downstream) {
+            pendingFrameStart = true;
+        }
         if (event.bits & lineMarkerMask) {
             EnqueueLineMarker(event.macrotime);
             // We could call ProcessPhotonsAndLines() for all markers, but that
@@ -0,0 +1,219 @@
+#pragma once
+
+#include "CPUFeatures.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+// Kernels computing x = (t * multiplier) >> shift for each element. Require
+// t < 2^32 and multiplier < 2^32 (so that the product fits in 64 bits) for
+// the vectorized versions.
+
+inline void MapLineTimesToPixelsScalar(uint32_t const *times, uint32_t *xs,
+                                       std::size_t begin, std::size_t end,
+                                       uint64_t multiplier,
+                                       unsigned shift) noexcept {
+    for (std::size_t i = begin; i < end; ++i) {
+        xs[i] = static_cast<uint32_t>((times[i] * multiplier) >> shift);
+    }
+}
+
+#ifdef FLIMEVENTS_X86_64
+
+// Processes 4 times per iteration.
+inline void MapLineTimesToPixelsSSE2(uint32_t const *times, uint32_t *xs,
+                                     std::size_t begin, std::size_t end,
+                                     uint64_t multiplier,
+                                     unsigned shift) noexcept {
+    __m128i const m = _mm_set1_epi64x(static_cast<long long>(multiplier));
+    __m128i const s = _mm_cvtsi32_si128(static_cast<int>(shift));
+    __m128i const lo32 = _mm_set1_epi64x(0xffffffff);
+
+    std::size_t i = begin;
+    for (; i + 4 <= end; i += 4) {
+        __m128i t =
+            _mm_loadu_si128(reinterpret_cast<__m128i const *>(times + i));
+        // _mm_mul_epu32 multiplies the even 32-bit lanes
+        __m128i even = _mm_srl_epi64(_mm_mul_epu32(t, m), s);
+        __m128i odd = _mm_srl_epi64(_mm_mul_epu32(_mm_srli_epi64(t, 32), m), s);
+        __m128i x =
+            _mm_or_si128(_mm_and_si128(even, lo32), _mm_slli_epi64(odd, 32));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(xs + i), x);
+    }
+    MapLineTimesToPixelsScalar(times, xs, i, end, multiplier, shift);
+}
+
+// Processes 8 times per iteration.
+FLIMEVENTS_TARGET_AVX2 inline void
+MapLineTimesToPixelsAVX2(uint32_t const *times, uint32_t *xs,
+                         std::size_t begin, std::size_t end,
+                         uint64_t multiplier, unsigned shift) noexcept {
+    __m256i const m = _mm256_set1_epi64x(static_cast<long long>(multiplier));
+    __m128i const s = _mm_cvtsi32_si128(static_cast<int>(shift));
+    __m256i const lo32 = _mm256_set1_epi64x(0xffffffff);
+
+    std::size_t i = begin;
+    for (; i + 8 <= end; i += 8) {
+        __m256i t =
+            _mm256_loadu_si256(reinterpret_cast<__m256i const *>(times + i));
+        __m256i even = _mm256_srl_epi64(_mm256_mul_epu32(t, m), s);
+        __m256i odd =
+            _mm256_srl_epi64(_mm256_mul_epu32(_mm256_srli_epi64(t, 32), m), s);
+        __m256i x = _mm256_or_si256(_mm256_and_si256(even, lo32),
+                                    _mm256_slli_epi64(odd, 32));
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(xs + i), x);
+    }
+    MapLineTimesToPixelsSSE2(times, xs, i, end, multiplier, shift);
+}
+
+#endif // FLIMEVENTS_X86_64
+
+/**
+ * \brief Build a time-to-x table for a sinusoidal (resonant) line sweep.
+ *
+ * The scanner position over a sweep of lineTime is taken to be -cos(pi * t /
+ * lineTime) (from -1 to +1). Pixels are evenly spaced in position over the
+ * central part of the sweep that takes fillFraction of the line time; times
+ * outside of it map to UINT32_MAX (no pixel). Each time unit is mapped by its
+ * midpoint.
+ */
+inline std::vector<uint32_t> MakeSinusoidalPixelTable(uint32_t pixelsPerLine,
+                                                      uint32_t lineTime,
+                                                      double fillFraction) {
+    if (!(fillFraction > 0.0 && fillFraction <= 1.0)) {
+        throw std::invalid_argument("fillFraction must be in (0, 1]");
+    }
+    double const pi = 3.14159265358979323846;
+    double const amplitude = std::sin(pi * fillFraction / 2.0);
+    std::vector<uint32_t> table(lineTime);
+    for (uint32_t t = 0; t < lineTime; ++t) {
+        double const position = -std::cos(pi * (t + 0.5) / lineTime);
+        double const u = (position + amplitude) / (2.0 * amplitude);
+        if (u >= 0.0 && u < 1.0) {
+            table[t] = std::min(static_cast<uint32_t>(u * pixelsPerLine),
+                                pixelsPerLine - 1);
+        } else {
+            table[t] = UINT32_MAX;
+        }
+    }
+    return table;
+}
+
+/**
+ * \brief Maps time within a line to pixel x coordinate.
+ *
+ * Computes x = floor(pixelsPerLine * t / lineTime) for 0 <= t < lineTime,
+ * without division, as x = (t * M) >> S, where S = 2 * ceil(log2(lineTime))
+ * and M = ceil(pixelsPerLine * 2^S / lineTime). This is exact: M exceeds the
+ * true ratio by less than 1 (scaled by 2^S), so the error in t * M / 2^S is
+ * less than t / 2^S < 1 / lineTime, which is smaller than the distance from
+ * pixelsPerLine * t / lineTime (a multiple of 1 / lineTime) up to the next
+ * integer.
+ *
+ * The vectorized path requires M < 2^32, which holds when pixelsPerLine *
+ * lineTime < 2^30. Otherwise, if t * M fits in 64 bits, the fixed-point
+ * calculation is done one at a time; failing that (only for unrealistically
+ * long lines), by division.
+ *
+ * Alternatively, an arbitrary (e.g. nonlinear) mapping can be given as a table
+ * with an x for each time in the line, where values >= pixelsPerLine mean
+ * that the time does not belong to any pixel.
+ */
+class LinePixelMapper {
+    uint32_t pixelsPerLine;
+    uint32_t lineTime;
+    uint64_t multiplier;
+    unsigned shift;
+    bool useFixedPoint;
+    bool useVector;
+    std::vector<uint32_t> table; // If not empty, x for each time in line
+
+  public:
+    LinePixelMapper(uint32_t pixelsPerLine, uint32_t lineTime)
+        : pixelsPerLine(pixelsPerLine), lineTime(lineTime), multiplier(0),
+          shift(0), useFixedPoint(false), useVector(false) {
+        if (lineTime < 1) {
+            throw std::invalid_argument("lineTime must be positive");
+        }
+
+        unsigned log2LineTime = 0; // ceil(log2(lineTime))
+        while ((uint64_t(1) << log2LineTime) < lineTime) {
+            ++log2LineTime;
+        }
+        shift = 2 * log2LineTime;
+
+        // M = ceil(ppl * 2^S / L) must not overflow; ppl * 2^S < 2^64
+        // requires ppl < 2^(64 - S).
+        if (shift < 64 && pixelsPerLine < (uint64_t(1) << (64 - shift))) {
+            uint64_t const numerator = uint64_t(pixelsPerLine) << shift;
+            multiplier = (numerator + lineTime - 1) / lineTime;
+            // t * M < lineTime * M must fit in 64 bits
+            useFixedPoint = multiplier <= UINT64_MAX / lineTime;
+            useVector = multiplier < (uint64_t(1) << 32);
+        }
+    }
+
+    // table must have lineTime elements
+    LinePixelMapper(uint32_t pixelsPerLine, uint32_t lineTime,
+                    std::vector<uint32_t> table)
+        : LinePixelMapper(pixelsPerLine, lineTime) {
+        if (!table.empty() && table.size() != lineTime) {
+            throw std::invalid_argument(
+                "table size must equal lineTime (or be zero)");
+        }
+        this->table = std::move(table);
+    }
+
+    bool IsVectorized() const noexcept { return useVector && table.empty(); }
+
+    // Whether some times may map to no pixel (x >= pixelsPerLine)
+    bool HasTable() const noexcept { return !table.empty(); }
+
+    // t must be less than lineTime
+    uint32_t operator()(uint64_t t) const noexcept {
+        if (!table.empty()) {
+            return table[static_cast<std::size_t>(t)];
+        }
+        if (useFixedPoint) {
+            return static_cast<uint32_t>((t * multiplier) >> shift);
+        }
+        return static_cast<uint32_t>(pixelsPerLine * t / lineTime);
+    }
+
+    // Map count times (each less than lineTime) to x coordinates
+    void Map(uint32_t const *times, uint32_t *xs,
+             std::size_t count) const noexcept {
+        if (!table.empty()) {
+            uint32_t const *const lut = table.data();
+            for (std::size_t i = 0; i < count; ++i) {
+                xs[i] = lut[times[i]];
+            }
+        } else if (useVector) {
+#ifdef FLIMEVENTS_X86_64
+            if (CPUFeatures::Get().avx2) {
+                MapLineTimesToPixelsAVX2(times, xs, 0, count, multiplier,
+                                         shift);
+            } else {
+                MapLineTimesToPixelsSSE2(times, xs, 0, count, multiplier,
+                                         shift);
+            }
+#else
+            MapLineTimesToPixelsScalar(times, xs, 0, count, multiplier,
+                                       shift);
+#endif
+        } else {
+            for (std::size_t i = 0; i < count; ++i) {
+                xs[i] = (*this)(times[i]);
+            }
+        }
+    }
+
+    // For testing
+    uint64_t GetMultiplier() const noexcept { return multiplier; }
+    unsigned GetShift() const noexcept { return shift; }
+};
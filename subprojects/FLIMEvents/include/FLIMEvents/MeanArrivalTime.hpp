@@ -0,0 +1,199 @@
+#pragma once
+
+#include "PixelPhotonEvent.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+// Image of per-pixel photon counts and microtime sums, from which the
+// intensity and mean arrival time ("fast FLIM") images are obtained.
+class MeanArrivalTimeImage {
+    std::size_t width;
+    std::size_t height;
+
+    std::unique_ptr<uint32_t[]> counts;
+    std::unique_ptr<uint64_t[]> timeSums;
+
+  public:
+    ~MeanArrivalTimeImage() = default;
+    MeanArrivalTimeImage(MeanArrivalTimeImage const &rhs) = delete;
+    MeanArrivalTimeImage &operator=(MeanArrivalTimeImage const &rhs) = delete;
+    MeanArrivalTimeImage(MeanArrivalTimeImage &&rhs) = default;
+    MeanArrivalTimeImage &operator=(MeanArrivalTimeImage &&rhs) = default;
+
+    // Default constructor creates a "moved out" object.
+    MeanArrivalTimeImage() = default;
+
+    // Warning: Newly constructed image is not zeroed (for efficiency)
+    MeanArrivalTimeImage(std::size_t width, std::size_t height)
+        : width(width), height(height),
+          counts(std::make_unique<uint32_t[]>(width * height)),
+          timeSums(std::make_unique<uint64_t[]>(width * height)) {}
+
+    bool IsValid() const noexcept { return counts.get(); }
+
+    void Clear() noexcept {
+        memset(counts.get(), 0, width * height * sizeof(uint32_t));
+        memset(timeSums.get(), 0, width * height * sizeof(uint64_t));
+    }
+
+    std::size_t GetWidth() const noexcept { return width; }
+
+    std::size_t GetHeight() const noexcept { return height; }
+
+    // Photon counts (the intensity image)
+    uint32_t const *GetCounts() const noexcept { return counts.get(); }
+
+    uint64_t const *GetTimeSums() const noexcept { return timeSums.get(); }
+
+    // Mean microtime of the photons in a pixel; zero if there are none
+    double GetMeanTime(std::size_t x, std::size_t y) const noexcept {
+        std::size_t const i = y * width + x;
+        return counts[i] > 0 ? double(timeSums[i]) / counts[i] : 0.0;
+    }
+
+    void Add(std::size_t x, std::size_t y, uint32_t time) noexcept {
+        std::size_t const i = y * width + x;
+        ++counts[i];
+        timeSums[i] += time;
+    }
+
+    MeanArrivalTimeImage &operator+=(MeanArrivalTimeImage const &rhs) {
+        if (rhs.width != width || rhs.height != height) {
+            abort(); // Programming error
+        }
+
+        std::size_t const n = width * height;
+        for (std::size_t i = 0; i < n; ++i) {
+            counts[i] += rhs.counts[i];
+            timeSums[i] += rhs.timeSums[i];
+        }
+
+        return *this;
+    }
+};
+
+// Receiver of frame-by-frame mean arrival time image events
+class MeanArrivalTimeProcessor {
+  public:
+    virtual ~MeanArrivalTimeProcessor() = default;
+
+    virtual void HandleError(std::string const &message) = 0;
+    virtual void HandleFrame(MeanArrivalTimeImage const &image) = 0;
+
+    // Upon finishing, the image is moved out of its producer.
+    virtual void HandleFinish(MeanArrivalTimeImage &&image,
+                              bool isCompleteFrame) = 0;
+};
+
+// Collect pixel-assigned photon events into a series of intensity and mean
+// arrival time images. If reverseTime, microtimes are reversed (as for
+// Histogram), so that later photons (relative to the laser pulse) have larger
+// times when the device measures time to the next pulse.
+class MeanArrivalTimeImager : public PixelPhotonProcessor {
+    MeanArrivalTimeImage image;
+    bool frameInProgress;
+    uint32_t const maxTime;
+    bool const reverseTime;
+
+    std::shared_ptr<MeanArrivalTimeProcessor> downstream;
+
+    void Add(PixelPhotonEvent const &event) noexcept {
+        uint32_t const t = reverseTime ? maxTime - event.microtime
+                                       : uint32_t(event.microtime);
+        image.Add(event.x, event.y, t);
+    }
+
+  public:
+    MeanArrivalTimeImager(MeanArrivalTimeImage &&image,
+                          uint32_t inputTimeBits, bool reverseTime,
+                          std::shared_ptr<MeanArrivalTimeProcessor> downstream)
+        : image(std::move(image)), frameInProgress(false),
+          maxTime((uint32_t(1) << inputTimeBits) - 1),
+          reverseTime(reverseTime), downstream(downstream) {
+        if (inputTimeBits > 16) {
+            throw std::invalid_argument(
+                "Mean arrival time input time bits must not exceed 16");
+        }
+    }
+
+    void HandleBeginFrame() override {
+        image.Clear();
+        frameInProgress = true;
+    }
+
+    void HandleEndFrame() override {
+        frameInProgress = false;
+        if (downstream) {
+            downstream->HandleFrame(image);
+        }
+    }
+
+    void HandlePixelPhoton(PixelPhotonEvent const &event) override {
+        Add(event);
+    }
+
+    void HandlePixelPhotons(PixelPhotonEvent const *events,
+                            std::size_t count) override {
+        for (std::size_t i = 0; i < count; ++i) {
+            Add(events[i]);
+        }
+    }
+
+    void HandleError(std::string const &message) override {
+        if (downstream) {
+            downstream->HandleError(message);
+            downstream.reset();
+        }
+    }
+
+    void HandleFinish() override {
+        if (downstream) {
+            downstream->HandleFinish(std::move(image), !frameInProgress);
+            downstream.reset();
+        }
+    }
+};
+
+// Accumulate a series of mean arrival time images
+// Guarantees complete frame upon finish (all zeros if there was no frame).
+class MeanArrivalTimeAccumulator : public MeanArrivalTimeProcessor {
+    MeanArrivalTimeImage cumulative;
+
+    std::shared_ptr<MeanArrivalTimeProcessor> downstream;
+
+  public:
+    // The image must be zeroed (or contain sums to continue from)
+    MeanArrivalTimeAccumulator(
+        MeanArrivalTimeImage &&image,
+        std::shared_ptr<MeanArrivalTimeProcessor> downstream)
+        : cumulative(std::move(image)), downstream(downstream) {}
+
+    void HandleError(std::string const &message) override {
+        if (downstream) {
+            downstream->HandleError(message);
+            downstream.reset();
+        }
+    }
+
+    void HandleFrame(MeanArrivalTimeImage const &image) override {
+        cumulative += image;
+        if (downstream) {
+            downstream->HandleFrame(cumulative);
+        }
+    }
+
+    void HandleFinish(MeanArrivalTimeImage &&, bool) override {
+        // We discard any incomplete frame from upstream
+        if (downstream) {
+            downstream->HandleFinish(std::move(cumulative), true);
+            downstream.reset();
+        }
+    }
+};
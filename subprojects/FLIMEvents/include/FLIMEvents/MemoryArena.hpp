@@ -0,0 +1,207 @@
+#pragma once
+
+#include <cstddef>
+#include <cstring>
+#include <new>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#elif defined(__unix__) || defined(__APPLE__)
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+// A contiguous region of memory, allocated directly from the OS and
+// prefaulted, so that no page faults occur on first use.
+//
+// Large (huge) pages are used if available, reducing TLB misses when the
+// region is large. On Windows this requires that the user hold the "Lock
+// pages in memory" privilege (SeLockMemoryPrivilege), which is enabled for
+// the process as needed; on Linux, preallocated huge pages
+// (vm.nr_hugepages). Otherwise normal pages are used (on Linux, with a
+// request for transparent huge pages).
+//
+// The pages can optionally be locked in physical memory so that they are
+// never paged out. On Windows, the process working set is enlarged by the
+// size of the arena to make room for the locked pages (Windows large pages
+// are never paged out and need no locking). Locking may still fail due to OS
+// limits (RLIMIT_MEMLOCK on Linux), in which case the memory is still usable
+// but not locked.
+//
+// Including this header on Windows includes <windows.h>; it is therefore not
+// included by the other FLIMEvents headers.
+//
+// On other platforms, ordinary heap memory is used.
+class MemoryArena {
+    void *data = nullptr;
+    std::size_t size = 0;
+    bool hugePages = false;
+    bool locked = false;
+#ifdef _WIN32
+    bool workingSetEnlarged = false;
+#endif
+
+    static std::size_t RoundUp(std::size_t size, std::size_t multiple) {
+        return (size + multiple - 1) / multiple * multiple;
+    }
+
+#ifdef _WIN32
+    // Large page allocation requires SeLockMemoryPrivilege to be enabled in
+    // the process token (holding the privilege is not enough)
+    static bool EnableLockMemoryPrivilege() noexcept {
+        HANDLE token;
+        if (!OpenProcessToken(GetCurrentProcess(),
+                              TOKEN_ADJUST_PRIVILEGES | TOKEN_QUERY, &token)) {
+            return false;
+        }
+        TOKEN_PRIVILEGES privileges{};
+        privileges.PrivilegeCount = 1;
+        privileges.Privileges[0].Attributes = SE_PRIVILEGE_ENABLED;
+        bool ok = LookupPrivilegeValue(nullptr, SE_LOCK_MEMORY_NAME,
+                                       &privileges.Privileges[0].Luid) &&
+                  AdjustTokenPrivileges(token, FALSE, &privileges, 0,
+                                        nullptr, nullptr) &&
+                  // Not all privileges assigned if the user lacks it
+                  GetLastError() == ERROR_SUCCESS;
+        CloseHandle(token);
+        return ok;
+    }
+
+    // Grow (or, with negative delta, shrink) the working set limits
+    static bool AdjustWorkingSet(std::ptrdiff_t delta) noexcept {
+        HANDLE const process = GetCurrentProcess();
+        SIZE_T minSize, maxSize;
+        if (!GetProcessWorkingSetSize(process, &minSize, &maxSize)) {
+            return false;
+        }
+        auto const adjust = [delta](SIZE_T s) {
+            return static_cast<SIZE_T>(static_cast<std::ptrdiff_t>(s) + delta);
+        };
+        return SetProcessWorkingSetSize(process, adjust(minSize),
+                                        adjust(maxSize)) != 0;
+    }
+#endif
+
+    void Allocate(std::size_t requestedSize) {
+#ifdef _WIN32
+        SIZE_T const largePageSize = GetLargePageMinimum();
+        if (largePageSize > 0 && EnableLockMemoryPrivilege()) {
+            size = RoundUp(requestedSize, largePageSize);
+            data = VirtualAlloc(nullptr, size,
+                                MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES,
+                                PAGE_READWRITE);
+            hugePages = data != nullptr;
+        }
+        if (!data) {
+            SYSTEM_INFO info;
+            GetSystemInfo(&info);
+            size = RoundUp(requestedSize, info.dwPageSize);
+            data = VirtualAlloc(nullptr, size, MEM_RESERVE | MEM_COMMIT,
+                                PAGE_READWRITE);
+        }
+        if (!data) {
+            throw std::bad_alloc();
+        }
+#elif defined(__unix__) || defined(__APPLE__)
+#ifdef MAP_HUGETLB
+        std::size_t const hugePageSize = 2 * 1024 * 1024;
+        size = RoundUp(requestedSize, hugePageSize);
+        void *p = mmap(nullptr, size, PROT_READ | PROT_WRITE,
+                       MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (p != MAP_FAILED) {
+            data = p;
+            hugePages = true;
+        }
+#endif
+        if (!data) {
+            size = RoundUp(requestedSize,
+                           static_cast<std::size_t>(sysconf(_SC_PAGESIZE)));
+            void *p = mmap(nullptr, size, PROT_READ | PROT_WRITE,
+                           MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if (p == MAP_FAILED) {
+                throw std::bad_alloc();
+            }
+            data = p;
+#ifdef MADV_HUGEPAGE
+            madvise(data, size, MADV_HUGEPAGE); // Advisory only
+#endif
+        }
+#else
+        size = requestedSize;
+        data = ::operator new(size);
+#endif
+    }
+
+    void Lock() noexcept {
+#ifdef _WIN32
+        if (hugePages) {
+            locked = true; // Large pages are not pageable
+            return;
+        }
+        // VirtualLock() fails if the pages would not fit in the minimum
+        // working set, which is only a few hundred KiB by default
+        workingSetEnlarged =
+            AdjustWorkingSet(static_cast<std::ptrdiff_t>(size));
+        locked = VirtualLock(data, size) != 0;
+#elif defined(__unix__) || defined(__APPLE__)
+        locked = mlock(data, size) == 0;
+#endif
+    }
+
+    void Free() noexcept {
+        if (!data) {
+            return;
+        }
+#ifdef _WIN32
+        if (locked && !hugePages) {
+            VirtualUnlock(data, size);
+        }
+        VirtualFree(data, 0, MEM_RELEASE);
+        if (workingSetEnlarged) {
+            AdjustWorkingSet(-static_cast<std::ptrdiff_t>(size));
+        }
+#elif defined(__unix__) || defined(__APPLE__)
+        if (locked) {
+            munlock(data, size);
+        }
+        munmap(data, size);
+#else
+        ::operator delete(data);
+#endif
+        data = nullptr;
+    }
+
+  public:
+    // size: minimum size in bytes (rounded up to a multiple of the page size)
+    // lockPages: attempt to lock the pages in physical memory
+    explicit MemoryArena(std::size_t size, bool lockPages = false) {
+        Allocate(size > 0 ? size : 1);
+        if (lockPages) {
+            Lock();
+        }
+        // Touch every page now, rather than on first use
+        std::memset(data, 0, this->size);
+    }
+
+    ~MemoryArena() { Free(); }
+
+    MemoryArena(MemoryArena const &) = delete;
+    MemoryArena &operator=(MemoryArena const &) = delete;
+
+    void *GetData() noexcept { return data; }
+
+    void const *GetData() const noexcept { return data; }
+
+    // Actual size, which may be larger than requested
+    std::size_t GetSize() const noexcept { return size; }
+
+    bool IsUsingHugePages() const noexcept { return hugePages; }
+
+    bool IsLocked() const noexcept { return locked; }
+};
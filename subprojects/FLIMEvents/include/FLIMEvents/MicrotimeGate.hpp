@@ -0,0 +1,64 @@
+#pragma once
+
+#include "PixelPhotonEvent.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// Pass on only the photons whose microtime is in [begin, end) (in input
+// time units, before any reversal or binning); frame events are passed on
+// unchanged.
+class MicrotimeGate : public PixelPhotonProcessor {
+    uint32_t const begin;
+    uint32_t const end;
+
+    std::vector<PixelPhotonEvent> passed; // Reused for each batch
+
+    std::shared_ptr<PixelPhotonProcessor> downstream;
+
+    bool Passes(PixelPhotonEvent const &event) const noexcept {
+        return event.microtime >= begin && event.microtime < end;
+    }
+
+  public:
+    MicrotimeGate(uint32_t begin, uint32_t end,
+                  std::shared_ptr<PixelPhotonProcessor> downstream)
+        : begin(begin), end(end), downstream(downstream) {
+        if (begin >= end) {
+            throw std::invalid_argument("Microtime gate must not be empty");
+        }
+    }
+
+    void HandleBeginFrame() override { downstream->HandleBeginFrame(); }
+
+    void HandleEndFrame() override { downstream->HandleEndFrame(); }
+
+    void HandlePixelPhoton(PixelPhotonEvent const &event) override {
+        if (Passes(event)) {
+            downstream->HandlePixelPhoton(event);
+        }
+    }
+
+    void HandlePixelPhotons(PixelPhotonEvent const *events,
+                            std::size_t count) override {
+        passed.clear();
+        for (std::size_t i = 0; i < count; ++i) {
+            if (Passes(events[i])) {
+                passed.push_back(events[i]);
+            }
+        }
+        if (!passed.empty()) {
+            downstream->HandlePixelPhotons(passed.data(), passed.size());
+        }
+    }
+
+    void HandleError(std::string const &message) override {
+        downstream->HandleError(message);
+    }
+
+    void HandleFinish() override { downstream->HandleFinish(); }
+};
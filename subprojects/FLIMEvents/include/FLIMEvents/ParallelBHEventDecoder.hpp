@@ -0,0 +1,246 @@
+#pragma once
+
+#include "BHDeviceEvent.hpp"
+#include "DecodedEventBatch.hpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <future>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+ * \brief Total macro-time (in macro-time units) of the overflows recorded in
+ * a range of BH SPC event records.
+ */
+template <typename E>
+inline uint64_t SumMacroTimeOverflows(E const *events,
+                                      std::size_t count) noexcept {
+    uint64_t sum = 0;
+    for (std::size_t i = 0; i < count; ++i) {
+        if (events[i].IsMultipleMacroTimeOverflow()) {
+            sum += E::MacroTimeOverflowPeriod *
+                   events[i].GetMultipleMacroTimeOverflowCount();
+        } else if (events[i].GetMacroTimeOverflowFlag()) {
+            sum += E::MacroTimeOverflowPeriod;
+        }
+    }
+    return sum;
+}
+
+/**
+ * \brief Decode BH SPC event stream using multiple threads.
+ *
+ * This is intended for offline processing (e.g. of .spc files), where large
+ * buffers of events are available at once. Each call to HandleDeviceEvents()
+ * splits the given records into chunks and decodes them in two parallel
+ * passes: first the macro-time overflows in each chunk are summed, which
+ * (after a prefix sum) gives the macro-time base at the start of each chunk;
+ * then the chunks are decoded independently. The decoded events are sent
+ * downstream, in order, on the calling thread.
+ *
+ * The events sent downstream (including errors) are identical to those
+ * produced by BHEventDecoder<E>.
+ *
+ * \tparam E binary record interpreter class
+ */
+template <typename E>
+class ParallelBHEventDecoder : public DeviceEventProcessor {
+    // Collects all events decoded from one chunk
+    class ChunkSink : public DecodedEventProcessor {
+      public:
+        DecodedEventBatch batch;
+        std::string error;
+        bool hasError = false;
+        // Macro-time of the first event that was checked for monotonicity
+        // (i.e., all events other than timestamps)
+        uint64_t firstCheckedMacrotime = 0;
+        bool hasCheckedEvent = false;
+
+        void Check(uint64_t macrotime) {
+            if (!hasCheckedEvent) {
+                firstCheckedMacrotime = macrotime;
+                hasCheckedEvent = true;
+            }
+        }
+
+        void HandleTimestamp(DecodedEvent const &event) override {
+            batch.AddTimestamp(event);
+        }
+
+        void HandleValidPhoton(ValidPhotonEvent const &event) override {
+            Check(event.macrotime);
+            batch.AddValidPhoton(event);
+        }
+
+        void HandleValidPhotons(ValidPhotonEvent const *events,
+                                std::size_t count) override {
+            Check(events[0].macrotime);
+            for (std::size_t i = 0; i < count; ++i) {
+                batch.AddValidPhoton(events[i]);
+            }
+        }
+
+        void HandleInvalidPhoton(InvalidPhotonEvent const &event) override {
+            Check(event.macrotime);
+            batch.AddInvalidPhoton(event);
+        }
+
+        void HandleMarker(MarkerEvent const &event) override {
+            Check(event.macrotime);
+            batch.AddMarker(event);
+        }
+
+        void HandleDataLost(DataLostEvent const &event) override {
+            Check(event.macrotime);
+            batch.AddDataLost(event);
+        }
+
+        void HandleError(std::string const &message) override {
+            error = message;
+            hasError = true;
+        }
+
+        void HandleFinish() override {}
+    };
+
+    struct ChunkResult {
+        std::shared_ptr<ChunkSink> sink;
+        uint64_t lastMacrotime;
+    };
+
+    unsigned const numThreads;
+    std::size_t const minChunkSize;
+
+    uint64_t macrotimeBase = 0;
+    uint64_t lastMacrotime = 0;
+    bool stopped = false; // After an error
+
+    std::shared_ptr<DecodedBatchToEventAdapter> downstream;
+
+    static ChunkResult DecodeChunk(E const *events, std::size_t count,
+                                   uint64_t macrotimeBase,
+                                   uint64_t lastMacrotime) {
+        ChunkResult result;
+        result.sink = std::make_shared<ChunkSink>();
+        BHEventDecoder<E> decoder(result.sink, macrotimeBase, lastMacrotime);
+        decoder.HandleDeviceEvents(reinterpret_cast<char const *>(events),
+                                   count);
+        result.lastMacrotime = decoder.GetLastMacrotime();
+        return result;
+    }
+
+  public:
+    /**
+     * \param numThreads number of threads to use (0 for the number of
+     * hardware threads)
+     * \param minChunkSize minimum number of records per chunk; smaller
+     * buffers are decoded using fewer threads
+     */
+    explicit ParallelBHEventDecoder(
+        unsigned numThreads,
+        std::shared_ptr<DecodedEventProcessor> downstream,
+        std::size_t minChunkSize = 64 * 1024)
+        : numThreads(numThreads > 0
+                         ? numThreads
+                         : std::max(1u, std::thread::hardware_concurrency())),
+          minChunkSize(std::max<std::size_t>(1, minChunkSize)),
+          downstream(
+              std::make_shared<DecodedBatchToEventAdapter>(downstream)) {}
+
+    std::size_t GetEventSize() const noexcept override { return sizeof(E); }
+
+    void HandleDeviceEvent(char const *event) override {
+        HandleDeviceEvents(event, 1);
+    }
+
+    void HandleDeviceEvents(char const *events, std::size_t count) override {
+        if (stopped || count == 0) {
+            return;
+        }
+        E const *devEvts = reinterpret_cast<E const *>(events);
+
+        std::size_t nChunks = std::min<std::size_t>(
+            numThreads, (count + minChunkSize - 1) / minChunkSize);
+        std::vector<std::size_t> starts(nChunks + 1);
+        for (std::size_t k = 0; k <= nChunks; ++k) {
+            starts[k] = count * k / nChunks;
+        }
+
+        // Pass 1: sum overflows in each chunk, in parallel
+        std::vector<std::future<uint64_t>> sums;
+        for (std::size_t k = 0; k < nChunks; ++k) {
+            sums.emplace_back(std::async(
+                std::launch::async, [devEvts, &starts, k] {
+                    return SumMacroTimeOverflows(devEvts + starts[k],
+                                                 starts[k + 1] - starts[k]);
+                }));
+        }
+
+        // Exclusive prefix sum gives the base at the start of each chunk
+        std::vector<uint64_t> bases(nChunks);
+        uint64_t base = macrotimeBase;
+        for (std::size_t k = 0; k < nChunks; ++k) {
+            bases[k] = base;
+            base += sums[k].get();
+        }
+
+        // Pass 2: decode each chunk, in parallel. The chunks' initial
+        // lastMacrotime is unknown (except for the first), so it is checked
+        // below before the results are used.
+        std::vector<std::future<ChunkResult>> decoded;
+        for (std::size_t k = 0; k < nChunks; ++k) {
+            uint64_t last = k == 0 ? lastMacrotime : 0;
+            decoded.emplace_back(std::async(
+                std::launch::async, [devEvts, &starts, &bases, k, last] {
+                    return DecodeChunk(devEvts + starts[k],
+                                       starts[k + 1] - starts[k], bases[k],
+                                       last);
+                }));
+        }
+
+        // Send results downstream in order
+        for (std::size_t k = 0; k < nChunks; ++k) {
+            ChunkResult result = decoded[k].get();
+            if (stopped) {
+                continue; // Wait for remaining tasks, but discard results
+            }
+
+            // If the chunk would have failed the macro-time check against
+            // the preceding chunk, or if it contains an error, decode it
+            // again serially so that the exact same events are sent as by
+            // BHEventDecoder<E>.
+            auto const &sink = *result.sink;
+            bool decreasing = sink.hasCheckedEvent &&
+                              sink.firstCheckedMacrotime < lastMacrotime;
+            if (k > 0 && (sink.hasError || decreasing)) {
+                result = DecodeChunk(devEvts + starts[k],
+                                     starts[k + 1] - starts[k], bases[k],
+                                     lastMacrotime);
+            }
+
+            downstream->HandleDecodedEventBatch(result.sink->batch);
+            if (result.sink->hasError) {
+                downstream->HandleError(result.sink->error);
+                stopped = true;
+            }
+            lastMacrotime = std::max(lastMacrotime, result.lastMacrotime);
+        }
+        macrotimeBase = base;
+    }
+
+    void HandleError(std::string const &message) override {
+        stopped = true;
+        downstream->HandleError(message);
+    }
+
+    void HandleFinish() override {
+        stopped = true;
+        downstream->HandleFinish();
+    }
+};
+
+using ParallelBHSPCEventDecoder = ParallelBHEventDecoder<BHSPCEvent>;
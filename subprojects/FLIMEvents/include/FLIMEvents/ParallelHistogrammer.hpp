@@ -0,0 +1,251 @@
+#pragma once
+
+#include "Histogram.hpp"
+#include "PixelPhotonEvent.hpp"
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+/**
+ * \brief Collect pixel-assigned photon events into a series of histograms,
+ * using multiple threads.
+ *
+ * Rows of the image are assigned to worker threads in turn (row y to worker
+ * y % numWorkers), so that photons arriving in scan order are spread over
+ * all workers. Photons received (on the calling thread) are partitioned by
+ * worker and handed to the workers in batches; each worker clears and
+ * increments only its own rows of the shared frame histogram, so no merging
+ * or locking of histogram data is needed. At the end of each frame (and on
+ * finish) the calling thread waits for the workers to process all photons,
+ * and then sends the histogram downstream, so the HistogramProcessor<T> calls
+ * (and their order) are the same as for Histogrammer<T>.
+ *
+ * This helps when incrementing the histogram (which for large histograms is
+ * dominated by cache misses) is the bottleneck. Note that the output is a
+ * Histogram<T>, so this cannot (yet) replace AdaptiveCumulativeHistogrammer,
+ * which produces the histograms of live acquisitions and Replay.
+ */
+template <typename T>
+class ParallelHistogrammer : public PixelPhotonProcessor {
+    // A worker thread and its queue of tasks
+    class Worker {
+        Histogram<T> &histogram;
+        std::size_t const yFirst; // This worker's rows are yFirst,
+        std::size_t const yStep;  // yFirst + yStep, ...
+
+        std::mutex mutex;
+        std::condition_variable taskAvailable;
+        std::condition_variable tasksDone;
+        // Each task is a batch of photons; an empty batch means clear rows.
+        std::deque<std::vector<PixelPhotonEvent>> tasks;
+        bool busy = false; // Processing a task (removed from queue)
+        bool stopping = false;
+        // Processed batches, for reuse (avoiding allocation)
+        std::vector<std::vector<PixelPhotonEvent>> spareBatches;
+
+        std::thread thread;
+
+        void Run() {
+            std::unique_lock<std::mutex> lock(mutex);
+            for (;;) {
+                taskAvailable.wait(lock,
+                                   [&] { return stopping || !tasks.empty(); });
+                if (tasks.empty()) {
+                    return; // Stopping
+                }
+                std::vector<PixelPhotonEvent> batch = std::move(tasks.front());
+                tasks.pop_front();
+                busy = true;
+                lock.unlock();
+
+                if (batch.empty()) {
+                    for (std::size_t y = yFirst; y < histogram.GetHeight();
+                         y += yStep) {
+                        histogram.ClearRows(y, y + 1);
+                    }
+                } else {
+                    histogram.IncrementEvents(batch.data(), batch.size());
+                }
+                batch.clear();
+
+                lock.lock();
+                busy = false;
+                spareBatches.emplace_back(std::move(batch));
+                if (tasks.empty()) {
+                    tasksDone.notify_all();
+                }
+            }
+        }
+
+      public:
+        Worker(Histogram<T> &histogram, std::size_t yFirst, std::size_t yStep)
+            : histogram(histogram), yFirst(yFirst), yStep(yStep),
+              thread([this] { Run(); }) {}
+
+        ~Worker() {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                stopping = true;
+            }
+            taskAvailable.notify_one();
+            thread.join();
+        }
+
+        Worker(Worker const &) = delete;
+        Worker &operator=(Worker const &) = delete;
+
+        // Enqueue batch (empty to clear rows) and return an empty batch (for
+        // reuse by the caller)
+        std::vector<PixelPhotonEvent>
+        Enqueue(std::vector<PixelPhotonEvent> &&batch) {
+            std::vector<PixelPhotonEvent> spare;
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                tasks.emplace_back(std::move(batch));
+                if (!spareBatches.empty()) {
+                    spare = std::move(spareBatches.back());
+                    spareBatches.pop_back();
+                }
+            }
+            taskAvailable.notify_one();
+            return spare;
+        }
+
+        void WaitUntilDone() {
+            std::unique_lock<std::mutex> lock(mutex);
+            tasksDone.wait(lock, [&] { return tasks.empty() && !busy; });
+        }
+    };
+
+    Histogram<T> histogram;
+    bool frameInProgress;
+    std::size_t const batchSize;
+
+    std::vector<unsigned> rowToWorker;
+    std::vector<std::unique_ptr<Worker>> workers;
+    // Photons not yet handed to each worker
+    std::vector<std::vector<PixelPhotonEvent>> pendingBatches;
+
+    std::shared_ptr<HistogramProcessor<T>> downstream;
+
+    void FlushBatch(std::size_t w) {
+        if (!pendingBatches[w].empty()) {
+            pendingBatches[w] =
+                workers[w]->Enqueue(std::move(pendingBatches[w]));
+            pendingBatches[w].reserve(batchSize);
+        }
+    }
+
+    void AddPhoton(PixelPhotonEvent const &event) {
+        unsigned const w = rowToWorker[event.y];
+        pendingBatches[w].push_back(event);
+        if (pendingBatches[w].size() >= batchSize) {
+            FlushBatch(w);
+        }
+    }
+
+    // Wait until all photons received so far are in the histogram
+    void Synchronize() {
+        for (std::size_t w = 0; w < workers.size(); ++w) {
+            FlushBatch(w);
+        }
+        for (auto &worker : workers) {
+            worker->WaitUntilDone();
+        }
+    }
+
+  public:
+    // numThreads: 0 to use the number of hardware threads (but no more than
+    // the number of rows)
+    // batchSize: number of photons handed to a worker at a time
+    ParallelHistogrammer(Histogram<T> &&histogram, unsigned numThreads,
+                         std::shared_ptr<HistogramProcessor<T>> downstream,
+                         std::size_t batchSize = 4096)
+        : histogram(std::move(histogram)), frameInProgress(false),
+          batchSize(std::max<std::size_t>(1, batchSize)),
+          downstream(downstream) {
+        std::size_t const height = this->histogram.GetHeight();
+        if (height < 1) {
+            throw std::invalid_argument("Histogram height must be positive");
+        }
+        if (numThreads == 0) {
+            numThreads = std::max(1u, std::thread::hardware_concurrency());
+        }
+        std::size_t const numWorkers =
+            std::min<std::size_t>(numThreads, height);
+
+        rowToWorker.resize(height);
+        for (std::size_t y = 0; y < height; ++y) {
+            rowToWorker[y] = static_cast<unsigned>(y % numWorkers);
+        }
+        for (std::size_t w = 0; w < numWorkers; ++w) {
+            workers.emplace_back(
+                std::make_unique<Worker>(this->histogram, w, numWorkers));
+        }
+        pendingBatches.resize(numWorkers);
+        for (auto &batch : pendingBatches) {
+            batch.reserve(this->batchSize);
+        }
+    }
+
+    ~ParallelHistogrammer() override {
+        workers.clear(); // Join worker threads before histogram is destroyed
+    }
+
+    std::size_t GetNumberOfThreads() const noexcept { return workers.size(); }
+
+    void HandleBeginFrame() override {
+        // Workers clear their rows before processing further photons
+        for (std::size_t w = 0; w < workers.size(); ++w) {
+            FlushBatch(w);
+            pendingBatches[w] = workers[w]->Enqueue({});
+            pendingBatches[w].reserve(batchSize);
+        }
+        frameInProgress = true;
+    }
+
+    void HandleEndFrame() override {
+        Synchronize();
+        frameInProgress = false;
+        if (downstream) {
+            downstream->HandleFrame(histogram);
+        }
+    }
+
+    void HandlePixelPhoton(PixelPhotonEvent const &event) override {
+        AddPhoton(event);
+    }
+
+    void HandlePixelPhotons(PixelPhotonEvent const *events,
+                            std::size_t count) override {
+        for (std::size_t i = 0; i < count; ++i) {
+            AddPhoton(events[i]);
+        }
+    }
+
+    void HandleError(std::string const &message) override {
+        Synchronize();
+        if (downstream) {
+            downstream->HandleError(message);
+            downstream.reset();
+        }
+    }
+
+    void HandleFinish() override {
+        Synchronize();
+        if (downstream) {
+            downstream->HandleFinish(std::move(histogram), !frameInProgress);
+            downstream.reset();
+        }
+    }
+};
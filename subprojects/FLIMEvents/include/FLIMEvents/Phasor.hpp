@@ -0,0 +1,232 @@
+#pragma once
+
+#include "PixelPhotonEvent.hpp"
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Per-pixel phasor sums: the phasor coordinates of a pixel are G = sumCos /
+// count and S = sumSin / count.
+struct PhasorPixel {
+    double sumCos;
+    double sumSin;
+    uint32_t count;
+};
+
+// Image of phasor sums, taking memory proportional to width * height
+// (compared to a histogram, which is also proportional to the number of time
+// bins).
+class PhasorImage {
+    std::size_t width;
+    std::size_t height;
+
+    std::unique_ptr<PhasorPixel[]> pixels;
+
+  public:
+    ~PhasorImage() = default;
+    PhasorImage(PhasorImage const &rhs) = delete;
+    PhasorImage &operator=(PhasorImage const &rhs) = delete;
+    PhasorImage(PhasorImage &&rhs) = default;
+    PhasorImage &operator=(PhasorImage &&rhs) = default;
+
+    // Default constructor creates a "moved out" object.
+    PhasorImage() = default;
+
+    // Warning: Newly constructed image is not zeroed (for efficiency)
+    PhasorImage(std::size_t width, std::size_t height)
+        : width(width), height(height),
+          pixels(std::make_unique<PhasorPixel[]>(width * height)) {}
+
+    bool IsValid() const noexcept { return pixels.get(); }
+
+    void Clear() noexcept {
+        memset(pixels.get(), 0, width * height * sizeof(PhasorPixel));
+    }
+
+    std::size_t GetWidth() const noexcept { return width; }
+
+    std::size_t GetHeight() const noexcept { return height; }
+
+    PhasorPixel const *Get() const noexcept { return pixels.get(); }
+
+    PhasorPixel const &GetPixel(std::size_t x, std::size_t y) const noexcept {
+        return pixels[y * width + x];
+    }
+
+    // Phasor coordinates; zero for pixels with no photons
+    double GetG(std::size_t x, std::size_t y) const noexcept {
+        auto const &p = GetPixel(x, y);
+        return p.count > 0 ? p.sumCos / p.count : 0.0;
+    }
+
+    double GetS(std::size_t x, std::size_t y) const noexcept {
+        auto const &p = GetPixel(x, y);
+        return p.count > 0 ? p.sumSin / p.count : 0.0;
+    }
+
+    void Add(std::size_t x, std::size_t y, double cosPhase,
+             double sinPhase) noexcept {
+        auto &p = pixels[y * width + x];
+        p.sumCos += cosPhase;
+        p.sumSin += sinPhase;
+        ++p.count;
+    }
+
+    PhasorImage &operator+=(PhasorImage const &rhs) {
+        if (rhs.width != width || rhs.height != height) {
+            abort(); // Programming error
+        }
+
+        std::size_t const n = width * height;
+        for (std::size_t i = 0; i < n; ++i) {
+            pixels[i].sumCos += rhs.pixels[i].sumCos;
+            pixels[i].sumSin += rhs.pixels[i].sumSin;
+            pixels[i].count += rhs.pixels[i].count;
+        }
+
+        return *this;
+    }
+};
+
+// Receiver of frame-by-frame phasor image events
+class PhasorProcessor {
+  public:
+    virtual ~PhasorProcessor() = default;
+
+    virtual void HandleError(std::string const &message) = 0;
+    virtual void HandleFrame(PhasorImage const &image) = 0;
+
+    // Upon finishing, the image is moved out of its producer.
+    virtual void HandleFinish(PhasorImage &&image, bool isCompleteFrame) = 0;
+};
+
+/**
+ * \brief Collect pixel-assigned photon events into a series of phasor
+ * images.
+ *
+ * The phase of a photon is 2 pi h (t + 1/2) / 2^inputTimeBits, where h is the
+ * harmonic and t the microtime (reversed, if reverseTime, as for Histogram),
+ * so that the full microtime range is taken to be one period. The cosine and
+ * sine of the phase are looked up in tables covering the microtime range.
+ */
+class Phasorizer : public PixelPhotonProcessor {
+    PhasorImage image;
+    bool frameInProgress;
+
+    std::vector<float> cosTable;
+    std::vector<float> sinTable;
+
+    std::shared_ptr<PhasorProcessor> downstream;
+
+    void Add(PixelPhotonEvent const &event) noexcept {
+        image.Add(event.x, event.y, cosTable[event.microtime],
+                  sinTable[event.microtime]);
+    }
+
+  public:
+    Phasorizer(PhasorImage &&image, uint32_t harmonic,
+               uint32_t inputTimeBits, bool reverseTime,
+               std::shared_ptr<PhasorProcessor> downstream)
+        : image(std::move(image)), frameInProgress(false),
+          downstream(downstream) {
+        if (harmonic < 1) {
+            throw std::invalid_argument("Phasor harmonic must be positive");
+        }
+        if (inputTimeBits > 16) {
+            throw std::invalid_argument(
+                "Phasor input time bits must not exceed 16");
+        }
+
+        double const pi = 3.14159265358979323846;
+        std::size_t const nTimes = std::size_t(1) << inputTimeBits;
+        cosTable.resize(nTimes);
+        sinTable.resize(nTimes);
+        for (std::size_t t = 0; t < nTimes; ++t) {
+            std::size_t const tt = reverseTime ? nTimes - 1 - t : t;
+            double const phase = 2.0 * pi * harmonic * (tt + 0.5) / nTimes;
+            cosTable[t] = static_cast<float>(std::cos(phase));
+            sinTable[t] = static_cast<float>(std::sin(phase));
+        }
+    }
+
+    void HandleBeginFrame() override {
+        image.Clear();
+        frameInProgress = true;
+    }
+
+    void HandleEndFrame() override {
+        frameInProgress = false;
+        if (downstream) {
+            downstream->HandleFrame(image);
+        }
+    }
+
+    void HandlePixelPhoton(PixelPhotonEvent const &event) override {
+        Add(event);
+    }
+
+    void HandlePixelPhotons(PixelPhotonEvent const *events,
+                            std::size_t count) override {
+        for (std::size_t i = 0; i < count; ++i) {
+            Add(events[i]);
+        }
+    }
+
+    void HandleError(std::string const &message) override {
+        if (downstream) {
+            downstream->HandleError(message);
+            downstream.reset();
+        }
+    }
+
+    void HandleFinish() override {
+        if (downstream) {
+            downstream->HandleFinish(std::move(image), !frameInProgress);
+            downstream.reset();
+        }
+    }
+};
+
+// Accumulate a series of phasor images
+// Guarantees complete frame upon finish (all zeros if there was no frame).
+class PhasorAccumulator : public PhasorProcessor {
+    PhasorImage cumulative;
+
+    std::shared_ptr<PhasorProcessor> downstream;
+
+  public:
+    // The image must be zeroed (or contain sums to continue from)
+    PhasorAccumulator(PhasorImage &&image,
+                      std::shared_ptr<PhasorProcessor> downstream)
+        : cumulative(std::move(image)), downstream(downstream) {}
+
+    void HandleError(std::string const &message) override {
+        if (downstream) {
+            downstream->HandleError(message);
+            downstream.reset();
+        }
+    }
+
+    void HandleFrame(PhasorImage const &image) override {
+        cumulative += image;
+        if (downstream) {
+            downstream->HandleFrame(cumulative);
+        }
+    }
+
+    void HandleFinish(PhasorImage &&, bool) override {
+        // We discard any incomplete frame from upstream
+        if (downstream) {
+            downstream->HandleFinish(std::move(cumulative), true);
+            downstream.reset();
+        }
+    }
+};
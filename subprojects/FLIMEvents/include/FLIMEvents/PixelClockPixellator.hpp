@@ -0,0 +1,486 @@
+#pragma once
+
+#include "DecodedEvent.hpp"
+#include "PixelPhotonEvent.hpp"
+#include "RingBuffer.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// Assign pixels to photons using pixel clock, optionally resynchronized by
+// line and/or frame clock.
+//
+// Each pixel marker starts the next pixel in raster order; the pixel spans
+// pixelTime macro-time units starting pixelDelay after the marker. A line
+// (frame) marker indicates that the next pixel marker starts a new line
+// (frame): if pixels of the current line (frame) are missing (e.g. due to
+// missed pixel markers), the remainder of the line (frame) is skipped.
+// Conversely, when line (frame) markers are used, pixel markers arriving
+// after the current line (frame) is complete but before the next line
+// (frame) marker (e.g. spurious pixel markers) are extra: their photons are
+// discarded, so that the next line starts where its marker says. Line and
+// frame markers must therefore precede (or coincide with) the first pixel
+// marker of their line or frame. Marker bits >= 16 mean not used.
+class PixelClockPixellator : public DecodedEventProcessor {
+    uint32_t const pixelsPerLine;
+    uint32_t const linesPerFrame;
+    uint32_t const maxFrames;
+    uint64_t const pixelsPerFrame;
+
+    int32_t const pixelDelay; // in macro-time units
+    uint32_t const pixelTime; // in macro-time units
+    decltype(MarkerEvent::bits) const pixelMarkerMask;
+    decltype(MarkerEvent::bits) const lineMarkerMask;
+    decltype(MarkerEvent::bits) const frameMarkerMask;
+
+    uint64_t latestTimestamp = 0; // Latest observed macro-time
+
+    // Cumulative pixel number (no reset on new line or frame); incremented
+    // on pixel finish, i.e. when all photons for the pixel have been emitted
+    uint64_t currentPixel = 0;
+    bool inPixel = false; // Whether currentPixel has been started
+    // Whether the started pixel is extra (not currentPixel; photons are
+    // discarded)
+    bool inExtraPixel = false;
+
+    // Cumulative pixel number of the first pixel of the current (or just
+    // completed) line
+    uint64_t lineStartPixel = 0;
+
+    // Start time of current pixel, or UINT64_MAX if no pixel started.
+    uint64_t pixelStartTime = UINT64_MAX;
+    uint64_t lastPixelStartTime = 0;
+
+    // Number of pixels skipped due to resynchronization
+    uint64_t skippedPixelCount = 0;
+
+    // Number of extra pixel markers (with photons discarded) between a
+    // complete line or frame and the next line or frame marker
+    uint64_t extraPixelCount = 0;
+
+    // Compact copy of ValidPhotonEvent for buffering
+    struct PendingPhoton {
+        uint64_t macrotime;
+        uint16_t microtime;
+        uint16_t route;
+    };
+
+    enum : uint8_t {
+        ResyncLine = 1,
+        ResyncFrame = 2,
+    };
+
+    struct PendingPixel {
+        uint64_t markerTime;
+        uint8_t resync; // ResyncLine and/or ResyncFrame
+    };
+
+    // Buffer received photons until we can assign to pixel
+    RingBuffer<PendingPhoton> pendingPhotons;
+
+    // Buffer pixel marks until we are ready to process
+    RingBuffer<PendingPixel> pendingPixels;
+
+    // Line/frame markers seen since the last pixel marker
+    uint8_t pendingResync = 0;
+
+    // Photons being sent downstream (accumulated over pixels, so that
+    // downstream receives them in batches)
+    std::vector<PixelPhotonEvent> emitBuffer;
+
+    std::shared_ptr<PixelPhotonProcessor> downstream;
+
+    struct Error {
+        std::string message;
+        explicit Error(std::string m) : message(m) {}
+    };
+
+  private:
+    static decltype(MarkerEvent::bits) MarkerMask(uint32_t bit) {
+        if (bit >= 8 * sizeof(decltype(MarkerEvent::bits))) {
+            return 0;
+        }
+        return static_cast<decltype(MarkerEvent::bits)>(1u << bit);
+    }
+
+    static uint64_t RoundUp(uint64_t n, uint64_t multiple) {
+        return (n + multiple - 1) / multiple * multiple;
+    }
+
+    void UpdateTimeRange(uint64_t macrotime) { latestTimestamp = macrotime; }
+
+    void FlushEmitBuffer() {
+        if (!emitBuffer.empty()) {
+            if (downstream) {
+                downstream->HandlePixelPhotons(emitBuffer.data(),
+                                               emitBuffer.size());
+            }
+            emitBuffer.clear();
+        }
+    }
+
+    void BeginFrame() {
+        FlushEmitBuffer();
+        // Check for last frame here in case maxFrames == 0.
+        if (currentPixel / pixelsPerFrame == maxFrames) {
+            if (downstream) {
+                downstream->HandleFinish();
+                downstream.reset();
+            }
+        }
+
+        if (downstream) {
+            downstream->HandleBeginFrame();
+        }
+    }
+
+    // Called when currentPixel has just been advanced to a frame boundary
+    void EndFrame() {
+        FlushEmitBuffer();
+        if (downstream) {
+            downstream->HandleEndFrame();
+        }
+
+        // Check for last frame here to send finish as soon as possible.
+        // (The case of maxFrames == 0 is not handled here.)
+        if (currentPixel / pixelsPerFrame == maxFrames) {
+            if (downstream) {
+                downstream->HandleFinish();
+                downstream.reset();
+            }
+        }
+    }
+
+    uint64_t CheckPixelStart(uint64_t pixelMarkerTime) {
+        uint64_t startTime;
+        if (pixelDelay >= 0) {
+            startTime = pixelMarkerTime + pixelDelay;
+        } else {
+            uint64_t minusDelay = -pixelDelay;
+            if (pixelMarkerTime < minusDelay) {
+                throw Error("Pixel at negative time");
+            }
+            startTime = pixelMarkerTime - minusDelay;
+        }
+        if (pixelStartTime != UINT64_MAX &&
+            startTime < pixelStartTime + pixelTime) {
+            throw Error("Pixels overlapping in time");
+        }
+        return startTime;
+    }
+
+    // Whether a pixel (marker) with the given resync flags, arriving at
+    // currentPixel, follows a complete line or frame without the line or
+    // frame marker that should start the next one
+    bool IsExtraPixel(uint8_t resync) const noexcept {
+        bool const frameComplete =
+            currentPixel > 0 && currentPixel % pixelsPerFrame == 0;
+        if (frameMarkerMask && frameComplete && !(resync & ResyncFrame)) {
+            return true;
+        }
+        bool const lineComplete =
+            currentPixel == lineStartPixel + pixelsPerLine;
+        return lineMarkerMask && lineComplete &&
+               !(resync & (ResyncLine | ResyncFrame));
+    }
+
+    void Resync(uint8_t resync) {
+        // Lines and frames are never overrun (see IsExtraPixel()), so the
+        // current frame ends at the next multiple of pixelsPerFrame
+        uint64_t target = currentPixel;
+        if (resync & ResyncFrame) {
+            target = RoundUp(target, pixelsPerFrame);
+        } else if ((resync & ResyncLine) && currentPixel > lineStartPixel) {
+            target = lineStartPixel + pixelsPerLine;
+        }
+        if (target == currentPixel) {
+            return;
+        }
+        skippedPixelCount += target - currentPixel;
+        // Skipping stays within the current frame (which has been begun,
+        // because currentPixel is not at a frame boundary), ending it if we
+        // reach the next frame.
+        currentPixel = target;
+        if (currentPixel % pixelsPerFrame == 0) {
+            EndFrame();
+        }
+    }
+
+    void StartPixel(PendingPixel const &pixel) {
+        pixelStartTime = CheckPixelStart(pixel.markerTime);
+        lastPixelStartTime = pixelStartTime;
+        inPixel = true;
+
+        if (IsExtraPixel(pixel.resync)) {
+            ++extraPixelCount;
+            inExtraPixel = true;
+            return;
+        }
+
+        Resync(pixel.resync);
+        if (currentPixel % pixelsPerLine == 0) {
+            lineStartPixel = currentPixel;
+        }
+
+        if (currentPixel % pixelsPerFrame == 0) {
+            BeginFrame();
+        }
+    }
+
+    void FinishPixel() {
+        inPixel = false;
+        if (inExtraPixel) {
+            inExtraPixel = false;
+            return;
+        }
+        ++currentPixel;
+        if (currentPixel % pixelsPerFrame == 0) {
+            EndFrame();
+        }
+    }
+
+    // Append the first count buffered photons, which must all be in the
+    // current pixel, to the emit buffer, and remove them from the buffer
+    void EmitPhotons(std::size_t count) {
+        if (count == 0) {
+            return;
+        }
+        if (downstream) {
+            auto const frame =
+                static_cast<uint32_t>(currentPixel / pixelsPerFrame);
+            auto const pixelInFrame = currentPixel % pixelsPerFrame;
+            PixelPhotonEvent newEvent;
+            newEvent.frame = frame;
+            newEvent.y = static_cast<uint32_t>(pixelInFrame / pixelsPerLine);
+            newEvent.x = static_cast<uint32_t>(pixelInFrame % pixelsPerLine);
+            for (std::size_t i = 0; i < count; ++i) {
+                auto const &photon = pendingPhotons[i];
+                newEvent.route = photon.route;
+                newEvent.microtime = photon.microtime;
+                emitBuffer.push_back(newEvent);
+            }
+        }
+        pendingPhotons.PopFront(count);
+    }
+
+    // If in pixel, process photons in current pixel.
+    // If between pixels, start pixel if possible and do same.
+    // Finish pixel if possible.
+    // Return false if nothing more to process.
+    bool ProcessPixelPhotons() {
+        if (!inPixel) {
+            if (pendingPixels.IsEmpty()) {
+                // Nothing to do until a new pixel can be started
+                return false;
+            }
+            PendingPixel pixel = pendingPixels.Front();
+            pendingPixels.PopFront();
+
+            StartPixel(pixel);
+            if (!downstream) {
+                return false; // Reached maxFrames
+            }
+        }
+
+        // Discard all photons before current pixel
+        std::size_t const pendingCount = pendingPhotons.GetSize();
+        std::size_t discard = 0;
+        while (discard < pendingCount &&
+               pendingPhotons[discard].macrotime < pixelStartTime) {
+            ++discard;
+        }
+        pendingPhotons.PopFront(discard);
+
+        // Emit all buffered photons for current pixel
+        auto pixelEndTime = pixelStartTime + pixelTime;
+        std::size_t const remaining = pendingCount - discard;
+        std::size_t inCurrentPixel = 0;
+        while (inCurrentPixel < remaining &&
+               pendingPhotons[inCurrentPixel].macrotime < pixelEndTime) {
+            ++inCurrentPixel;
+        }
+        if (inExtraPixel) {
+            pendingPhotons.PopFront(inCurrentPixel);
+        } else {
+            EmitPhotons(inCurrentPixel);
+        }
+
+        // Finish pixel if we have seen all photons within it
+        if (latestTimestamp >= pixelEndTime) {
+            FinishPixel();
+            return true; // There may be more pixels to process
+        } else {
+            return false; // Still in pixel but no more photons
+        }
+    }
+
+    // When this function returns, all photons that can be emitted have been
+    // emitted and all frames (and, internally, pixels) for which we have seen
+    // all photons have been finished.
+    void ProcessPhotonsAndPixels() {
+        if (!downstream) {
+            return;
+        }
+        try {
+            while (downstream && ProcessPixelPhotons())
+                ;
+            FlushEmitBuffer();
+            // Give up if we don't see any pixels in a very long time
+            // (for now, 10/20 s for 25/50 ns macrotime period).
+            if (latestTimestamp > lastPixelStartTime + 400'000'000uLL) {
+                throw Error(
+                    "More than 400M macrotime units since last pixel start");
+            }
+        } catch (Error const &e) {
+            FlushEmitBuffer();
+            if (downstream) {
+                downstream->HandleError(e.message);
+                downstream.reset();
+            }
+        }
+    }
+
+  public:
+    PixelClockPixellator(uint32_t pixelsPerLine, uint32_t linesPerFrame,
+                         uint32_t maxFrames, int32_t pixelDelay,
+                         uint32_t pixelTime, uint32_t pixelMarkerBit,
+                         uint32_t lineMarkerBit, uint32_t frameMarkerBit,
+                         std::shared_ptr<PixelPhotonProcessor> downstream)
+        : pixelsPerLine(pixelsPerLine), linesPerFrame(linesPerFrame),
+          maxFrames(maxFrames),
+          pixelsPerFrame(uint64_t(pixelsPerLine) * linesPerFrame),
+          pixelDelay(pixelDelay), pixelTime(pixelTime),
+          pixelMarkerMask(MarkerMask(pixelMarkerBit)),
+          lineMarkerMask(MarkerMask(lineMarkerBit)),
+          frameMarkerMask(MarkerMask(frameMarkerBit)),
+          downstream(downstream) {
+        if (pixelsPerLine < 1) {
+            throw std::invalid_argument("pixelsPerLine must be positive");
+        }
+        if (linesPerFrame < 1) {
+            throw std::invalid_argument("linesPerFrame must be positive");
+        }
+        if (pixelTime < 1) {
+            throw std::invalid_argument("pixelTime must be positive");
+        }
+        if (!pixelMarkerMask) {
+            throw std::invalid_argument("pixelMarkerBit out of range");
+        }
+        if ((pixelMarkerMask & (lineMarkerMask | frameMarkerMask)) ||
+            (lineMarkerMask & frameMarkerMask)) {
+            throw std::invalid_argument("Marker bits must differ");
+        }
+    }
+
+    // Number of pixels skipped so far because line or frame markers arrived
+    // before the expected number of pixel markers
+    uint64_t GetSkippedPixelCount() const noexcept {
+        return skippedPixelCount;
+    }
+
+    // Number of pixel markers ignored so far because they arrived after a
+    // complete line or frame but before the next line or frame marker
+    uint64_t GetExtraPixelCount() const noexcept { return extraPixelCount; }
+
+    void HandleTimestamp(DecodedEvent const &event) override {
+        auto prevTimestamp = latestTimestamp;
+        UpdateTimeRange(event.macrotime);
+        // Limit the rate at which we process based on time stamps only (see
+        // LineClockPixellator).
+        if (latestTimestamp > prevTimestamp + 800000) {
+            ProcessPhotonsAndPixels();
+        }
+    }
+
+    void HandleDataLost(DataLostEvent const &event) override {
+        UpdateTimeRange(event.macrotime);
+        ProcessPhotonsAndPixels();
+        if (downstream) {
+            downstream->HandleError(
+                "Data lost due to device buffer (FIFO) overflow");
+            downstream.reset();
+        }
+    }
+
+    void HandleValidPhoton(ValidPhotonEvent const &event) override {
+        HandleValidPhotons(&event, 1);
+    }
+
+    void HandleValidPhotons(ValidPhotonEvent const *events,
+                            std::size_t count) override {
+        if (count == 0) {
+            return;
+        }
+        // Photons are in macro-time order, so the last one is the latest
+        UpdateTimeRange(events[count - 1].macrotime);
+        if (!downstream) {
+            return; // Avoid buffering post-error
+        }
+        pendingPhotons.PushBack(events, count, [](ValidPhotonEvent const &e) {
+            PendingPhoton p;
+            p.macrotime = e.macrotime;
+            p.microtime = e.microtime;
+            p.route = e.route;
+            return p;
+        });
+        if (pendingPhotons.GetSize() > 64) {
+            ProcessPhotonsAndPixels();
+        }
+    }
+
+    void HandleInvalidPhoton(InvalidPhotonEvent const &event) override {
+        UpdateTimeRange(event.macrotime);
+    }
+
+    void HandleMarker(MarkerEvent const &event) override {
+        UpdateTimeRange(event.macrotime);
+        if (!downstream) {
+            return; // Avoid buffering post-error
+        }
+        if (event.bits & lineMarkerMask) {
+            pendingResync |= ResyncLine;
+        }
+        if (event.bits & frameMarkerMask) {
+            pendingResync |= ResyncFrame;
+        }
+        if (event.bits & pixelMarkerMask) {
+            PendingPixel pixel;
+            pixel.markerTime = event.macrotime;
+            pixel.resync = pendingResync;
+            pendingPixels.PushBack(pixel);
+            pendingResync = 0;
+            // Pixel markers are frequent; processing a few at a time lets
+            // downstream receive photons in larger batches.
+            if (pendingPixels.GetSize() > 64) {
+                ProcessPhotonsAndPixels();
+            }
+        }
+    }
+
+    void HandleError(std::string const &message) override {
+        ProcessPhotonsAndPixels(); // Emit any buffered data
+        if (downstream) {
+            downstream->HandleError(message);
+            downstream.reset();
+        }
+    }
+
+    void HandleFinish() override {
+        ProcessPhotonsAndPixels(); // Emit any buffered data
+
+        // Note we do _not_ end the current frame: if it is incomplete,
+        // downstream decides what to do with it.
+
+        if (downstream) {
+            downstream->HandleFinish();
+            downstream.reset();
+        }
+    }
+
+    // Emit all buffered data (for testing)
+    void Flush() { ProcessPhotonsAndPixels(); }
+};
@@ -3,6 +3,7 @@
 #include "DecodedEvent.hpp"
 
 #include <array>
+#include <cstddef>
 #include <cstdlib>
 #include <memory>
 #include <string>
@@ -23,6 +24,16 @@ class PixelPhotonProcessor {
     virtual void HandleBeginFrame() = 0;
     virtual void HandleEndFrame() = 0;
     virtual void HandlePixelPhoton(PixelPhotonEvent const &event) = 0;
+
+    // Receive several photons at once (typically all photons of a line, in
+    // order). The default implementation calls HandlePixelPhoton() for each.
+    virtual void HandlePixelPhotons(PixelPhotonEvent const *events,
+                                    std::size_t count) {
+        for (std::size_t i = 0; i < count; ++i) {
+            HandlePixelPhoton(events[i]);
+        }
+    }
+
     virtual void HandleError(std::string const &message) = 0;
     virtual void HandleFinish() = 0;
 };
@@ -55,6 +66,13 @@ class BroadcastPixelPhotonProcessor : public PixelPhotonProcessor {
         }
     }
 
+    void HandlePixelPhotons(PixelPhotonEvent const *events,
+                            std::size_t count) override {
+        for (auto &d : downstreams) {
+            d->HandlePixelPhotons(events, count);
+        }
+    }
+
     void HandleError(std::string const &message) override {
         for (auto &d : downstreams) {
             d->HandleError(message);
@@ -2,66 +2,171 @@
 
 #include "PixelPhotonEvent.hpp"
 
+#include <array>
+#include <cstddef>
+#include <cstdint>
 #include <memory>
 #include <stdexcept>
+#include <string>
 #include <vector>
 
+namespace internal {
+
+// Discards all events; destination of unused routes
+class NullPixelPhotonProcessor final : public PixelPhotonProcessor {
+  public:
+    void HandleBeginFrame() override {}
+    void HandleEndFrame() override {}
+    void HandlePixelPhoton(PixelPhotonEvent const &) override {}
+    void HandlePixelPhotons(PixelPhotonEvent const *, std::size_t) override {}
+    void HandleError(std::string const &) override {}
+    void HandleFinish() override {}
+};
+
+} // namespace internal
+
+// Route photons to downstreams by their route (channel) number. Routes
+// outside of the range of downstreams, or whose downstream is null, are
+// discarded. A downstream may serve several routes; it receives frame, error,
+// and finish events once.
+// Routing uses a table of raw pointers (kept valid by the owning
+// shared_ptrs), in which unused routes point to a null sink, so that routing
+// a photon is a table lookup and a virtual call.
 class PixelPhotonRouter : public PixelPhotonProcessor {
+    static constexpr std::size_t tableSize = 16; // 4-bit BH routing signals
+
     // Indexed by channel number
     std::vector<std::shared_ptr<PixelPhotonProcessor>> downstreams;
 
+    // Each distinct non-null downstream, once, in order of first route
+    std::vector<PixelPhotonProcessor *> uniqueDownstreams;
+
+    internal::NullPixelPhotonProcessor nullSink;
+    std::array<PixelPhotonProcessor *, tableSize> table;
+
+    // Index into uniqueDownstreams (and batches) for each route; the null
+    // sink has index uniqueDownstreams.size()
+    std::array<uint8_t, tableSize> routeSlot;
+
+    // Per-unique-downstream partition of the current batch (reused)
+    std::vector<std::vector<PixelPhotonEvent>> batches;
+
+    void BuildTable() {
+        for (std::size_t r = 0; r < tableSize; ++r) {
+            PixelPhotonProcessor *d =
+                r < downstreams.size() ? downstreams[r].get() : nullptr;
+            std::size_t slot = 0;
+            while (slot < uniqueDownstreams.size() &&
+                   uniqueDownstreams[slot] != d) {
+                ++slot;
+            }
+            if (d && slot == uniqueDownstreams.size()) {
+                uniqueDownstreams.push_back(d);
+            }
+            table[r] = d ? d : &nullSink;
+            routeSlot[r] = static_cast<uint8_t>(d ? slot : tableSize);
+        }
+        for (auto &slot : routeSlot) {
+            if (slot == tableSize) {
+                slot = static_cast<uint8_t>(uniqueDownstreams.size());
+            }
+        }
+        batches.resize(uniqueDownstreams.size() + 1);
+    }
+
+    std::size_t SlotOf(PixelPhotonEvent const &event) const noexcept {
+        auto const route = event.route;
+        return route < tableSize ? routeSlot[route]
+                                 : uniqueDownstreams.size();
+    }
+
   public:
     // Downstreams indexed by channel number; may be null
     template <typename... T>
     explicit PixelPhotonRouter(T... downstreams)
-        : downstreams{{downstreams...}} {}
+        : PixelPhotonRouter(
+              std::vector<std::shared_ptr<PixelPhotonProcessor>>{
+                  downstreams...}) {}
 
     explicit PixelPhotonRouter(
         std::vector<std::shared_ptr<PixelPhotonProcessor>> downstreams)
-        : downstreams(downstreams) {}
+        : downstreams(downstreams) {
+        if (downstreams.size() > tableSize) {
+            throw std::invalid_argument("Too many routes for router");
+        }
+        BuildTable();
+    }
+
+    // The table holds pointers to our own null sink
+    PixelPhotonRouter(PixelPhotonRouter const &) = delete;
+    PixelPhotonRouter &operator=(PixelPhotonRouter const &) = delete;
 
     void HandleBeginFrame() override {
-        for (auto &d : downstreams) {
-            if (d) {
-                d->HandleBeginFrame();
-            }
+        for (auto d : uniqueDownstreams) {
+            d->HandleBeginFrame();
         }
     }
 
     void HandleEndFrame() override {
-        for (auto &d : downstreams) {
-            if (d) {
-                d->HandleEndFrame();
-            }
+        for (auto d : uniqueDownstreams) {
+            d->HandleEndFrame();
         }
     }
 
     void HandlePixelPhoton(PixelPhotonEvent const &event) override {
-        auto channel = event.route;
-        std::shared_ptr<PixelPhotonProcessor> d;
-        try {
-            d = downstreams.at(channel);
-        } catch (std::out_of_range const &) {
+        auto const route = event.route;
+        if (route < tableSize) {
+            table[route]->HandlePixelPhoton(event);
+        }
+    }
+
+    // Partition the batch by downstream in one pass, preserving the order of
+    // photons sent to each downstream (including a downstream shared by
+    // several routes). A batch that goes entirely to one downstream (as when
+    // a single channel is in use) is passed on without copying.
+    void HandlePixelPhotons(PixelPhotonEvent const *events,
+                            std::size_t count) override {
+        if (count == 0) {
+            return;
+        }
+        std::size_t const nullSlot = uniqueDownstreams.size();
+        std::size_t const firstSlot = SlotOf(events[0]);
+        std::size_t n = 1;
+        while (n < count && SlotOf(events[n]) == firstSlot) {
+            ++n;
+        }
+        if (n == count) {
+            if (firstSlot < nullSlot) {
+                uniqueDownstreams[firstSlot]->HandlePixelPhotons(events,
+                                                                 count);
+            }
             return;
         }
-        if (d) {
-            d->HandlePixelPhoton(event);
+
+        for (auto &b : batches) {
+            b.clear();
+        }
+        batches[firstSlot].assign(events, events + n);
+        for (std::size_t i = n; i < count; ++i) {
+            batches[SlotOf(events[i])].push_back(events[i]);
+        }
+        for (std::size_t s = 0; s < nullSlot; ++s) {
+            if (!batches[s].empty()) {
+                uniqueDownstreams[s]->HandlePixelPhotons(batches[s].data(),
+                                                         batches[s].size());
+            }
         }
     }
 
     void HandleError(std::string const &message) override {
-        for (auto &d : downstreams) {
-            if (d) {
-                d->HandleError(message);
-            }
+        for (auto d : uniqueDownstreams) {
+            d->HandleError(message);
         }
     }
 
     void HandleFinish() override {
-        for (auto &d : downstreams) {
-            if (d) {
-                d->HandleFinish();
-            }
+        for (auto d : uniqueDownstreams) {
+            d->HandleFinish();
         }
     }
 };
@@ -0,0 +1,103 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <memory>
+
+// A FIFO queue stored in a single contiguous array, whose capacity is a power
+// of two (so that wrapping indices is a mask) and is doubled when full.
+// T must be default-constructible and copyable; elements are never destroyed
+// individually, so this is intended for small plain structs.
+template <typename T> class RingBuffer {
+    std::unique_ptr<T[]> data;
+    std::size_t capacity;
+    std::size_t head = 0; // Index of front element
+    std::size_t size = 0;
+
+    void Grow(std::size_t minCapacity) {
+        std::size_t newCapacity = capacity;
+        while (newCapacity < minCapacity) {
+            newCapacity *= 2;
+        }
+        std::unique_ptr<T[]> newData(new T[newCapacity]);
+        // Copy in two parts: from head to end of array, and wrapped part
+        std::size_t const firstPart = std::min(size, capacity - head);
+        std::copy(data.get() + head, data.get() + head + firstPart,
+                  newData.get());
+        std::copy(data.get(), data.get() + (size - firstPart),
+                  newData.get() + firstPart);
+        data = std::move(newData);
+        capacity = newCapacity;
+        head = 0;
+    }
+
+  public:
+    // initialCapacity is rounded up to a power of two
+    explicit RingBuffer(std::size_t initialCapacity = 64) : capacity(1) {
+        while (capacity < initialCapacity) {
+            capacity *= 2;
+        }
+        data.reset(new T[capacity]);
+    }
+
+    std::size_t GetSize() const noexcept { return size; }
+
+    bool IsEmpty() const noexcept { return size == 0; }
+
+    std::size_t GetCapacity() const noexcept { return capacity; }
+
+    void Reserve(std::size_t minCapacity) {
+        if (minCapacity > capacity) {
+            Grow(minCapacity);
+        }
+    }
+
+    // Element at given position from the front (no bounds check)
+    T &operator[](std::size_t index) noexcept {
+        return data[(head + index) & (capacity - 1)];
+    }
+
+    T const &operator[](std::size_t index) const noexcept {
+        return data[(head + index) & (capacity - 1)];
+    }
+
+    T &Front() noexcept { return data[head]; }
+
+    T const &Front() const noexcept { return data[head]; }
+
+    void PushBack(T const &value) {
+        if (size == capacity) {
+            Grow(capacity + 1);
+        }
+        data[(head + size) & (capacity - 1)] = value;
+        ++size;
+    }
+
+    // Append convert(source[i]) for i in [0, count). Faster than repeated
+    // PushBack(), because the indices are kept in local variables (writes to
+    // elements could otherwise alias them and force reloading).
+    template <typename S, typename F>
+    void PushBack(S const *source, std::size_t count, F convert) {
+        Reserve(size + count);
+        T *const d = data.get();
+        std::size_t const mask = capacity - 1;
+        std::size_t const tail = head + size;
+        for (std::size_t i = 0; i < count; ++i) {
+            d[(tail + i) & mask] = convert(source[i]);
+        }
+        size += count;
+    }
+
+    void PopFront() noexcept { PopFront(1); }
+
+    // Remove count elements from the front (count must not exceed size)
+    void PopFront(std::size_t count) noexcept {
+        head = (head + count) & (capacity - 1);
+        size -= count;
+    }
+
+    void Clear() noexcept {
+        head = 0;
+        size = 0;
+    }
+};
@@ -0,0 +1,62 @@
+#pragma once
+
+#include "PixelPhotonEvent.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// Map pixel coordinates to those of factor x factor bins, so that downstream
+// images and histograms have dimensions reduced by the factor (rounded up, if
+// the image size is not a multiple; see GetBinnedSize()).
+class SpatialBinner : public PixelPhotonProcessor {
+    uint32_t const factor;
+
+    std::vector<PixelPhotonEvent> binned; // Reused for each batch
+
+    std::shared_ptr<PixelPhotonProcessor> downstream;
+
+  public:
+    SpatialBinner(uint32_t factor,
+                  std::shared_ptr<PixelPhotonProcessor> downstream)
+        : factor(factor), downstream(downstream) {
+        if (factor < 1) {
+            throw std::invalid_argument("Binning factor must be positive");
+        }
+    }
+
+    // Number of bins covering size pixels
+    static uint32_t GetBinnedSize(uint32_t size, uint32_t factor) noexcept {
+        return (size + factor - 1) / factor;
+    }
+
+    void HandleBeginFrame() override { downstream->HandleBeginFrame(); }
+
+    void HandleEndFrame() override { downstream->HandleEndFrame(); }
+
+    void HandlePixelPhoton(PixelPhotonEvent const &event) override {
+        PixelPhotonEvent e = event;
+        e.x /= factor;
+        e.y /= factor;
+        downstream->HandlePixelPhoton(e);
+    }
+
+    void HandlePixelPhotons(PixelPhotonEvent const *events,
+                            std::size_t count) override {
+        binned.assign(events, events + count);
+        for (auto &e : binned) {
+            e.x /= factor;
+            e.y /= factor;
+        }
+        downstream->HandlePixelPhotons(binned.data(), binned.size());
+    }
+
+    void HandleError(std::string const &message) override {
+        downstream->HandleError(message);
+    }
+
+    void HandleFinish() override { downstream->HandleFinish(); }
+};
@@ -1,10 +1,15 @@
 #pragma once
 
+#include <algorithm>
+#include <atomic>
 #include <condition_variable>
+#include <cstddef>
 #include <deque>
 #include <exception>
 #include <memory>
 #include <mutex>
+#include <stdexcept>
+#include <thread>
 #include <vector>
 
 // Fixed-capacity reusable memory to hold a bunch of photon events
@@ -12,11 +17,17 @@
 template <typename E> class EventBuffer {
     std::size_t const capacity;
     std::size_t size;
-    std::unique_ptr<E[]> events;
+    std::unique_ptr<E[]> ownedEvents;
+    E *events;
 
   public:
     explicit EventBuffer(std::size_t capacity)
-        : capacity(capacity), size(0), events(new E[capacity]) {}
+        : capacity(capacity), size(0), ownedEvents(new E[capacity]),
+          events(ownedEvents.get()) {}
+
+    // Use storage owned by the caller, which must outlive this buffer
+    EventBuffer(std::size_t capacity, E *storage)
+        : capacity(capacity), size(0), events(storage) {}
 
     std::size_t GetCapacity() const noexcept { return capacity; }
 
@@ -24,47 +35,186 @@ template <typename E> class EventBuffer {
 
     void SetSize(std::size_t size) noexcept { this->size = size; }
 
-    E *GetData() noexcept { return events.get(); }
+    E *GetData() noexcept { return events; }
+
+    E const *GetData() const noexcept { return events; }
+};
+
+// What EventBufferPool::CheckOut() does when the maximum number of buffers
+// are checked out
+enum class EventBufferPoolPolicy {
+    Block, // Wait until a buffer is checked in
+    Drop,  // Return null (the caller must account for the lost data)
+};
 
-    E const *GetData() const noexcept { return events.get(); }
+// Usage counters of an EventBufferPool
+struct EventBufferPoolStats {
+    std::size_t allocationCount;      // Number of buffers allocated
+    std::size_t peakOutstandingCount; // Max buffers checked out at once
+    std::size_t blockCount;           // CheckOut() calls that had to wait
+    std::size_t dropCount;            // CheckOut() calls that returned null
 };
 
 template <typename E> class EventBufferPool {
     std::size_t const bufferSize;
+    std::size_t const maxCount;
+    EventBufferPoolPolicy const policy;
+
+    std::shared_ptr<void> arena; // Arena mode only
+    std::size_t arenaBufferCount = 0;
 
     std::mutex mutex;
+    std::condition_variable bufferAvailableCondition;
     std::vector<std::unique_ptr<EventBuffer<E>>> buffers;
+    std::size_t outstandingCount = 0;
+    bool cancelled = false;
+    EventBufferPoolStats stats{};
 
     std::unique_ptr<EventBuffer<E>> MakeBuffer() {
         return std::make_unique<EventBuffer<E>>(bufferSize);
     }
 
+    void CheckIn(EventBuffer<E> *ptr) {
+        {
+            std::lock_guard<std::mutex> hold(mutex);
+            buffers.emplace_back(std::unique_ptr<EventBuffer<E>>(ptr));
+            --outstandingCount;
+        }
+        bufferAvailableCondition.notify_one();
+    }
+
   public:
-    explicit EventBufferPool(std::size_t size, std::size_t initialCount = 0)
-        : bufferSize(size) {
+    // size: capacity (number of events) of each buffer
+    // initialCount: number of buffers to allocate up front
+    // maxCount: maximum number of buffers (0 for no limit)
+    explicit EventBufferPool(
+        std::size_t size, std::size_t initialCount = 0,
+        std::size_t maxCount = 0,
+        EventBufferPoolPolicy policy = EventBufferPoolPolicy::Block)
+        : bufferSize(size), maxCount(maxCount), policy(policy) {
+        if (maxCount > 0 && initialCount > maxCount) {
+            throw std::invalid_argument(
+                "EventBufferPool initial count exceeds max count");
+        }
         buffers.reserve(initialCount);
         for (std::size_t i = 0; i < initialCount; ++i) {
             buffers.emplace_back(MakeBuffer());
         }
+        stats.allocationCount = initialCount;
+    }
+
+    // Arena mode: as many buffers as fit in arena (up to maxCount) are
+    // allocated up front from its contiguous memory. Arena is any type with
+    // GetData() and GetSize(), such as MemoryArena (which is prefaulted), and
+    // is kept alive by the pool. Further buffers, up to maxCount, are
+    // allocated on demand.
+    template <typename Arena>
+    EventBufferPool(std::size_t size, std::shared_ptr<Arena> arena,
+                    std::size_t maxCount = 0,
+                    EventBufferPoolPolicy policy = EventBufferPoolPolicy::Block)
+        : bufferSize(size), maxCount(maxCount), policy(policy), arena(arena) {
+        std::size_t const stride = GetArenaStride(size);
+        std::size_t count = arena->GetSize() / stride;
+        if (maxCount > 0) {
+            count = std::min(count, maxCount);
+        }
+        if (count == 0) {
+            throw std::invalid_argument(
+                "EventBufferPool arena is too small for a buffer");
+        }
+        char *base = static_cast<char *>(arena->GetData());
+        buffers.reserve(count);
+        for (std::size_t i = 0; i < count; ++i) {
+            buffers.emplace_back(std::make_unique<EventBuffer<E>>(
+                size, reinterpret_cast<E *>(base + i * stride)));
+        }
+        arenaBufferCount = count;
+        stats.allocationCount = count;
+    }
+
+    // Bytes of arena used by each buffer of the given capacity. Buffers start
+    // on cache line boundaries (if the arena does).
+    static std::size_t GetArenaStride(std::size_t size) noexcept {
+        std::size_t const alignment = 64;
+        return (size * sizeof(E) + alignment - 1) / alignment * alignment;
+    }
+
+    std::size_t GetBufferSize() const noexcept { return bufferSize; }
+
+    // Number of buffers allocated from the arena (0 unless in arena mode)
+    std::size_t GetArenaBufferCount() const noexcept {
+        return arenaBufferCount;
+    }
+
+    EventBufferPoolStats GetStats() {
+        std::lock_guard<std::mutex> hold(mutex);
+        return stats;
+    }
+
+    // Make current and future CheckOut() calls return null instead of
+    // blocking, so that a producer waiting for buffers can stop when its
+    // consumer has failed (and will not check in any more buffers).
+    void Cancel() {
+        {
+            std::lock_guard<std::mutex> hold(mutex);
+            cancelled = true;
+        }
+        bufferAvailableCondition.notify_all();
     }
 
     // Obtain a buffer for use. Returns a shared pointer which automatically
     // checks in the buffer when the calling code is finished with it.
+    // If maxCount buffers are already checked out, either blocks or returns
+    // null, depending on the policy. Returns null once Cancel() has been
+    // called.
     // Note: all checked out buffers must be released before the pool is
     // destroyed.
     std::shared_ptr<EventBuffer<E>> CheckOut() {
         std::unique_ptr<EventBuffer<E>> uptr;
 
         {
-            std::lock_guard<std::mutex> hold(mutex);
+            std::unique_lock<std::mutex> lock(mutex);
+            if (cancelled) {
+                return {};
+            }
+            if (maxCount > 0 && outstandingCount >= maxCount) {
+                if (policy == EventBufferPoolPolicy::Drop) {
+                    ++stats.dropCount;
+                    return {};
+                }
+                ++stats.blockCount;
+                while (outstandingCount >= maxCount && !cancelled) {
+                    bufferAvailableCondition.wait(lock);
+                }
+                if (cancelled) {
+                    return {};
+                }
+            }
+
             if (!buffers.empty()) {
                 uptr = std::move(buffers.back());
                 buffers.pop_back();
+            } else {
+                ++stats.allocationCount;
+            }
+            ++outstandingCount;
+            if (outstandingCount > stats.peakOutstandingCount) {
+                stats.peakOutstandingCount = outstandingCount;
             }
         }
 
         if (!uptr) {
-            uptr = MakeBuffer();
+            try {
+                uptr = MakeBuffer();
+            } catch (...) {
+                {
+                    std::lock_guard<std::mutex> hold(mutex);
+                    --stats.allocationCount;
+                    --outstandingCount;
+                }
+                bufferAvailableCondition.notify_one();
+                throw;
+            }
         }
 
         uptr->SetSize(0);
@@ -72,9 +222,7 @@ template <typename E> class EventBufferPool {
         return {uptr.release(), [this](auto ptr) {
                     if (!ptr)
                         return;
-
-                    std::lock_guard<std::mutex> hold(mutex);
-                    buffers.emplace_back(std::unique_ptr<EventBuffer<E>>(ptr));
+                    CheckIn(ptr);
                 }};
     }
 };
@@ -121,3 +269,127 @@ template <typename E> class EventStream {
         return ret;
     }
 };
+
+// A bounded queue of EventBuffer<E> for exactly one producer thread and one
+// consumer thread, with the same interface as EventStream.
+//
+// Handoff of a buffer does not take a lock: the producer and consumer each
+// own one index into a ring of slots. A thread that finds the ring full
+// (producer) or empty (consumer) spins briefly and then sleeps on a condition
+// variable; the other side only takes the mutex to wake it if it is known to
+// be sleeping.
+//
+// Unlike EventStream, Send() blocks while the ring is full.
+template <typename E> class SPSCEventStream {
+    // Number of polls of the other thread's index before sleeping
+    static constexpr int SpinCount = 1024;
+
+    std::size_t const capacity;
+    std::unique_ptr<std::shared_ptr<EventBuffer<E>>[]> slots;
+
+    // Written only before the terminating null is published
+    std::exception_ptr exception;
+
+    // Next slot to read (written by consumer only), and next slot to write
+    // (written by producer only). Padded so that they are on separate cache
+    // lines, avoiding false sharing. (Padding is used rather than alignas(),
+    // because over-aligned types are not supported by operator new and
+    // std::make_shared before C++17.)
+    static constexpr std::size_t CacheLineSize = 64;
+    char padding0[CacheLineSize];
+    std::atomic<std::size_t> head;
+    char padding1[CacheLineSize - sizeof(std::atomic<std::size_t>)];
+    std::atomic<std::size_t> tail;
+    char padding2[CacheLineSize - sizeof(std::atomic<std::size_t>)];
+
+    std::atomic<bool> consumerSleeping;
+    std::atomic<bool> producerSleeping;
+    std::mutex mutex;
+    std::condition_variable notEmptyCondition;
+    std::condition_variable notFullCondition;
+
+    void Publish(std::shared_ptr<EventBuffer<E>> buffer) {
+        std::size_t const t = tail.load(std::memory_order_relaxed);
+        auto isFull = [this, t] {
+            return t - head.load(std::memory_order_seq_cst) == capacity;
+        };
+        if (isFull()) {
+            for (int i = 0; i < SpinCount && isFull(); ++i) {
+                std::this_thread::yield();
+            }
+            if (isFull()) {
+                std::unique_lock<std::mutex> lock(mutex);
+                producerSleeping.store(true, std::memory_order_seq_cst);
+                while (isFull()) {
+                    notFullCondition.wait(lock);
+                }
+                producerSleeping.store(false, std::memory_order_relaxed);
+            }
+        }
+
+        slots[t % capacity] = std::move(buffer);
+        tail.store(t + 1, std::memory_order_seq_cst);
+
+        if (consumerSleeping.load(std::memory_order_seq_cst)) {
+            std::lock_guard<std::mutex> hold(mutex);
+            notEmptyCondition.notify_one();
+        }
+    }
+
+  public:
+    explicit SPSCEventStream(std::size_t capacity = 1024)
+        : capacity(capacity),
+          slots(new std::shared_ptr<EventBuffer<E>>[capacity]), head(0),
+          tail(0), consumerSleeping(false), producerSleeping(false) {
+        if (capacity == 0) {
+            throw std::invalid_argument(
+                "SPSCEventStream capacity must be positive");
+        }
+    }
+
+    // Sending a null will terminate the stream
+    void Send(std::shared_ptr<EventBuffer<E>> buffer) {
+        Publish(std::move(buffer));
+    }
+
+    void SendException(std::exception_ptr e) {
+        exception = e;
+        Publish({});
+    }
+
+    // A null shared pointer return value indicates that the stream has been
+    // terminated. Subsequent calls will block forever.
+    // Throws if upstream sent an exception.
+    std::shared_ptr<EventBuffer<E>> ReceiveBlocking() {
+        std::size_t const h = head.load(std::memory_order_relaxed);
+        auto isEmpty = [this, h] {
+            return tail.load(std::memory_order_seq_cst) == h;
+        };
+        if (isEmpty()) {
+            for (int i = 0; i < SpinCount && isEmpty(); ++i) {
+                std::this_thread::yield();
+            }
+            if (isEmpty()) {
+                std::unique_lock<std::mutex> lock(mutex);
+                consumerSleeping.store(true, std::memory_order_seq_cst);
+                while (isEmpty()) {
+                    notEmptyCondition.wait(lock);
+                }
+                consumerSleeping.store(false, std::memory_order_relaxed);
+            }
+        }
+
+        auto ret = std::move(slots[h % capacity]);
+        head.store(h + 1, std::memory_order_seq_cst);
+
+        if (producerSleeping.load(std::memory_order_seq_cst)) {
+            std::lock_guard<std::mutex> hold(mutex);
+            notFullCondition.notify_one();
+        }
+
+        if (!ret && exception) {
+            std::rethrow_exception(exception);
+        }
+        return ret;
+    }
+};
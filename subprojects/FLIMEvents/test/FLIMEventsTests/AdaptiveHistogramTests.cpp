@@ -0,0 +1,201 @@
+#include "FLIMEvents/AdaptiveHistogram.hpp"
+#include "FLIMEvents/Histogram.hpp"
+#include <catch2/catch.hpp>
+
+#include <cstdint>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+// Records exact copies of the histograms received
+class AdaptiveHistogramRecorder : public AdaptiveHistogramProcessor {
+  public:
+    std::vector<std::vector<uint32_t>> frames;
+    std::vector<uint32_t> finalHistogram;
+    bool finalIsComplete = false;
+    unsigned finishCount = 0;
+
+    void HandleError(std::string const &message) override {}
+
+    void HandleFrame(AdaptiveHistogram const &histogram) override {
+        frames.emplace_back(histogram.GetNumberOfElements());
+        histogram.CopyTo(frames.back().data());
+    }
+
+    void HandleFinish(AdaptiveHistogram &&histogram,
+                      bool isCompleteFrame) override {
+        finalHistogram.resize(histogram.GetNumberOfElements());
+        histogram.CopyTo(finalHistogram.data());
+        finalIsComplete = isCompleteFrame;
+        ++finishCount;
+    }
+};
+
+} // namespace
+
+TEST_CASE("AdaptiveHistogram counts exactly beyond 8 bits",
+          "[AdaptiveHistogram]") {
+    // 0 time bits and 5 x 27 pixels, so that the last block is partial
+    AdaptiveHistogram hist(0, 12, false, 5, 27);
+    REQUIRE(hist.GetNumberOfElements() == 135);
+    hist.Clear();
+    REQUIRE(hist.GetNumberOfPromotedBlocks() == 0);
+    REQUIRE(hist.GetMaxCount() == 0);
+
+    for (unsigned i = 0; i < 255; ++i) {
+        REQUIRE(hist.IncrementAt(130));
+    }
+    hist.IncrementAt(70);
+    REQUIRE(hist.GetNumberOfPromotedBlocks() == 0);
+    REQUIRE(hist.GetAt(130) == 255);
+
+    // Overflowing 8 bits promotes the (partial) last block only
+    REQUIRE(hist.IncrementAt(130));
+    REQUIRE(hist.GetNumberOfPromotedBlocks() == 1);
+    REQUIRE(hist.GetAt(130) == 256);
+    REQUIRE(hist.GetAt(70) == 1);
+    REQUIRE(hist.GetAt(129) == 0);
+
+    for (unsigned i = 0; i < 70000; ++i) {
+        hist.IncrementAt(130);
+    }
+    REQUIRE(hist.GetAt(130) == 70256);
+    REQUIRE(hist.GetMaxCount() == 70256);
+    REQUIRE(hist.AddAt(70, 254));
+    REQUIRE(hist.GetNumberOfPromotedBlocks() == 1);
+    REQUIRE(hist.AddAt(70, 200));
+    REQUIRE(hist.GetNumberOfPromotedBlocks() == 2);
+    REQUIRE(hist.GetAt(70) == 455);
+    REQUIRE(hist.GetAt(130) == 70256);
+
+    SECTION("Copy clamps to destination type") {
+        std::vector<uint16_t> narrow(135);
+        hist.CopyTo(narrow.data());
+        CHECK(narrow[130] == 65535);
+        CHECK(narrow[0] == 0);
+
+        std::vector<uint32_t> wide(135);
+        hist.CopyTo(wide.data());
+        CHECK(wide[130] == 70256);
+    }
+
+    SECTION("Addition saturates at 32 bits") {
+        CHECK_FALSE(hist.AddAt(130, 0xffffffffu));
+        CHECK(hist.GetAt(130) == 0xffffffffu);
+        CHECK_FALSE(hist.IncrementAt(130));
+        CHECK(hist.GetAt(130) == 0xffffffffu);
+    }
+
+    SECTION("Clear returns to 8 bits") {
+        hist.Clear();
+        CHECK(hist.GetNumberOfPromotedBlocks() == 0);
+        CHECK(hist.GetAt(130) == 0);
+        CHECK(hist.GetMaxCount() == 0);
+    }
+}
+
+TEST_CASE("AdaptiveHistogram promotes blocks across chunks",
+          "[AdaptiveHistogram]") {
+    // 157 blocks, more than fit in 2 chunks
+    AdaptiveHistogram hist(0, 12, false, 100, 100);
+    hist.Clear();
+    for (std::size_t i = 0; i < hist.GetNumberOfElements(); ++i) {
+        hist.AddAt(i, 100);
+    }
+    REQUIRE(hist.GetNumberOfPromotedBlocks() == 0);
+    // Promote in reverse order, so that promoted blocks are not in order
+    for (std::size_t i = hist.GetNumberOfElements(); i-- > 0;) {
+        hist.AddAt(i, uint32_t(200 + i));
+    }
+    REQUIRE(hist.GetNumberOfPromotedBlocks() == 157);
+    for (std::size_t i = 0; i < hist.GetNumberOfElements(); ++i) {
+        REQUIRE(hist.GetAt(i) == 300 + i);
+    }
+    CHECK(hist.GetMaxCount() == 300 + 9999);
+}
+
+TEST_CASE("AdaptiveHistogram indexes like pixel-major Histogram",
+          "[AdaptiveHistogram]") {
+    auto reverse = GENERATE(false, true);
+    AdaptiveHistogram adaptive(8, 12, reverse, 7, 5);
+    Histogram<uint32_t> reference(8, 12, reverse, 7, 5);
+    adaptive.Clear();
+    reference.Clear();
+
+    // Concentrate photons on a few pixels so that some blocks get promoted
+    std::mt19937 rng(7);
+    std::uniform_int_distribution<uint16_t> x(0, 1);
+    std::uniform_int_distribution<uint16_t> y(0, 4);
+    std::uniform_int_distribution<uint16_t> microtime(0, 1023);
+    for (unsigned i = 0; i < 200000; ++i) {
+        auto const t = microtime(rng);
+        auto const xx = x(rng);
+        auto const yy = y(rng);
+        adaptive.IncrementAt(adaptive.GetIndex(t, xx, yy));
+        reference.Increment(t, xx, yy);
+    }
+    REQUIRE(adaptive.GetNumberOfPromotedBlocks() > 0);
+
+    std::vector<uint32_t> copied(adaptive.GetNumberOfElements());
+    adaptive.CopyTo(copied.data());
+    std::vector<uint32_t> expected(
+        reference.Get(), reference.Get() + reference.GetNumberOfElements());
+    CHECK(copied == expected);
+}
+
+TEST_CASE("AdaptiveCumulativeHistogrammer matches CumulativeHistogrammer",
+          "[AdaptiveHistogram]") {
+    auto const width = 3u;
+    auto const height = 2u;
+    AdaptiveHistogram adaptive(4, 12, true, width, height);
+    adaptive.Clear();
+    auto recorder = std::make_shared<AdaptiveHistogramRecorder>();
+    AdaptiveCumulativeHistogrammer histogrammer(std::move(adaptive),
+                                                recorder);
+
+    // Enough photons per bin to overflow 8 bits (and 16 bits in bin 0)
+    std::mt19937 rng(11);
+    std::uniform_int_distribution<uint16_t> x(0, width - 1);
+    std::uniform_int_distribution<uint16_t> y(0, height - 1);
+    std::uniform_int_distribution<uint16_t> microtime(0, 4095);
+    std::vector<PixelPhotonEvent> batch(4000);
+    std::vector<uint32_t> expected(16 * width * height);
+    std::vector<uint32_t> completed;
+    for (unsigned f = 0; f < 4; ++f) {
+        histogrammer.HandleBeginFrame();
+        for (auto &e : batch) {
+            e.frame = f;
+            e.x = x(rng);
+            e.y = y(rng);
+            e.microtime = microtime(rng);
+            e.route = 0;
+            expected[(e.y * width + e.x) * 16 + 15 - (e.microtime >> 8)] +=
+                1;
+        }
+        histogrammer.HandlePixelPhotons(batch.data(), batch.size());
+
+        PixelPhotonEvent hot{};
+        hot.frame = f;
+        hot.microtime = 4095; // Reversed to bin 0
+        for (unsigned i = 0; i < 25000; ++i) {
+            histogrammer.HandlePixelPhoton(hot);
+        }
+        expected[0] += 25000;
+
+        if (f < 3) {
+            histogrammer.HandleEndFrame();
+            completed = expected;
+            REQUIRE(recorder->frames.back() == completed);
+        }
+    }
+    histogrammer.HandleFinish();
+
+    REQUIRE(recorder->finishCount == 1);
+    CHECK(recorder->finalIsComplete);
+    CHECK(recorder->frames.size() == 3);
+    CHECK(recorder->finalHistogram == completed);
+    CHECK(recorder->finalHistogram[0] > 65535);
+}
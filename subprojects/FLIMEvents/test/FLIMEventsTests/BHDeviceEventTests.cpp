@@ -1,6 +1,12 @@
+#define CATCH_CONFIG_ENABLE_BENCHMARKING
 #include "FLIMEvents/BHDeviceEvent.hpp"
+#include "BHEventTestUtils.hpp"
 #include <catch2/catch.hpp>
 
+#include <memory>
+#include <random>
+#include <vector>
+
 TEST_CASE("ADCValue", "[BHSPCEvent]") {
     union {
         BHSPCEvent event;
@@ -167,3 +173,245 @@ TEST_CASE("MacroTimeOverflowCount", "[BHSPCEvent]") {
     REQUIRE(u.event.GetMultipleMacroTimeOverflowCount() == 134217728);
     u.bytes[3] = 0;
 }
+
+namespace {
+
+// Same records, but decoded without the classification pre-pass (which
+// BHEventDecoder uses only for BHSPCEvent itself)
+struct UnclassifiedBHSPCEvent : BHSPCEvent {};
+
+class CountingProcessor : public DecodedEventProcessor {
+  public:
+    std::size_t photonCount = 0;
+
+    void HandleTimestamp(DecodedEvent const &event) override {}
+
+    void HandleValidPhoton(ValidPhotonEvent const &event) override {
+        ++photonCount;
+    }
+
+    void HandleValidPhotons(ValidPhotonEvent const *events,
+                            std::size_t count) override {
+        photonCount += count;
+    }
+
+    void HandleInvalidPhoton(InvalidPhotonEvent const &event) override {}
+    void HandleMarker(MarkerEvent const &event) override {}
+    void HandleDataLost(DataLostEvent const &event) override {}
+    void HandleError(std::string const &message) override {}
+    void HandleFinish() override {}
+};
+
+// For benchmarks, each run needs a fresh decoder: decoding the same stream
+// again would go back in macro-time, stopping the decoder with an error.
+template <typename E> struct DecoderAndCounter {
+    std::shared_ptr<CountingProcessor> counter =
+        std::make_shared<CountingProcessor>();
+    BHEventDecoder<E> decoder{counter};
+};
+
+template <typename E>
+std::vector<std::unique_ptr<DecoderAndCounter<E>>> MakeDecoders(int runs) {
+    std::vector<std::unique_ptr<DecoderAndCounter<E>>> result;
+    for (int i = 0; i < runs; ++i) {
+        result.push_back(std::make_unique<DecoderAndCounter<E>>());
+    }
+    return result;
+}
+
+} // namespace
+
+TEST_CASE("Batch decoding matches per-record decoding", "[BHEventDecoder]") {
+    auto events = MakeEventStream(10000);
+    bool expectError = false;
+    SECTION("Normal stream") {}
+    SECTION("Stream with gap and decreasing macro-time") {
+        events[5000].bytes[3] |= GAP;
+        events[7000] = MakeEvent(0, 4095, 0, 0);
+        events[7001] = MakeEvent(0, 0, 0, 0);
+        expectError = true;
+    }
+
+    auto perRecord = std::make_shared<RecordingProcessor>();
+    BHSPCEventDecoder perRecordDecoder(perRecord);
+    for (auto const &e : events) {
+        perRecordDecoder.HandleDeviceEvent(reinterpret_cast<char const *>(&e));
+    }
+    perRecordDecoder.HandleFinish();
+
+    auto batched = std::make_shared<RecordingProcessor>();
+    BHSPCEventDecoder batchDecoder(batched);
+    batchDecoder.HandleDeviceEvents(
+        reinterpret_cast<char const *>(events.data()), 3333);
+    batchDecoder.HandleDeviceEvents(
+        reinterpret_cast<char const *>(events.data() + 3333),
+        events.size() - 3333);
+    batchDecoder.HandleFinish();
+
+    REQUIRE(batched->events.size() > events.size() / 2);
+    REQUIRE(batched->events == perRecord->events);
+    auto const &last = batched->events.back();
+    REQUIRE(last == (expectError ? "E Decreasing macro-time encountered" : "F"));
+}
+
+TEST_CASE("Decoding throughput", "[BHEventDecoder][!benchmark]") {
+    auto const events = MakeEventStream(48 * 1024);
+    auto const data = reinterpret_cast<char const *>(events.data());
+
+    BENCHMARK_ADVANCED("48k events, per-record HandleDeviceEvent")
+    (Catch::Benchmark::Chronometer meter) {
+        auto decoders = MakeDecoders<BHSPCEvent>(meter.runs());
+        meter.measure([&](int run) {
+            auto &d = *decoders[run];
+            for (std::size_t i = 0; i < events.size(); ++i) {
+                d.decoder.HandleDeviceEvent(data + i * sizeof(BHSPCEvent));
+            }
+            return d.counter->photonCount;
+        });
+    };
+
+    BENCHMARK_ADVANCED("48k events, batch HandleDeviceEvents")
+    (Catch::Benchmark::Chronometer meter) {
+        auto decoders = MakeDecoders<BHSPCEvent>(meter.runs());
+        meter.measure([&](int run) {
+            auto &d = *decoders[run];
+            d.decoder.HandleDeviceEvents(data, events.size());
+            return d.counter->photonCount;
+        });
+    };
+
+    BENCHMARK_ADVANCED("48k events, batch without classification pre-pass")
+    (Catch::Benchmark::Chronometer meter) {
+        auto decoders = MakeDecoders<UnclassifiedBHSPCEvent>(meter.runs());
+        meter.measure([&](int run) {
+            auto &d = *decoders[run];
+            d.decoder.HandleDeviceEvents(data, events.size());
+            return d.counter->photonCount;
+        });
+    };
+}
+
+namespace {
+
+void RequireLanesEqual(BHSPCEventLanes const &a, BHSPCEventLanes const &b) {
+    REQUIRE(a.macrotime == b.macrotime);
+    REQUIRE(a.adcValue == b.adcValue);
+    REQUIRE(a.route == b.route);
+    REQUIRE(a.flags == b.flags);
+    REQUIRE(a.macrotimeBase == b.macrotimeBase);
+}
+
+} // namespace
+
+TEST_CASE("Classification kernels match scalar", "[BHSPCEventLanes]") {
+    std::vector<BHSPCEvent> events;
+    SECTION("Arbitrary bit patterns") {
+        std::mt19937 rng(1);
+        events.resize(1003); // Not a multiple of the vector width
+        for (auto &e : events) {
+            uint32_t r = rng();
+            std::memcpy(e.bytes, &r, 4);
+        }
+    }
+    SECTION("Plausible event stream") { events = MakeEventStream(1003); }
+
+    std::size_t const n = events.size();
+    uint64_t const initialBase = 12345;
+    BHSPCEventLanes scalar;
+    scalar.Resize(n);
+    uint64_t scalarBase = ClassifyBHSPCEventsScalar(events.data(), 0, n,
+                                                    initialBase, scalar);
+
+    // Spot-check the scalar kernel against the record accessors
+    for (std::size_t i = 0; i < n; ++i) {
+        REQUIRE(scalar.macrotime[i] == events[i].GetMacroTime());
+        REQUIRE(scalar.adcValue[i] == events[i].GetADCValue());
+        REQUIRE(scalar.route[i] == events[i].GetRoutingSignals());
+        REQUIRE(bool(scalar.flags[i] & BHSPCEventFlagMarker) ==
+                events[i].GetMarkerFlag());
+        REQUIRE(bool(scalar.flags[i] & BHSPCEventFlagGap) ==
+                events[i].GetGapFlag());
+        REQUIRE(bool(scalar.flags[i] & BHSPCEventFlagMacroTimeOverflow) ==
+                events[i].GetMacroTimeOverflowFlag());
+        REQUIRE(bool(scalar.flags[i] & BHSPCEventFlagInvalid) ==
+                events[i].GetInvalidFlag());
+    }
+
+    uint64_t dispatchedBase = initialBase;
+    BHSPCEventLanes dispatched;
+    ClassifyBHSPCEvents(events.data(), n, dispatchedBase, dispatched);
+    REQUIRE(dispatchedBase == scalarBase);
+    RequireLanesEqual(dispatched, scalar);
+
+#ifdef FLIMEVENTS_X86_64
+    BHSPCEventLanes sse2;
+    sse2.Resize(n);
+    REQUIRE(ClassifyBHSPCEventsSSE2(events.data(), 0, n, initialBase, sse2) ==
+            scalarBase);
+    RequireLanesEqual(sse2, scalar);
+
+    if (CPUFeatures::Get().avx2) {
+        BHSPCEventLanes avx2;
+        avx2.Resize(n);
+        REQUIRE(ClassifyBHSPCEventsAVX2(events.data(), 0, n, initialBase,
+                                        avx2) == scalarBase);
+        RequireLanesEqual(avx2, scalar);
+    }
+#endif
+}
+
+TEST_CASE("Classified macro-times match decoder", "[BHSPCEventLanes]") {
+    auto events = MakeEventStream(5000);
+    uint64_t base = 0;
+    BHSPCEventLanes lanes;
+    ClassifyBHSPCEvents(events.data(), events.size(), base, lanes);
+
+    std::vector<std::string> expected;
+    for (std::size_t i = 0; i < events.size(); ++i) {
+        uint8_t f = lanes.flags[i];
+        if (events[i].IsMultipleMacroTimeOverflow()) {
+            expected.push_back("T " + std::to_string(lanes.macrotimeBase[i]));
+        } else if (!(f & (BHSPCEventFlagMarker | BHSPCEventFlagInvalid))) {
+            expected.push_back(
+                "P " +
+                std::to_string(lanes.macrotimeBase[i] + lanes.macrotime[i]) +
+                ' ' + std::to_string(lanes.adcValue[i]) + ' ' +
+                std::to_string(lanes.route[i]));
+        }
+    }
+
+    auto recorder = std::make_shared<RecordingProcessor>();
+    BHSPCEventDecoder decoder(recorder);
+    decoder.HandleDeviceEvents(reinterpret_cast<char const *>(events.data()),
+                               events.size());
+    std::vector<std::string> decoded;
+    for (auto const &e : recorder->events) {
+        if (e[0] == 'T' || e[0] == 'P') {
+            decoded.push_back(e);
+        }
+    }
+    REQUIRE(decoded == expected);
+}
+
+TEST_CASE("Classification throughput", "[BHSPCEventLanes][!benchmark]") {
+    auto const events = MakeEventStream(48 * 1024);
+    std::size_t const n = events.size();
+    BHSPCEventLanes lanes;
+    lanes.Resize(n);
+
+    BENCHMARK("48k events, scalar") {
+        return ClassifyBHSPCEventsScalar(events.data(), 0, n, 0, lanes);
+    };
+
+#ifdef FLIMEVENTS_X86_64
+    BENCHMARK("48k events, SSE2") {
+        return ClassifyBHSPCEventsSSE2(events.data(), 0, n, 0, lanes);
+    };
+
+    if (CPUFeatures::Get().avx2) {
+        BENCHMARK("48k events, AVX2") {
+            return ClassifyBHSPCEventsAVX2(events.data(), 0, n, 0, lanes);
+        };
+    }
+#endif
+}
@@ -0,0 +1,100 @@
+#pragma once
+
+// Helpers shared by the tests of Becker & Hickl event decoding
+
+#include "FLIMEvents/BHDeviceEvent.hpp"
+#include "FLIMEvents/DecodedEvent.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <random>
+#include <string>
+#include <vector>
+
+// Flag bits in the last byte of a BHSPCEvent
+uint8_t const INVALID = 1 << 7;
+uint8_t const MTOV = 1 << 6;
+uint8_t const GAP = 1 << 5;
+uint8_t const MARK = 1 << 4;
+
+inline BHSPCEvent MakeEvent(uint8_t flags, uint16_t macrotime, uint8_t route,
+                            uint16_t adc) {
+    BHSPCEvent e;
+    e.bytes[0] = macrotime & 0xff;
+    e.bytes[1] = ((macrotime >> 8) & 0x0f) | ((route & 0x0f) << 4);
+    e.bytes[2] = adc & 0xff;
+    e.bytes[3] = ((adc >> 8) & 0x0f) | flags;
+    return e;
+}
+
+// Plausible event stream: mostly photons, with some markers, invalid photons,
+// gaps, and single and multiple macro-time overflows.
+inline std::vector<BHSPCEvent> MakeEventStream(std::size_t count,
+                                               unsigned seed = 42) {
+    std::mt19937 rng(seed);
+    std::uniform_int_distribution<unsigned> dist(0, 999);
+    std::vector<BHSPCEvent> events;
+    events.reserve(count);
+    uint16_t macrotime = 0;
+    while (events.size() < count) {
+        unsigned r = dist(rng);
+        if (r == 0) {
+            // Multiple overflow record (count in lower 28 bits)
+            events.push_back(MakeEvent(INVALID | MTOV, 3, 0, 0));
+            macrotime = 0;
+            continue;
+        }
+        uint8_t flags = 0;
+        unsigned step = r % 8;
+        if (macrotime + step >= 4096) {
+            flags |= MTOV;
+        }
+        macrotime = (macrotime + step) % 4096;
+        if (r < 5) {
+            flags |= INVALID | MARK;
+        } else if (r < 10) {
+            flags |= INVALID;
+        } else if (r < 12) {
+            flags |= GAP;
+        }
+        events.push_back(MakeEvent(flags, macrotime, r % 16, r * 4));
+    }
+    return events;
+}
+
+// Records all events as text, for comparison
+class RecordingProcessor : public DecodedEventProcessor {
+  public:
+    std::vector<std::string> events;
+
+    void HandleTimestamp(DecodedEvent const &event) override {
+        events.push_back("T " + std::to_string(event.macrotime));
+    }
+
+    void HandleValidPhoton(ValidPhotonEvent const &event) override {
+        events.push_back("P " + std::to_string(event.macrotime) + ' ' +
+                         std::to_string(event.microtime) + ' ' +
+                         std::to_string(event.route));
+    }
+
+    void HandleInvalidPhoton(InvalidPhotonEvent const &event) override {
+        events.push_back("I " + std::to_string(event.macrotime) + ' ' +
+                         std::to_string(event.microtime) + ' ' +
+                         std::to_string(event.route));
+    }
+
+    void HandleMarker(MarkerEvent const &event) override {
+        events.push_back("M " + std::to_string(event.macrotime) + ' ' +
+                         std::to_string(event.bits));
+    }
+
+    void HandleDataLost(DataLostEvent const &event) override {
+        events.push_back("L " + std::to_string(event.macrotime));
+    }
+
+    void HandleError(std::string const &message) override {
+        events.push_back("E " + message);
+    }
+
+    void HandleFinish() override { events.push_back("F"); }
+};
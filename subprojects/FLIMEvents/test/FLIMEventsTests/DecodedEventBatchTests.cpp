@@ -0,0 +1,101 @@
+#include "FLIMEvents/DecodedEventBatch.hpp"
+#include "BHEventTestUtils.hpp"
+#include <catch2/catch.hpp>
+
+namespace {
+
+class BatchCollector : public DecodedBatchProcessor {
+  public:
+    std::vector<DecodedEventBatch> batches;
+    bool finished = false;
+
+    void HandleDecodedEventBatch(DecodedEventBatch const &batch) override {
+        batches.push_back(batch);
+    }
+
+    void HandleError(std::string const &message) override {}
+
+    void HandleFinish() override { finished = true; }
+};
+
+// Send a fixed sequence of events, with runs of photons
+void SendEvents(DecodedEventProcessor &proc) {
+    ValidPhotonEvent photons[4];
+    for (int i = 0; i < 4; ++i) {
+        photons[i].macrotime = 10 + i;
+        photons[i].microtime = 100 + i;
+        photons[i].route = i;
+    }
+    MarkerEvent marker;
+    marker.macrotime = 20;
+    marker.bits = 2;
+    InvalidPhotonEvent invalid;
+    invalid.macrotime = 21;
+    invalid.microtime = 7;
+    invalid.route = 1;
+    DataLostEvent lost;
+    lost.macrotime = 22;
+    DecodedEvent timestamp;
+    timestamp.macrotime = 4096;
+
+    proc.HandleMarker(marker);
+    proc.HandleValidPhotons(photons, 4);
+    proc.HandleMarker(marker);
+    proc.HandleInvalidPhoton(invalid);
+    proc.HandleValidPhoton(photons[0]);
+    proc.HandleTimestamp(timestamp);
+    proc.HandleTimestamp(timestamp);
+    proc.HandleValidPhotons(photons, 3);
+    proc.HandleDataLost(lost);
+    proc.HandleFinish();
+}
+
+} // namespace
+
+TEST_CASE("Batch columns and sparse events", "[DecodedEventBatch]") {
+    auto collector = std::make_shared<BatchCollector>();
+    DecodedEventToBatchAdapter batcher(1000, collector);
+    SendEvents(batcher);
+
+    REQUIRE(collector->finished);
+    // Batches are sent on each timestamp, and on finish
+    REQUIRE(collector->batches.size() == 3);
+
+    auto const &first = collector->batches[0];
+    REQUIRE(first.GetNumberOfPhotons() == 5);
+    REQUIRE(first.macrotime[3] == 13);
+    REQUIRE(first.microtime[3] == 103);
+    REQUIRE(first.route[3] == 3);
+    REQUIRE(first.others.size() == 4);
+    REQUIRE(first.others[0].type ==
+            DecodedEventBatch::OtherEventType::Marker);
+    REQUIRE(first.others[0].photonIndex == 0);
+    REQUIRE(first.others[1].photonIndex == 4);
+    REQUIRE(first.others[2].type ==
+            DecodedEventBatch::OtherEventType::InvalidPhoton);
+    REQUIRE(first.others[3].type ==
+            DecodedEventBatch::OtherEventType::Timestamp);
+    REQUIRE(first.others[3].photonIndex == 5);
+
+    REQUIRE(collector->batches[1].GetNumberOfPhotons() == 0);
+    REQUIRE(collector->batches[1].others.size() == 1);
+
+    auto const &last = collector->batches[2];
+    REQUIRE(last.GetNumberOfPhotons() == 3);
+    REQUIRE(last.others.size() == 1);
+    REQUIRE(last.others[0].photonIndex == 3);
+}
+
+TEST_CASE("Round trip through batches preserves events",
+          "[DecodedEventBatch]") {
+    RecordingProcessor direct;
+    SendEvents(direct);
+
+    std::size_t maxPhotons = GENERATE(1, 2, 3, 1000);
+    auto recorder = std::make_shared<RecordingProcessor>();
+    DecodedEventToBatchAdapter batcher(
+        maxPhotons, std::make_shared<DecodedBatchToEventAdapter>(recorder));
+    SendEvents(batcher);
+
+    REQUIRE(recorder->events == direct.events);
+}
@@ -1,3 +1,4 @@
 #define CATCH_CONFIG_MAIN
 #define CATCH_CONFIG_WINDOWS_CRTDBG
+#define CATCH_CONFIG_ENABLE_BENCHMARKING
 #include <catch2/catch.hpp>
@@ -0,0 +1,90 @@
+#pragma once
+
+// Helpers shared by the tests of histogram-producing processors
+
+#include "FLIMEvents/Histogram.hpp"
+#include <catch2/catch.hpp>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <random>
+#include <string>
+#include <vector>
+
+// Records copies of the histograms received
+template <typename T>
+class HistogramRecorder : public HistogramProcessor<T> {
+  public:
+    std::vector<std::vector<T>> frames;
+    std::vector<T> finalHistogram;
+    bool finalIsComplete = false;
+    std::vector<std::string> errors;
+    unsigned finishCount = 0;
+    unsigned sparseFrameCount = 0;
+
+    void HandleError(std::string const &message) override {
+        errors.emplace_back(message);
+    }
+
+    void HandleFrame(Histogram<T> const &histogram) override {
+        frames.emplace_back(histogram.Get(),
+                            histogram.Get() + histogram.GetNumberOfElements());
+    }
+
+    void HandleSparseFrame(Histogram<T> const &histogram,
+                           SparseHistogram<T> const &sparse) override {
+        // Check that the sparse form matches
+        Histogram<T> dense(histogram.GetTimeBits(), 16, false,
+                           histogram.GetWidth(), histogram.GetHeight());
+        sparse.ToDense(dense);
+        REQUIRE(std::equal(dense.Get(),
+                           dense.Get() + dense.GetNumberOfElements(),
+                           histogram.Get()));
+        REQUIRE(std::is_sorted(sparse.GetIndices().begin(),
+                               sparse.GetIndices().end()));
+        ++sparseFrameCount;
+        HandleFrame(histogram);
+    }
+
+    void HandleFinish(Histogram<T> &&histogram,
+                      bool isCompleteFrame) override {
+        finalHistogram.assign(histogram.Get(),
+                              histogram.Get() +
+                                  histogram.GetNumberOfElements());
+        finalIsComplete = isCompleteFrame;
+        ++finishCount;
+    }
+};
+
+// Send frames of random photons (12-bit microtime) to proc, each frame as
+// batchesPerFrame batches of batchSize photons, each batch followed by a
+// single photon. The last frame is optionally left incomplete.
+inline void SendRandomFrames(PixelPhotonProcessor &proc, unsigned frames,
+                             bool lastIncomplete, std::size_t width,
+                             std::size_t height, std::size_t batchSize,
+                             unsigned batchesPerFrame) {
+    std::mt19937 rng(7);
+    std::uniform_int_distribution<uint16_t> x(0, uint16_t(width - 1));
+    std::uniform_int_distribution<uint16_t> y(0, uint16_t(height - 1));
+    std::uniform_int_distribution<uint16_t> microtime(0, 4095);
+    std::vector<PixelPhotonEvent> batch(batchSize);
+    for (unsigned f = 0; f < frames; ++f) {
+        proc.HandleBeginFrame();
+        for (unsigned b = 0; b < batchesPerFrame; ++b) {
+            for (auto &e : batch) {
+                e.frame = f;
+                e.x = x(rng);
+                e.y = y(rng);
+                e.microtime = microtime(rng);
+                e.route = 0;
+            }
+            proc.HandlePixelPhotons(batch.data(), batch.size());
+            proc.HandlePixelPhoton(batch[b % batchSize]);
+        }
+        if (!(lastIncomplete && f == frames - 1)) {
+            proc.HandleEndFrame();
+        }
+    }
+    proc.HandleFinish();
+}
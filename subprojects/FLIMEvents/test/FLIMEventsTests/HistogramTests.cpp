@@ -1,6 +1,15 @@
+#define CATCH_CONFIG_ENABLE_BENCHMARKING
 #include "FLIMEvents/Histogram.hpp"
+#include "HistogramTestUtils.hpp"
 #include <catch2/catch.hpp>
 
+#include <algorithm>
+#include <limits>
+#include <map>
+#include <random>
+#include <string>
+#include <vector>
+
 TEST_CASE("TimeBins", "[Histogram]") {
     Histogram<uint16_t> hist(8, 12, false, 1, 1);
     auto data = hist.Get();
@@ -64,3 +73,447 @@ TEST_CASE("SingleTimeBin", "[Histogram]") {
         REQUIRE(data[0] == 2);
     }
 }
+
+namespace {
+
+// Random values, biased towards the top of the range so that many sums
+// saturate
+template <typename T> std::vector<T> MakeAddends(std::size_t n, unsigned seed) {
+    std::mt19937 rng(seed);
+    std::uniform_int_distribution<uint32_t> dist(0, 0xffffffff);
+    std::vector<T> v(n);
+    for (auto &e : v) {
+        uint32_t r = dist(rng);
+        e = static_cast<T>(r & 1 ? r >> 1 : r); // Half below max / 2
+    }
+    return v;
+}
+
+// Check that kernel(dst, src, begin, end) computes saturating add
+template <typename T, typename F> void CheckSaturatingAddKernel(F kernel) {
+    // Odd size to exercise remainder loops
+    std::size_t const n = 1027;
+    auto const a = MakeAddends<T>(n, 1);
+    auto const b = MakeAddends<T>(n, 2);
+    std::vector<T> expected(n);
+    for (std::size_t i = 0; i < n; ++i) {
+        uint64_t sum = uint64_t(a[i]) + b[i];
+        expected[i] = sum > std::numeric_limits<T>::max() || sum < a[i]
+                          ? std::numeric_limits<T>::max()
+                          : static_cast<T>(sum);
+    }
+
+    // Start at unaligned position
+    auto result = a;
+    SaturatingAddArraysScalar(result.data(), b.data(), 0, 1);
+    kernel(result.data(), b.data(), 1, n);
+    REQUIRE(result == expected);
+}
+
+template <typename T> void CheckSaturatingAddKernels() {
+    CheckSaturatingAddKernel<T>([](T *d, T const *s, std::size_t begin,
+                                   std::size_t end) {
+        SaturatingAddArraysScalar(d, s, begin, end);
+    });
+    CheckSaturatingAddKernel<T>([](T *d, T const *s, std::size_t begin,
+                                   std::size_t end) {
+        SaturatingAddArrays(d + begin, s + begin, end - begin);
+    });
+#ifdef FLIMEVENTS_X86_64
+    CheckSaturatingAddKernel<T>([](T *d, T const *s, std::size_t begin,
+                                   std::size_t end) {
+        SaturatingAddArraysSSE2(d, s, begin, end);
+    });
+    if (CPUFeatures::Get().avx2) {
+        CheckSaturatingAddKernel<T>([](T *d, T const *s, std::size_t begin,
+                                       std::size_t end) {
+            SaturatingAddArraysAVX2(d, s, begin, end);
+        });
+    }
+#endif
+}
+
+} // namespace
+
+TEST_CASE("Saturating add kernels", "[Histogram]") {
+    CheckSaturatingAddKernels<uint8_t>();
+    CheckSaturatingAddKernels<uint16_t>();
+    CheckSaturatingAddKernels<uint32_t>();
+    CheckSaturatingAddKernel<uint64_t>([](uint64_t *d, uint64_t const *s,
+                                          std::size_t begin, std::size_t end) {
+        SaturatingAddArrays(d + begin, s + begin, end - begin);
+    });
+}
+
+TEST_CASE("Histogram accumulation saturates", "[Histogram]") {
+    Histogram<uint8_t> hist(0, 12, false, 33, 1);
+    Histogram<uint8_t> frame(0, 12, false, 33, 1);
+    hist.Clear();
+    frame.Clear();
+    for (std::size_t x = 0; x < 33; ++x) {
+        for (std::size_t i = 0; i < x * 8; ++i) {
+            frame.Increment(0, x, 0);
+        }
+    }
+    for (int i = 0; i < 2; ++i) {
+        hist += frame;
+    }
+    for (std::size_t x = 0; x < 33; ++x) {
+        auto expected = std::min<std::size_t>(x * 8 * 2, 255);
+        REQUIRE(hist.Get()[x] == expected);
+    }
+}
+
+TEST_CASE("Histogram accumulation throughput", "[Histogram][!benchmark]") {
+    // 256 x 256 pixels x 256 time bins, as accumulated for each frame
+    Histogram<uint16_t> hist(8, 12, false, 256, 256);
+    Histogram<uint16_t> frame(8, 12, false, 256, 256);
+    hist.Clear();
+    frame.Clear();
+    auto const n = hist.GetNumberOfElements();
+    auto *dst = const_cast<uint16_t *>(hist.Get());
+    auto const *src = frame.Get();
+
+    BENCHMARK("256x256x256 uint16, scalar") {
+        SaturatingAddArraysScalar(dst, src, 0, n);
+        return dst[0];
+    };
+
+    BENCHMARK("256x256x256 uint16, operator+=") {
+        hist += frame;
+        return dst[0];
+    };
+}
+
+TEST_CASE("CumulativeHistogrammer matches Histogrammer with accumulator",
+          "[Histogram]") {
+    // 4x4 pixels, 2 time bins, 8-bit: saturates within a few frames
+    bool const lastIncomplete = GENERATE(false, true);
+    unsigned const frames = GENERATE(0u, 1u, 2u, 40u);
+
+    auto expected = std::make_shared<HistogramRecorder<uint8_t>>();
+    {
+        Histogram<uint8_t> cumul(1, 12, false, 4, 4);
+        cumul.Clear();
+        Histogrammer<uint8_t> reference(
+            Histogram<uint8_t>(1, 12, false, 4, 4),
+            std::make_shared<HistogramAccumulator<uint8_t>>(std::move(cumul),
+                                                            expected));
+        SendRandomFrames(reference, frames, lastIncomplete, 4, 4, 100, 3);
+    }
+
+    auto actual = std::make_shared<HistogramRecorder<uint8_t>>();
+    {
+        Histogram<uint8_t> cumul(1, 12, false, 4, 4);
+        cumul.Clear();
+        CumulativeHistogrammer<uint8_t> proc(std::move(cumul), actual);
+        SendRandomFrames(proc, frames, lastIncomplete, 4, 4, 100, 3);
+    }
+
+    REQUIRE(actual->frames == expected->frames);
+    REQUIRE(actual->finishCount == 1);
+    REQUIRE(actual->finalHistogram == expected->finalHistogram);
+    REQUIRE(actual->finalIsComplete == expected->finalIsComplete);
+    if (frames == 40) {
+        // Test is meaningful only if saturation occurred
+        REQUIRE(std::count(actual->finalHistogram.begin(),
+                           actual->finalHistogram.end(), 255) > 0);
+    }
+}
+
+TEST_CASE("FrameCounts drains all counts", "[Histogram]") {
+    FrameCounts counts(1000);
+    for (int i = 0; i < 600; ++i) {
+        counts.Increment(3); // Wraps twice
+    }
+    counts.Increment(999);
+    counts.Increment(500);
+    counts.Increment(500);
+
+    std::map<std::size_t, uint32_t> drained;
+    auto const add = [&](std::size_t index, uint32_t count) {
+        REQUIRE(count > 0);
+        REQUIRE(count <= 256);
+        drained[index] += count;
+    };
+    counts.Drain(add);
+    REQUIRE(drained == std::map<std::size_t, uint32_t>{
+                           {3, 600}, {500, 2}, {999, 1}});
+
+    // Drained counts are cleared
+    drained.clear();
+    counts.Increment(7);
+    counts.Drain(add);
+    REQUIRE(drained == std::map<std::size_t, uint32_t>{{7, 1}});
+
+    counts.Increment(8);
+    counts.Clear();
+    drained.clear();
+    counts.Drain(add);
+    REQUIRE(drained.empty());
+}
+
+TEST_CASE("SparseHistogram conversion", "[Histogram]") {
+    Histogram<uint8_t> dense(2, 12, false, 3, 2);
+    dense.Clear();
+    dense.Increment(0, 0, 0);
+    dense.Increment(0, 0, 0);
+    dense.Increment(4095, 2, 1);
+    dense.Increment(1024, 1, 0);
+
+    SparseHistogram<uint8_t> sparse;
+    sparse.GatherAll(dense);
+    REQUIRE(sparse.GetIndices() == std::vector<std::size_t>{0, 5, 23});
+    REQUIRE(sparse.GetCounts() == std::vector<uint8_t>{2, 1, 1});
+
+    // Gather from candidate bins, including one that is zero
+    std::vector<std::size_t> candidates{23, 7, 0, 5};
+    SparseHistogram<uint8_t> gathered;
+    gathered.Gather(dense, candidates);
+    REQUIRE(gathered.GetIndices() == sparse.GetIndices());
+    REQUIRE(gathered.GetCounts() == sparse.GetCounts());
+
+    Histogram<uint8_t> roundTrip(2, 12, false, 3, 2);
+    sparse.ToDense(roundTrip);
+    REQUIRE(std::equal(roundTrip.Get(),
+                       roundTrip.Get() + roundTrip.GetNumberOfElements(),
+                       dense.Get()));
+
+    // Adding saturates
+    dense.AddAt(0, 254);
+    sparse.AddTo(dense);
+    REQUIRE(dense.Get()[0] == 255);
+    REQUIRE(dense.Get()[5] == 2);
+    REQUIRE(dense.Get()[1] == 0);
+}
+
+TEST_CASE("Histogrammer switches between sparse and dense frames",
+          "[Histogram]") {
+    // 16x16 pixels, 64 time bins; up to 1024 nonzero bins is sparse
+    std::size_t const size = 16;
+    auto recorder = std::make_shared<HistogramRecorder<uint16_t>>();
+    Histogram<uint16_t> cumul(6, 12, false, size, size);
+    cumul.Clear();
+    auto accumulator = std::make_shared<HistogramAccumulator<uint16_t>>(
+        std::move(cumul), recorder);
+    Histogrammer<uint16_t> proc(Histogram<uint16_t>(6, 12, false, size, size),
+                                accumulator);
+
+    std::mt19937 rng(3);
+    std::uniform_int_distribution<uint16_t> coord(0, size - 1);
+    std::uniform_int_distribution<uint16_t> microtime(0, 4095);
+    std::vector<uint16_t> expectedFrame(64 * size * size);
+    std::vector<uint16_t> expectedCumul(64 * size * size);
+    std::vector<std::vector<uint16_t>> expectedCumulFrames;
+    for (std::size_t photons : {10, 3000, 10, 0, 100, 20000, 5}) {
+        proc.HandleBeginFrame();
+        std::fill(expectedFrame.begin(), expectedFrame.end(), uint16_t(0));
+        std::vector<PixelPhotonEvent> events(photons);
+        for (auto &e : events) {
+            e.frame = 0;
+            e.x = coord(rng);
+            e.y = coord(rng);
+            e.microtime = microtime(rng);
+            e.route = 0;
+            ++expectedFrame[(e.y * size + e.x) * 64 + (e.microtime >> 6)];
+        }
+        proc.HandlePixelPhotons(events.data(), events.size());
+        proc.HandleEndFrame();
+        for (std::size_t i = 0; i < expectedCumul.size(); ++i) {
+            expectedCumul[i] += expectedFrame[i];
+        }
+        expectedCumulFrames.push_back(expectedCumul);
+    }
+    proc.HandleFinish();
+
+    // Sparse frames reach the accumulator in sparse form, but its output is
+    // dense
+    REQUIRE(recorder->sparseFrameCount == 0);
+    REQUIRE(recorder->frames == expectedCumulFrames);
+    REQUIRE(recorder->finalHistogram == expectedCumul);
+
+    auto frameRecorder = std::make_shared<HistogramRecorder<uint16_t>>();
+    Histogrammer<uint16_t> proc2(
+        Histogram<uint16_t>(6, 12, false, size, size), frameRecorder);
+    for (std::size_t photons : {10, 3000, 10}) {
+        proc2.HandleBeginFrame();
+        for (std::size_t i = 0; i < photons; ++i) {
+            PixelPhotonEvent e{};
+            e.x = coord(rng);
+            e.y = coord(rng);
+            e.microtime = microtime(rng);
+            proc2.HandlePixelPhoton(e);
+        }
+        proc2.HandleEndFrame();
+    }
+    REQUIRE(frameRecorder->sparseFrameCount == 2);
+    REQUIRE(frameRecorder->frames.size() == 3);
+}
+
+namespace {
+
+std::vector<PixelPhotonEvent> MakeRandomEvents(std::size_t n,
+                                               uint32_t inputTimeBits,
+                                               std::size_t width,
+                                               std::size_t height) {
+    std::mt19937 rng(11);
+    std::uniform_int_distribution<uint16_t> x(0, uint16_t(width - 1));
+    std::uniform_int_distribution<uint16_t> y(0, uint16_t(height - 1));
+    std::uniform_int_distribution<uint16_t> microtime(
+        0, uint16_t((1u << inputTimeBits) - 1));
+    std::vector<PixelPhotonEvent> events(n);
+    for (auto &e : events) {
+        e.frame = 0;
+        e.x = x(rng);
+        e.y = y(rng);
+        e.microtime = microtime(rng);
+        e.route = 0;
+    }
+    return events;
+}
+
+} // namespace
+
+TEST_CASE("IncrementEvents matches Increment", "[Histogram]") {
+    // (timeBits, inputTimeBits); the last is not specialized
+    auto const bits =
+        GENERATE(std::make_pair(0u, 12u), std::make_pair(6u, 12u),
+                 std::make_pair(8u, 12u), std::make_pair(10u, 12u),
+                 std::make_pair(12u, 12u), std::make_pair(3u, 10u));
+    bool const reverse = GENERATE(false, true);
+    auto const events = MakeRandomEvents(5000, bits.second, 5, 3);
+
+    Histogram<uint8_t> expected(bits.first, bits.second, reverse, 5, 3);
+    expected.Clear();
+    for (auto const &e : events) {
+        expected.Increment(e.microtime, e.x, e.y);
+    }
+
+    Histogram<uint8_t> actual(bits.first, bits.second, reverse, 5, 3);
+    actual.Clear();
+    actual.IncrementEvents(events.data(), events.size());
+
+    REQUIRE(std::equal(actual.Get(),
+                       actual.Get() + actual.GetNumberOfElements(),
+                       expected.Get()));
+    if (bits.first == 0) {
+        // Test covers saturation
+        REQUIRE(std::count(actual.Get(),
+                           actual.Get() + actual.GetNumberOfElements(),
+                           255) > 0);
+    }
+}
+
+TEST_CASE("HistogramIndexer matches GetIndex", "[Histogram]") {
+    auto const bits =
+        GENERATE(std::make_pair(0u, 12u), std::make_pair(8u, 12u),
+                 std::make_pair(3u, 10u));
+    bool const reverse = GENERATE(false, true);
+    Histogram<uint16_t> hist(bits.first, bits.second, reverse, 5, 3);
+    auto const indexer = hist.GetIndexer();
+    for (auto const &e : MakeRandomEvents(1000, bits.second, 5, 3)) {
+        REQUIRE(indexer(e) == hist.GetIndex(e.microtime, e.x, e.y));
+    }
+}
+
+TEST_CASE("Histogram increment throughput", "[Histogram][!benchmark]") {
+    // 12-bit input, 256 time bins, reversed. With 256 x 256 pixels, the
+    // histogram does not fit in cache; with 32 x 32, it fits in L2.
+    std::size_t const size = GENERATE(256u, 32u);
+    Histogram<uint16_t> hist(8, 12, true, size, size);
+    hist.Clear();
+    auto const events = MakeRandomEvents(1 << 20, 12, size, size);
+    std::string const label =
+        std::to_string(size) + "x" + std::to_string(size) + ", 1M photons";
+
+    BENCHMARK(label + ", Increment") {
+        for (auto const &e : events) {
+            hist.Increment(e.microtime, e.x, e.y);
+        }
+        return hist.Get()[0];
+    };
+
+    BENCHMARK(label + ", IncrementEvents") {
+        hist.IncrementEvents(events.data(), events.size());
+        return hist.Get()[0];
+    };
+}
+
+namespace {
+
+// Photons from a line scan, in the order produced by a pixellator: lines in
+// order, x increasing within each line, and microtimes exponentially
+// distributed
+std::vector<PixelPhotonEvent> MakeLineScanEvents(std::size_t photonsPerLine,
+                                                 std::size_t width,
+                                                 std::size_t height) {
+    std::mt19937 rng(13);
+    std::uniform_int_distribution<uint16_t> x(0, uint16_t(width - 1));
+    std::exponential_distribution<double> decay(1.0 / 600.0);
+    std::vector<PixelPhotonEvent> events;
+    events.reserve(photonsPerLine * height);
+    std::vector<uint16_t> xs(photonsPerLine);
+    for (std::size_t y = 0; y < height; ++y) {
+        for (auto &e : xs) {
+            e = x(rng);
+        }
+        std::sort(xs.begin(), xs.end());
+        for (auto xx : xs) {
+            PixelPhotonEvent e{};
+            e.x = xx;
+            e.y = uint16_t(y);
+            e.microtime = uint16_t(std::min(decay(rng), 4095.0));
+            events.push_back(e);
+        }
+    }
+    return events;
+}
+
+// Increment h (256 x 256 pixels, 256 time bins from 12-bit microtimes) with
+// the bin index given by index(bin, x, y)
+template <typename F>
+uint16_t IncrementWithLayout(std::vector<PixelPhotonEvent> const &events,
+                             std::vector<uint16_t> &h, F index) {
+    for (auto const &e : events) {
+        auto &bin = h[index(std::size_t(e.microtime >> 4), e.x, e.y)];
+        bin = SaturatingAdd(bin, uint16_t(1));
+    }
+    return h[0];
+}
+
+} // namespace
+
+// Alternative memory layouts for photons arriving in scan order. Pixel-major
+// (the layout of Histogram) wins: the bins of the pixel being scanned stay in
+// cache, whereas a plane per time bin touches a different cache line for
+// almost every photon, and 8x8 pixel tiles only add index arithmetic. Kept to
+// justify not offering the other layouts.
+TEST_CASE("Histogram layout throughput", "[Histogram][!benchmark]") {
+    std::size_t const size = 256;
+    std::size_t const nBins = 256;
+    auto const events = MakeLineScanEvents(4096, size, size);
+    std::vector<uint16_t> h(nBins * size * size);
+
+    BENCHMARK("Line scan 1M photons, pixel-major") {
+        return IncrementWithLayout(
+            events, h, [=](std::size_t t, std::size_t x, std::size_t y) {
+                return (y * size + x) * nBins + t;
+            });
+    };
+
+    BENCHMARK("Line scan 1M photons, time-major") {
+        return IncrementWithLayout(
+            events, h, [=](std::size_t t, std::size_t x, std::size_t y) {
+                return (t * size + y) * size + x;
+            });
+    };
+
+    BENCHMARK("Line scan 1M photons, 8x8 pixel tiles") {
+        return IncrementWithLayout(
+            events, h, [=](std::size_t t, std::size_t x, std::size_t y) {
+                std::size_t const tile = (y / 8) * (size / 8) + x / 8;
+                std::size_t const pixel = (y % 8) * 8 + x % 8;
+                return (tile * 64 + pixel) * nBins + t;
+            });
+    };
+}
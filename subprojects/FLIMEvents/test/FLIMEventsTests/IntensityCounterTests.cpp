@@ -0,0 +1,35 @@
+#include "FLIMEvents/IntensityCounter.hpp"
+#include "HistogramTestUtils.hpp"
+#include <catch2/catch.hpp>
+
+#include <memory>
+
+TEMPLATE_TEST_CASE("IntensityCounter matches 0-bit Histogrammer",
+                   "[IntensityCounter]", uint8_t, uint16_t) {
+    // 7x5 pixels, 20000 photons per frame; saturates for uint8_t
+    auto expected = std::make_shared<HistogramRecorder<TestType>>();
+    {
+        Histogrammer<TestType> reference(
+            Histogram<TestType>(0, 12, true, 7, 5), expected);
+        SendRandomFrames(reference, 3, true, 7, 5, 20000, 1);
+    }
+
+    auto actual = std::make_shared<HistogramRecorder<TestType>>();
+    {
+        IntensityCounter<TestType> proc(
+            Histogram<TestType>(0, 12, true, 7, 5), actual);
+        SendRandomFrames(proc, 3, true, 7, 5, 20000, 1);
+    }
+
+    REQUIRE(actual->frames.size() == 2);
+    REQUIRE(actual->frames == expected->frames);
+    REQUIRE(actual->finishCount == 1);
+    REQUIRE(actual->finalHistogram == expected->finalHistogram);
+    REQUIRE_FALSE(actual->finalIsComplete);
+}
+
+TEST_CASE("IntensityCounter requires 0 time bits", "[IntensityCounter]") {
+    REQUIRE_THROWS_AS(IntensityCounter<uint16_t>(
+                          Histogram<uint16_t>(1, 12, true, 2, 2), nullptr),
+                      std::invalid_argument);
+}
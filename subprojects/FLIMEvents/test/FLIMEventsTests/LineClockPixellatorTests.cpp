@@ -1,6 +1,10 @@
+#define CATCH_CONFIG_ENABLE_BENCHMARKING
 #include "FLIMEvents/LineClockPixellator.hpp"
 #include <catch2/catch.hpp>
 
+#include <random>
+#include <vector>
+
 TEST_CASE("Frames are produced according to line markers",
           "[LineClockPixellator]") {
     // We could use a mocking framework (e.g. Trompeloeil), but this is simple
@@ -139,3 +143,314 @@ TEST_CASE("Frames are produced according to line markers",
     // photons)
     //   - in particular, line spanning negative time
 }
+
+TEST_CASE("Frames are resynchronized by frame markers",
+          "[LineClockPixellator]") {
+    class FrameRecorder : public PixelPhotonProcessor {
+      public:
+        std::vector<std::string> calls;
+        std::vector<PixelPhotonEvent> pixelPhotons;
+
+        void HandleBeginFrame() override { calls.emplace_back("begin"); }
+
+        void HandleEndFrame() override { calls.emplace_back("end"); }
+
+        void HandlePixelPhoton(PixelPhotonEvent const &event) override {
+            pixelPhotons.emplace_back(event);
+        }
+
+        void HandleError(std::string const &message) override {
+            calls.emplace_back("error");
+        }
+
+        void HandleFinish() override { calls.emplace_back("finish"); }
+    };
+
+    auto output = std::make_shared<FrameRecorder>();
+    // 1x2 frames; line bit 1, frame bit 2; lines every 100 units
+    LineClockPixellator lcp(1, 2, 10, 0, 20, 1, 2, output);
+
+    uint16_t const line = 1 << 1;
+    uint16_t const frame = 1 << 2;
+    auto sendMarker = [&](uint64_t macrotime, uint16_t bits) {
+        MarkerEvent marker;
+        marker.macrotime = macrotime;
+        marker.bits = bits;
+        lcp.HandleMarker(marker);
+    };
+    auto sendPhoton = [&](uint64_t macrotime) {
+        ValidPhotonEvent photon;
+        memset(&photon, 0, sizeof(photon));
+        photon.macrotime = macrotime;
+        lcp.HandleValidPhoton(photon);
+    };
+    auto sendTimestamp = [&](uint64_t macrotime) {
+        DecodedEvent timestamp;
+        timestamp.macrotime = macrotime;
+        lcp.HandleTimestamp(timestamp);
+    };
+
+    SECTION("Lines before first frame marker are discarded") {
+        sendMarker(100, line);
+        sendPhoton(105);
+        sendMarker(200, line | frame);
+        sendPhoton(205);
+        sendMarker(300, line);
+        sendPhoton(305);
+        sendTimestamp(1000);
+        lcp.HandleFinish();
+
+        REQUIRE(output->calls == std::vector<std::string>{
+                                     "begin", "end", "finish"});
+        REQUIRE(output->pixelPhotons.size() == 2);
+        REQUIRE(output->pixelPhotons[0].y == 0);
+        REQUIRE(output->pixelPhotons[1].y == 1);
+        REQUIRE(lcp.GetDroppedLineCount() == 0);
+        REQUIRE(lcp.GetExtraLineCount() == 0);
+    }
+
+    SECTION("Missed line marker ends frame early") {
+        sendMarker(99, frame); // Frame marker may precede line marker
+        sendMarker(100, line);
+        // Second line marker of frame 0 missed
+        sendMarker(300, line | frame);
+        sendPhoton(305);
+        sendMarker(400, line);
+        sendPhoton(405);
+        sendTimestamp(1000);
+        lcp.HandleFinish();
+
+        REQUIRE(output->calls ==
+                std::vector<std::string>{"begin", "end", "begin", "end",
+                                         "finish"});
+        REQUIRE(output->pixelPhotons.size() == 2);
+        REQUIRE(output->pixelPhotons[0].frame == 1);
+        REQUIRE(output->pixelPhotons[0].y == 0);
+        REQUIRE(output->pixelPhotons[1].frame == 1);
+        REQUIRE(output->pixelPhotons[1].y == 1);
+        REQUIRE(lcp.GetDroppedLineCount() == 1);
+        REQUIRE(lcp.GetExtraLineCount() == 0);
+    }
+
+    SECTION("Extra lines are discarded until next frame marker") {
+        sendMarker(100, line | frame);
+        sendMarker(200, line);
+        sendMarker(300, line); // Spurious
+        sendPhoton(305);
+        sendMarker(400, line | frame);
+        sendPhoton(405);
+        lcp.HandleFinish();
+
+        REQUIRE(output->calls ==
+                std::vector<std::string>{"begin", "end", "begin", "finish"});
+        REQUIRE(output->pixelPhotons.size() == 1);
+        REQUIRE(output->pixelPhotons[0].frame == 1);
+        REQUIRE(output->pixelPhotons[0].y == 0);
+        REQUIRE(lcp.GetDroppedLineCount() == 0);
+        REQUIRE(lcp.GetExtraLineCount() == 1);
+    }
+
+    SECTION("Frame marker bit >= 16 means no frame markers") {
+        LineClockPixellator noFrames(1, 2, 10, 0, 20, 1, UINT32_MAX,
+                                     output);
+        MarkerEvent marker;
+        marker.bits = line;
+        marker.macrotime = 100;
+        noFrames.HandleMarker(marker);
+        ValidPhotonEvent photon;
+        memset(&photon, 0, sizeof(photon));
+        photon.macrotime = 105;
+        noFrames.HandleValidPhoton(photon);
+        marker.macrotime = 200;
+        noFrames.HandleMarker(marker);
+        photon.macrotime = 205;
+        noFrames.HandleValidPhoton(photon);
+        DecodedEvent timestamp;
+        timestamp.macrotime = 1000;
+        noFrames.HandleTimestamp(timestamp);
+        noFrames.HandleFinish();
+
+        REQUIRE(output->calls == std::vector<std::string>{
+                                     "begin", "end", "finish"});
+        REQUIRE(output->pixelPhotons.size() == 2);
+        REQUIRE(output->pixelPhotons[1].y == 1);
+    }
+}
+
+TEST_CASE("Bidirectional and nonlinear line scans", "[LineClockPixellator]") {
+    class Recorder : public PixelPhotonProcessor {
+      public:
+        unsigned endFrameCount = 0;
+        std::vector<PixelPhotonEvent> pixelPhotons;
+
+        void HandleBeginFrame() override {}
+        void HandleEndFrame() override { ++endFrameCount; }
+
+        void HandlePixelPhoton(PixelPhotonEvent const &event) override {
+            pixelPhotons.emplace_back(event);
+        }
+
+        void HandleError(std::string const &message) override {}
+        void HandleFinish() override {}
+    };
+
+    auto output = std::make_shared<Recorder>();
+    auto run = [&](LineClockPixellator &lcp,
+                   std::vector<uint64_t> const &photonTimes) {
+        MarkerEvent lineMarker;
+        lineMarker.bits = 1 << 1;
+        lineMarker.macrotime = 100;
+        lcp.HandleMarker(lineMarker);
+        ValidPhotonEvent photon;
+        memset(&photon, 0, sizeof(photon));
+        for (auto mt : photonTimes) {
+            photon.macrotime = mt;
+            lcp.HandleValidPhoton(photon);
+        }
+        DecodedEvent timestamp;
+        timestamp.macrotime = 1000;
+        lcp.HandleTimestamp(timestamp);
+        lcp.Flush();
+    };
+
+    SECTION("Return line follows each line marker, reversed") {
+        // 4x2 frame, lineTime 40: forward [100, 140), return [140, 180)
+        LineScanOptions scan;
+        scan.bidirectional = true;
+        LineClockPixellator lcp(4, 2, 1, 0, 40, 1, 16, scan, output);
+        run(lcp, {100, 139, 140, 155, 179, 180});
+
+        REQUIRE(output->endFrameCount == 1);
+        REQUIRE(output->pixelPhotons.size() == 5);
+        std::vector<std::pair<uint32_t, uint32_t>> xy;
+        for (auto const &p : output->pixelPhotons) {
+            xy.emplace_back(p.x, p.y);
+        }
+        REQUIRE(xy == std::vector<std::pair<uint32_t, uint32_t>>{
+                          {0, 0}, {3, 0}, {3, 1}, {2, 1}, {0, 1}});
+    }
+
+    SECTION("Pixel table with unused times") {
+        LineScanOptions scan;
+        scan.pixelTable = {UINT32_MAX, 0, 0, 1, 1, 1, 1, UINT32_MAX};
+        LineClockPixellator lcp(2, 1, 1, 0, 8, 1, 16, scan, output);
+        run(lcp, {100, 101, 103, 106, 107});
+
+        REQUIRE(output->pixelPhotons.size() == 3);
+        REQUIRE(output->pixelPhotons[0].x == 0);
+        REQUIRE(output->pixelPhotons[1].x == 1);
+        REQUIRE(output->pixelPhotons[2].x == 1);
+    }
+
+    SECTION("Sinusoidal bidirectional") {
+        LineScanOptions scan;
+        scan.bidirectional = true;
+        scan.pixelTable = MakeSinusoidalPixelTable(8, 100, 1.0);
+        LineClockPixellator lcp(8, 2, 1, 0, 100, 1, 16, scan, output);
+        // Forward: center is x = 4; return: mirrored
+        run(lcp, {100, 150, 199, 200, 250, 299});
+
+        REQUIRE(output->pixelPhotons.size() == 6);
+        REQUIRE(output->pixelPhotons[0].x == 0);
+        REQUIRE(output->pixelPhotons[1].x == 4);
+        REQUIRE(output->pixelPhotons[2].x == 7);
+        REQUIRE(output->pixelPhotons[3].x == 7);
+        REQUIRE(output->pixelPhotons[4].x == 3);
+        REQUIRE(output->pixelPhotons[5].x == 0);
+    }
+}
+
+namespace {
+
+class CountingPixelPhotonProcessor : public PixelPhotonProcessor {
+  public:
+    std::size_t photonCount = 0;
+    uint64_t xSum = 0;
+
+    void HandleBeginFrame() override {}
+    void HandleEndFrame() override {}
+
+    void HandlePixelPhoton(PixelPhotonEvent const &event) override {
+        ++photonCount;
+        xSum += event.x;
+    }
+
+    void HandlePixelPhotons(PixelPhotonEvent const *events,
+                            std::size_t count) override {
+        photonCount += count;
+        for (std::size_t i = 0; i < count; ++i) {
+            xSum += events[i].x;
+        }
+    }
+
+    void HandleError(std::string const &message) override {}
+    void HandleFinish() override {}
+};
+
+// Photons (in batches, as sent by decoders) and line markers for frames of
+// the given size, with lineTime 4 * width and photons on average every 2
+// macro-time units.
+struct PixellatorInput {
+    std::vector<std::vector<ValidPhotonEvent>> photonBatches;
+    std::vector<uint64_t> lineMarkerTimes; // Marker precedes batch
+    uint64_t endTime;
+};
+
+PixellatorInput MakePixellatorInput(uint32_t width, uint32_t lines) {
+    std::mt19937 rng(42);
+    std::uniform_int_distribution<unsigned> step(0, 4);
+    PixellatorInput input;
+    uint32_t const lineTime = 4 * width;
+    uint64_t t = 0;
+    for (uint32_t line = 0; line < lines; ++line) {
+        uint64_t const lineStart = uint64_t(line) * (lineTime + 100);
+        input.lineMarkerTimes.push_back(lineStart);
+        std::vector<ValidPhotonEvent> batch;
+        for (t = std::max(t, lineStart); t < lineStart + lineTime + 100;
+             t += step(rng)) {
+            ValidPhotonEvent e;
+            e.macrotime = t;
+            e.microtime = static_cast<uint16_t>(t % 4096);
+            e.route = 0;
+            batch.push_back(e);
+        }
+        input.photonBatches.push_back(std::move(batch));
+    }
+    input.endTime = t + 1;
+    return input;
+}
+
+void RunPixellator(LineClockPixellator &lcp, PixellatorInput const &input) {
+    for (std::size_t i = 0; i < input.lineMarkerTimes.size(); ++i) {
+        MarkerEvent marker;
+        marker.macrotime = input.lineMarkerTimes[i];
+        marker.bits = 1 << 1;
+        lcp.HandleMarker(marker);
+        auto const &batch = input.photonBatches[i];
+        lcp.HandleValidPhotons(batch.data(), batch.size());
+    }
+    DecodedEvent timestamp;
+    timestamp.macrotime = input.endTime;
+    lcp.HandleTimestamp(timestamp);
+    lcp.Flush();
+}
+
+} // namespace
+
+TEST_CASE("Pixellator throughput", "[LineClockPixellator][!benchmark]") {
+    uint32_t const width = 256;
+    uint32_t const height = 256;
+    auto const input = MakePixellatorInput(width, height);
+    std::size_t photonCount = 0;
+    for (auto const &batch : input.photonBatches) {
+        photonCount += batch.size();
+    }
+
+    auto output = std::make_shared<CountingPixelPhotonProcessor>();
+    BENCHMARK("256x256 frame, ~" + std::to_string(photonCount / 1000) +
+              "k photons") {
+        LineClockPixellator lcp(width, height, 1, 0, 4 * width, 1, output);
+        RunPixellator(lcp, input);
+        return output->photonCount;
+    };
+}
@@ -0,0 +1,144 @@
+#include "FLIMEvents/LinePixelMapper.hpp"
+#include <catch2/catch.hpp>
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+namespace {
+
+// Check all t in [0, lineTime) against integer division, through the
+// scalar and batch interfaces and each available kernel
+void CheckExhaustively(uint32_t pixelsPerLine, uint32_t lineTime) {
+    LinePixelMapper mapper(pixelsPerLine, lineTime);
+
+    std::vector<uint32_t> times(lineTime);
+    std::vector<uint32_t> expected(lineTime);
+    for (uint32_t t = 0; t < lineTime; ++t) {
+        times[t] = t;
+        expected[t] = static_cast<uint32_t>(uint64_t(pixelsPerLine) * t /
+                                            lineTime);
+    }
+
+    std::vector<uint32_t> xs(lineTime);
+    bool scalarOk = true;
+    for (uint32_t t = 0; t < lineTime; ++t) {
+        scalarOk = scalarOk && mapper(t) == expected[t];
+    }
+    REQUIRE(scalarOk);
+
+    mapper.Map(times.data(), xs.data(), lineTime);
+    REQUIRE(xs == expected);
+
+    if (mapper.IsVectorized()) {
+        auto const m = mapper.GetMultiplier();
+        auto const s = mapper.GetShift();
+        MapLineTimesToPixelsScalar(times.data(), xs.data(), 0, lineTime, m,
+                                   s);
+        REQUIRE(xs == expected);
+#ifdef FLIMEVENTS_X86_64
+        std::fill(xs.begin(), xs.end(), 0);
+        MapLineTimesToPixelsSSE2(times.data(), xs.data(), 0, lineTime, m, s);
+        REQUIRE(xs == expected);
+        if (CPUFeatures::Get().avx2) {
+            std::fill(xs.begin(), xs.end(), 0);
+            MapLineTimesToPixelsAVX2(times.data(), xs.data(), 0, lineTime, m,
+                                     s);
+            REQUIRE(xs == expected);
+        }
+#endif
+    }
+}
+
+} // namespace
+
+TEST_CASE("LinePixelMapper matches division for small lines",
+          "[LinePixelMapper]") {
+    for (uint32_t ppl : {1u, 2u, 3u, 7u, 64u, 100u, 128u, 256u, 512u}) {
+        for (uint32_t lineTime = 1; lineTime <= 1100; ++lineTime) {
+            CheckExhaustively(ppl, lineTime);
+        }
+    }
+}
+
+TEST_CASE("LinePixelMapper matches division for typical lines",
+          "[LinePixelMapper]") {
+    // Line times (in macro-time units, typically 25 ns) for a range of line
+    // rates and pixel counts used in practice
+    for (uint32_t ppl : {256u, 512u, 1024u, 2048u}) {
+        for (uint32_t lineTime : {1000u, 4095u, 4096u, 4097u, 10240u, 20000u,
+                                  65535u, 65536u, 100000u, 262144u, 400000u}) {
+            CheckExhaustively(ppl, lineTime);
+        }
+    }
+}
+
+TEST_CASE("LinePixelMapper handles long lines", "[LinePixelMapper]") {
+    // ppl * lineTime >= 2^30: not vectorized but still exact
+    LinePixelMapper mapper(4096, 1u << 20);
+    REQUIRE(!mapper.IsVectorized());
+    CheckExhaustively(4096, 1u << 20);
+
+    // Extreme case falls back to division
+    LinePixelMapper extreme(UINT32_MAX, UINT32_MAX);
+    for (uint64_t t : {uint64_t(0), uint64_t(1), uint64_t(12345678),
+                       uint64_t(UINT32_MAX) - 1}) {
+        REQUIRE(extreme(t) == uint64_t(UINT32_MAX) * t / UINT32_MAX);
+    }
+}
+
+TEST_CASE("LinePixelMapper rejects zero line time", "[LinePixelMapper]") {
+    REQUIRE_THROWS_AS(LinePixelMapper(1, 0), std::invalid_argument);
+}
+
+TEST_CASE("LinePixelMapper with table", "[LinePixelMapper]") {
+    std::vector<uint32_t> table{UINT32_MAX, 0, 0, 1, 2, 2, UINT32_MAX};
+    LinePixelMapper mapper(3, 7, table);
+    REQUIRE(mapper.HasTable());
+    REQUIRE(!mapper.IsVectorized());
+
+    std::vector<uint32_t> times{0, 1, 2, 3, 4, 5, 6};
+    std::vector<uint32_t> xs(7);
+    mapper.Map(times.data(), xs.data(), 7);
+    REQUIRE(xs == table);
+    REQUIRE(mapper(3) == 1);
+
+    REQUIRE_THROWS_AS(LinePixelMapper(3, 6, table), std::invalid_argument);
+}
+
+TEST_CASE("Sinusoidal pixel table", "[LinePixelMapper]") {
+    uint32_t const ppl = 64;
+    uint32_t const lineTime = 2500;
+
+    SECTION("Full sweep") {
+        auto table = MakeSinusoidalPixelTable(ppl, lineTime, 1.0);
+        REQUIRE(table.size() == lineTime);
+        REQUIRE(table.front() == 0);
+        REQUIRE(table.back() == ppl - 1);
+        for (uint32_t t = 1; t < lineTime; ++t) {
+            REQUIRE(table[t] >= table[t - 1]);
+        }
+        // Symmetric about the center of the line
+        for (uint32_t t = 0; t < lineTime; ++t) {
+            REQUIRE(table[t] + table[lineTime - 1 - t] == ppl - 1);
+        }
+        // Pixels near the center are shorter than those near the edges
+        auto countX = [&](uint32_t x) {
+            return std::count(table.begin(), table.end(), x);
+        };
+        REQUIRE(countX(ppl / 2) < countX(0));
+    }
+
+    SECTION("Partial fill fraction") {
+        auto table = MakeSinusoidalPixelTable(ppl, lineTime, 0.5);
+        auto const unused = static_cast<std::size_t>(
+            std::count(table.begin(), table.end(), UINT32_MAX));
+        // Outer quarter at each end of the sweep is unused
+        REQUIRE(unused >= lineTime / 2 - 2);
+        REQUIRE(unused <= lineTime / 2 + 2);
+        REQUIRE(table[lineTime / 2] == ppl / 2);
+    }
+
+    REQUIRE_THROWS_AS(MakeSinusoidalPixelTable(ppl, lineTime, 0.0),
+                      std::invalid_argument);
+}
@@ -0,0 +1,112 @@
+#include "FLIMEvents/MeanArrivalTime.hpp"
+#include <catch2/catch.hpp>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace {
+
+class MeanArrivalTimeRecorder : public MeanArrivalTimeProcessor {
+  public:
+    std::vector<std::vector<uint32_t>> frameCounts;
+    std::vector<std::vector<double>> frameMeans;
+    std::vector<uint32_t> finalCounts;
+    bool finalIsComplete = false;
+    unsigned finishCount = 0;
+
+    void HandleError(std::string const &message) override {}
+
+    void HandleFrame(MeanArrivalTimeImage const &image) override {
+        std::size_t const n = image.GetWidth() * image.GetHeight();
+        frameCounts.emplace_back(image.GetCounts(), image.GetCounts() + n);
+        std::vector<double> means;
+        for (std::size_t y = 0; y < image.GetHeight(); ++y) {
+            for (std::size_t x = 0; x < image.GetWidth(); ++x) {
+                means.push_back(image.GetMeanTime(x, y));
+            }
+        }
+        frameMeans.emplace_back(std::move(means));
+    }
+
+    void HandleFinish(MeanArrivalTimeImage &&image,
+                      bool isCompleteFrame) override {
+        std::size_t const n = image.GetWidth() * image.GetHeight();
+        finalCounts.assign(image.GetCounts(), image.GetCounts() + n);
+        finalIsComplete = isCompleteFrame;
+        ++finishCount;
+    }
+};
+
+PixelPhotonEvent MakePhoton(uint16_t x, uint16_t y, uint16_t microtime) {
+    PixelPhotonEvent event{};
+    event.x = x;
+    event.y = y;
+    event.microtime = microtime;
+    return event;
+}
+
+} // namespace
+
+TEST_CASE("Mean arrival time per pixel", "[MeanArrivalTime]") {
+    auto recorder = std::make_shared<MeanArrivalTimeRecorder>();
+    bool const reverse = GENERATE(false, true);
+    MeanArrivalTimeImager proc(MeanArrivalTimeImage(2, 2), 12, reverse,
+                               recorder);
+
+    proc.HandleBeginFrame();
+    std::vector<PixelPhotonEvent> events{
+        MakePhoton(0, 0, 100), MakePhoton(0, 0, 200), MakePhoton(1, 1, 4095)};
+    proc.HandlePixelPhotons(events.data(), events.size());
+    proc.HandlePixelPhoton(MakePhoton(0, 0, 300));
+    proc.HandleEndFrame();
+
+    // Next frame starts from zero
+    proc.HandleBeginFrame();
+    proc.HandlePixelPhoton(MakePhoton(1, 0, 0));
+    proc.HandleEndFrame();
+    proc.HandleFinish();
+
+    REQUIRE(recorder->frameCounts.size() == 2);
+    REQUIRE(recorder->frameCounts[0] == std::vector<uint32_t>{3, 0, 0, 1});
+    REQUIRE(recorder->frameCounts[1] == std::vector<uint32_t>{0, 1, 0, 0});
+    if (reverse) {
+        REQUIRE(recorder->frameMeans[0] ==
+                std::vector<double>{3895.0, 0.0, 0.0, 0.0});
+        REQUIRE(recorder->frameMeans[1] ==
+                std::vector<double>{0.0, 4095.0, 0.0, 0.0});
+    } else {
+        REQUIRE(recorder->frameMeans[0] ==
+                std::vector<double>{200.0, 0.0, 0.0, 4095.0});
+        REQUIRE(recorder->frameMeans[1] ==
+                std::vector<double>{0.0, 0.0, 0.0, 0.0});
+    }
+    REQUIRE(recorder->finishCount == 1);
+    REQUIRE(recorder->finalIsComplete);
+}
+
+TEST_CASE("MeanArrivalTimeAccumulator sums complete frames",
+          "[MeanArrivalTime]") {
+    auto recorder = std::make_shared<MeanArrivalTimeRecorder>();
+    MeanArrivalTimeImage cumul(1, 1);
+    cumul.Clear();
+    auto accumulator = std::make_shared<MeanArrivalTimeAccumulator>(
+        std::move(cumul), recorder);
+    MeanArrivalTimeImager proc(MeanArrivalTimeImage(1, 1), 12, false,
+                               accumulator);
+
+    for (uint16_t t : {10, 30, 1000}) {
+        proc.HandleBeginFrame();
+        proc.HandlePixelPhoton(MakePhoton(0, 0, t));
+        if (t != 1000) {
+            proc.HandleEndFrame();
+        }
+    }
+    proc.HandleFinish();
+
+    REQUIRE(recorder->frameMeans ==
+            std::vector<std::vector<double>>{{10.0}, {20.0}});
+    // Incomplete last frame discarded
+    REQUIRE(recorder->finalCounts == std::vector<uint32_t>{2});
+    REQUIRE(recorder->finalIsComplete);
+}
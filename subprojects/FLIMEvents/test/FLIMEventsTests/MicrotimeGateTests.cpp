@@ -0,0 +1,75 @@
+#include "FLIMEvents/MicrotimeGate.hpp"
+#include <catch2/catch.hpp>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace {
+
+class CallRecorder : public PixelPhotonProcessor {
+  public:
+    std::vector<std::string> calls;
+    std::vector<uint16_t> microtimes;
+
+    void HandleBeginFrame() override { calls.emplace_back("begin"); }
+
+    void HandleEndFrame() override { calls.emplace_back("end"); }
+
+    void HandlePixelPhoton(PixelPhotonEvent const &event) override {
+        calls.emplace_back("photon");
+        microtimes.push_back(event.microtime);
+    }
+
+    void HandlePixelPhotons(PixelPhotonEvent const *events,
+                            std::size_t count) override {
+        calls.emplace_back("photons");
+        for (std::size_t i = 0; i < count; ++i) {
+            microtimes.push_back(events[i].microtime);
+        }
+    }
+
+    void HandleError(std::string const &message) override {
+        calls.emplace_back("error");
+    }
+
+    void HandleFinish() override { calls.emplace_back("finish"); }
+};
+
+PixelPhotonEvent MakePhoton(uint16_t microtime) {
+    PixelPhotonEvent e{};
+    e.microtime = microtime;
+    return e;
+}
+
+} // namespace
+
+TEST_CASE("MicrotimeGate passes photons within gate", "[MicrotimeGate]") {
+    auto recorder = std::make_shared<CallRecorder>();
+    MicrotimeGate gate(100, 200, recorder);
+
+    gate.HandleBeginFrame();
+    gate.HandlePixelPhoton(MakePhoton(99));
+    gate.HandlePixelPhoton(MakePhoton(100));
+    gate.HandlePixelPhoton(MakePhoton(199));
+    gate.HandlePixelPhoton(MakePhoton(200));
+    std::vector<PixelPhotonEvent> batch{MakePhoton(0), MakePhoton(150),
+                                        MakePhoton(4095), MakePhoton(101)};
+    gate.HandlePixelPhotons(batch.data(), batch.size());
+    std::vector<PixelPhotonEvent> rejected{MakePhoton(50), MakePhoton(250)};
+    gate.HandlePixelPhotons(rejected.data(), rejected.size());
+    gate.HandleEndFrame();
+    gate.HandleFinish();
+
+    // A batch with no photons in the gate is not passed on
+    CHECK(recorder->calls ==
+          std::vector<std::string>{"begin", "photon", "photon", "photons",
+                                   "end", "finish"});
+    CHECK(recorder->microtimes == std::vector<uint16_t>{100, 199, 150, 101});
+}
+
+TEST_CASE("MicrotimeGate rejects empty gate", "[MicrotimeGate]") {
+    auto recorder = std::make_shared<CallRecorder>();
+    CHECK_THROWS_AS(MicrotimeGate(200, 200, recorder), std::invalid_argument);
+    CHECK_THROWS_AS(MicrotimeGate(300, 200, recorder), std::invalid_argument);
+}
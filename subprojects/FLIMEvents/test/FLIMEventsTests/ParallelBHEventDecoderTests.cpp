@@ -0,0 +1,98 @@
+#include "FLIMEvents/ParallelBHEventDecoder.hpp"
+#include "BHEventTestUtils.hpp"
+#include <catch2/catch.hpp>
+
+#include <string>
+#include <vector>
+
+namespace {
+
+std::vector<std::string>
+DecodeSerially(std::vector<BHSPCEvent> const &events) {
+    auto recorder = std::make_shared<RecordingProcessor>();
+    BHSPCEventDecoder decoder(recorder);
+    decoder.HandleDeviceEvents(reinterpret_cast<char const *>(events.data()),
+                               events.size());
+    decoder.HandleFinish();
+    return recorder->events;
+}
+
+// Decode in the given number of calls to HandleDeviceEvents()
+std::vector<std::string> DecodeInParallel(std::vector<BHSPCEvent> const &events,
+                                          unsigned numThreads,
+                                          std::size_t minChunkSize,
+                                          std::size_t numCalls) {
+    auto recorder = std::make_shared<RecordingProcessor>();
+    ParallelBHSPCEventDecoder decoder(numThreads, recorder, minChunkSize);
+    auto const data = reinterpret_cast<char const *>(events.data());
+    for (std::size_t i = 0; i < numCalls; ++i) {
+        std::size_t begin = events.size() * i / numCalls;
+        std::size_t end = events.size() * (i + 1) / numCalls;
+        decoder.HandleDeviceEvents(data + begin * sizeof(BHSPCEvent),
+                                   end - begin);
+    }
+    decoder.HandleFinish();
+    return recorder->events;
+}
+
+} // namespace
+
+TEST_CASE("SumMacroTimeOverflows", "[ParallelBHEventDecoder]") {
+    std::vector<BHSPCEvent> events;
+    REQUIRE(SumMacroTimeOverflows(events.data(), 0) == 0);
+
+    events.push_back(MakeEvent(0, 100, 0, 0));
+    events.push_back(MakeEvent(MTOV, 5, 0, 0));
+    events.push_back(MakeEvent(INVALID | MTOV, 3, 0, 0)); // Multiple (3)
+    events.push_back(MakeEvent(INVALID | MTOV | MARK, 7, 0, 0));
+    REQUIRE(SumMacroTimeOverflows(events.data(), events.size()) == 5 * 4096);
+}
+
+TEST_CASE("Parallel decoding matches serial decoding",
+          "[ParallelBHEventDecoder]") {
+    auto events = MakeEventStream(100000, 42);
+    bool expectError = false;
+
+    SECTION("Normal stream") {}
+    SECTION("Decreasing macro-time within a chunk") {
+        events[60000] = MakeEvent(0, 4095, 0, 0);
+        events[60001] = MakeEvent(0, 0, 0, 0);
+        expectError = true;
+    }
+    SECTION("Decreasing macro-time at chunk boundary") {
+        // With 4 chunks of 25000, the second chunk starts at 25000
+        events[24999] = MakeEvent(0, 4095, 0, 0);
+        events[25000] = MakeEvent(0, 0, 0, 0);
+        expectError = true;
+    }
+
+    auto const expected = DecodeSerially(events);
+    REQUIRE(expected.back() ==
+            (expectError ? "E Decreasing macro-time encountered" : "F"));
+
+    REQUIRE(DecodeInParallel(events, 1, 1000, 1) == expected);
+    REQUIRE(DecodeInParallel(events, 4, 1000, 1) == expected);
+    REQUIRE(DecodeInParallel(events, 3, 1000, 7) == expected);
+    REQUIRE(DecodeInParallel(events, 8, 20000, 2) == expected);
+    REQUIRE(DecodeInParallel(events, 0, 1, 3) == expected);
+}
+
+TEST_CASE("Parallel decoding of random streams", "[ParallelBHEventDecoder]") {
+    for (unsigned seed = 1; seed <= 5; ++seed) {
+        auto const events = MakeEventStream(20000, seed);
+        auto const expected = DecodeSerially(events);
+        REQUIRE(DecodeInParallel(events, 4, 256, 3) == expected);
+    }
+}
+
+TEST_CASE("Parallel decoder forwards errors", "[ParallelBHEventDecoder]") {
+    auto recorder = std::make_shared<RecordingProcessor>();
+    ParallelBHSPCEventDecoder decoder(2, recorder);
+    auto const e = MakeEvent(0, 10, 0, 0);
+    decoder.HandleDeviceEvent(reinterpret_cast<char const *>(&e));
+    decoder.HandleError("test");
+    decoder.HandleDeviceEvent(reinterpret_cast<char const *>(&e));
+    decoder.HandleFinish();
+    REQUIRE(recorder->events ==
+            std::vector<std::string>{"P 10 0 0", "E test"});
+}
@@ -0,0 +1,135 @@
+#define CATCH_CONFIG_ENABLE_BENCHMARKING
+#include "FLIMEvents/ParallelHistogrammer.hpp"
+#include "HistogramTestUtils.hpp"
+#include <catch2/catch.hpp>
+
+#include <algorithm>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+std::size_t const width = 16;
+std::size_t const height = 13;
+
+} // namespace
+
+TEST_CASE("ParallelHistogrammer matches Histogrammer",
+          "[ParallelHistogrammer]") {
+    bool const lastIncomplete = GENERATE(false, true);
+    unsigned const numThreads = GENERATE(1u, 3u, 20u);
+    std::size_t const batchSize = GENERATE(1u, 100u, 4096u);
+    unsigned const frames = 3;
+
+    auto expected = std::make_shared<HistogramRecorder<uint16_t>>();
+    {
+        Histogrammer<uint16_t> reference(
+            Histogram<uint16_t>(6, 12, true, width, height), expected);
+        SendRandomFrames(reference, frames, lastIncomplete, width, height,
+                         1000, 5);
+    }
+
+    auto actual = std::make_shared<HistogramRecorder<uint16_t>>();
+    {
+        ParallelHistogrammer<uint16_t> proc(
+            Histogram<uint16_t>(6, 12, true, width, height), numThreads,
+            actual, batchSize);
+        // No more threads than rows
+        REQUIRE(proc.GetNumberOfThreads() ==
+                std::min<std::size_t>(numThreads, height));
+        SendRandomFrames(proc, frames, lastIncomplete, width, height, 1000,
+                         5);
+    }
+
+    REQUIRE(actual->frames.size() == (lastIncomplete ? 2 : 3));
+    REQUIRE(actual->frames == expected->frames);
+    REQUIRE(actual->finishCount == 1);
+    REQUIRE(actual->finalHistogram == expected->finalHistogram);
+    REQUIRE(actual->finalIsComplete == !lastIncomplete);
+    REQUIRE(actual->errors.empty());
+}
+
+TEST_CASE("ParallelHistogrammer forwards error after pending photons",
+          "[ParallelHistogrammer]") {
+    auto output = std::make_shared<HistogramRecorder<uint16_t>>();
+    ParallelHistogrammer<uint16_t> proc(
+        Histogram<uint16_t>(0, 12, false, 2, 2), 2, output);
+
+    proc.HandleBeginFrame();
+    PixelPhotonEvent event{};
+    event.y = 1;
+    proc.HandlePixelPhoton(event);
+    proc.HandleError("test");
+
+    REQUIRE(output->errors == std::vector<std::string>{"test"});
+    REQUIRE(output->frames.empty());
+    REQUIRE(output->finishCount == 0);
+
+    // Nothing is forwarded after error
+    proc.HandleEndFrame();
+    proc.HandleFinish();
+    REQUIRE(output->frames.empty());
+    REQUIRE(output->finishCount == 0);
+}
+
+TEST_CASE("ParallelHistogrammer requires nonempty histogram",
+          "[ParallelHistogrammer]") {
+    REQUIRE_THROWS_AS(ParallelHistogrammer<uint16_t>(
+                          Histogram<uint16_t>(0, 12, false, 2, 0), 2, nullptr),
+                      std::invalid_argument);
+}
+
+namespace {
+
+// One 256x256 frame of photons in scan order (row by row), as produced by
+// the pixellators, delivered in batches
+void SendScanOrderedFrame(PixelPhotonProcessor &proc,
+                          std::vector<PixelPhotonEvent> const &events) {
+    proc.HandleBeginFrame();
+    std::size_t const batchSize = 1024;
+    for (std::size_t i = 0; i < events.size(); i += batchSize) {
+        proc.HandlePixelPhotons(events.data() + i,
+                                std::min(batchSize, events.size() - i));
+    }
+    proc.HandleEndFrame();
+}
+
+} // namespace
+
+TEST_CASE("ParallelHistogrammer throughput on scan-ordered photons",
+          "[ParallelHistogrammer][!benchmark]") {
+    std::size_t const size = 256;
+    std::mt19937 rng(3);
+    std::uniform_int_distribution<uint16_t> microtime(0, 4095);
+    std::vector<PixelPhotonEvent> events;
+    events.reserve(size * size * 16);
+    for (uint16_t y = 0; y < size; ++y) {
+        for (uint16_t x = 0; x < size; ++x) {
+            for (int i = 0; i < 16; ++i) {
+                PixelPhotonEvent e{};
+                e.x = x;
+                e.y = y;
+                e.microtime = microtime(rng);
+                events.push_back(e);
+            }
+        }
+    }
+
+    Histogrammer<uint16_t> single(Histogram<uint16_t>(8, 12, true, size, size),
+                                  nullptr);
+    BENCHMARK("256x256x256, 1M photons, Histogrammer") {
+        SendScanOrderedFrame(single, events);
+    };
+
+    for (unsigned numThreads : {2u, 4u}) {
+        ParallelHistogrammer<uint16_t> parallel(
+            Histogram<uint16_t>(8, 12, true, size, size), numThreads,
+            nullptr);
+        BENCHMARK("256x256x256, 1M photons, ParallelHistogrammer, " +
+                  std::to_string(numThreads) + " threads") {
+            SendScanOrderedFrame(parallel, events);
+        };
+    }
+}
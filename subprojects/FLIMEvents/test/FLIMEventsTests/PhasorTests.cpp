@@ -0,0 +1,118 @@
+#include "FLIMEvents/Phasor.hpp"
+#include <catch2/catch.hpp>
+
+#include <cmath>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace {
+
+class PhasorRecorder : public PhasorProcessor {
+  public:
+    std::vector<std::vector<PhasorPixel>> frames;
+    std::vector<PhasorPixel> finalImage;
+    bool finalIsComplete = false;
+    unsigned finishCount = 0;
+
+    void HandleError(std::string const &message) override {}
+
+    void HandleFrame(PhasorImage const &image) override {
+        frames.emplace_back(image.Get(), image.Get() + image.GetWidth() *
+                                                           image.GetHeight());
+    }
+
+    void HandleFinish(PhasorImage &&image, bool isCompleteFrame) override {
+        finalImage.assign(image.Get(),
+                          image.Get() + image.GetWidth() * image.GetHeight());
+        finalIsComplete = isCompleteFrame;
+        ++finishCount;
+    }
+};
+
+PixelPhotonEvent MakePhoton(uint16_t x, uint16_t y, uint16_t microtime) {
+    PixelPhotonEvent event{};
+    event.x = x;
+    event.y = y;
+    event.microtime = microtime;
+    return event;
+}
+
+} // namespace
+
+TEST_CASE("Phasor coordinates of photons", "[Phasor]") {
+    double const pi = 3.14159265358979323846;
+    auto recorder = std::make_shared<PhasorRecorder>();
+
+    SECTION("Single microtime gives point on unit circle") {
+        uint32_t const harmonic = GENERATE(1u, 2u);
+        bool const reverse = GENERATE(false, true);
+        Phasorizer proc(PhasorImage(2, 1), harmonic, 12, reverse, recorder);
+        proc.HandleBeginFrame();
+        for (int i = 0; i < 3; ++i) {
+            proc.HandlePixelPhoton(MakePhoton(1, 0, 1000));
+        }
+        proc.HandleEndFrame();
+        proc.HandleFinish();
+
+        REQUIRE(recorder->frames.size() == 1);
+        auto const &p = recorder->frames[0][1];
+        REQUIRE(p.count == 3);
+        double const t = reverse ? 4095 - 1000 : 1000;
+        double const phase = 2.0 * pi * harmonic * (t + 0.5) / 4096.0;
+        REQUIRE(p.sumCos / 3 == Approx(std::cos(phase)).margin(1e-6));
+        REQUIRE(p.sumSin / 3 == Approx(std::sin(phase)).margin(1e-6));
+        REQUIRE(recorder->frames[0][0].count == 0);
+        REQUIRE(recorder->finalIsComplete);
+    }
+
+    SECTION("Opposite phases cancel") {
+        PhasorImage image(1, 1);
+        Phasorizer proc(std::move(image), 1, 12, false, recorder);
+        proc.HandleBeginFrame();
+        std::vector<PixelPhotonEvent> events{MakePhoton(0, 0, 100),
+                                             MakePhoton(0, 0, 2148)};
+        proc.HandlePixelPhotons(events.data(), events.size());
+        proc.HandleEndFrame();
+        proc.HandleFinish();
+
+        auto const &p = recorder->finalImage[0];
+        REQUIRE(p.count == 2);
+        REQUIRE(p.sumCos == Approx(0.0).margin(1e-6));
+        REQUIRE(p.sumSin == Approx(0.0).margin(1e-6));
+    }
+
+    SECTION("Invalid arguments") {
+        REQUIRE_THROWS_AS(Phasorizer(PhasorImage(1, 1), 0, 12, false, nullptr),
+                          std::invalid_argument);
+        REQUIRE_THROWS_AS(Phasorizer(PhasorImage(1, 1), 1, 17, false, nullptr),
+                          std::invalid_argument);
+    }
+}
+
+TEST_CASE("PhasorAccumulator sums complete frames", "[Phasor]") {
+    auto recorder = std::make_shared<PhasorRecorder>();
+    PhasorImage cumul(2, 2);
+    cumul.Clear();
+    auto accumulator =
+        std::make_shared<PhasorAccumulator>(std::move(cumul), recorder);
+    Phasorizer proc(PhasorImage(2, 2), 1, 12, false, accumulator);
+
+    for (int f = 0; f < 3; ++f) {
+        proc.HandleBeginFrame();
+        proc.HandlePixelPhoton(MakePhoton(1, 1, 0));
+        if (f < 2) {
+            proc.HandleEndFrame();
+        }
+    }
+    proc.HandleFinish();
+
+    REQUIRE(recorder->frames.size() == 2);
+    REQUIRE(recorder->frames[0][3].count == 1);
+    REQUIRE(recorder->frames[1][3].count == 2);
+    // Incomplete last frame discarded
+    REQUIRE(recorder->finishCount == 1);
+    REQUIRE(recorder->finalIsComplete);
+    REQUIRE(recorder->finalImage[3].count == 2);
+    REQUIRE(recorder->finalImage[0].count == 0);
+}
@@ -0,0 +1,279 @@
+#include "FLIMEvents/PixelClockPixellator.hpp"
+#include <catch2/catch.hpp>
+
+#include <cstring>
+#include <vector>
+
+TEST_CASE("Frames are produced according to pixel markers",
+          "[PixelClockPixellator]") {
+    class MockProcessor : public PixelPhotonProcessor {
+      public:
+        unsigned beginFrameCount;
+        unsigned endFrameCount;
+        std::vector<PixelPhotonEvent> pixelPhotons;
+        std::vector<std::string> errors;
+        unsigned finishCount;
+
+        void Reset() {
+            beginFrameCount = 0;
+            endFrameCount = 0;
+            pixelPhotons.clear();
+            errors.clear();
+            finishCount = 0;
+        }
+
+        void HandleBeginFrame() override { ++beginFrameCount; }
+
+        void HandleEndFrame() override { ++endFrameCount; }
+
+        void HandlePixelPhoton(PixelPhotonEvent const &event) override {
+            pixelPhotons.emplace_back(event);
+        }
+
+        void HandleError(std::string const &message) override {
+            errors.emplace_back(message);
+        }
+
+        void HandleFinish() override { ++finishCount; }
+    };
+
+    auto output = std::make_shared<MockProcessor>();
+    output->Reset();
+
+    uint32_t const pixelBit = 0;
+    uint32_t const lineBit = 1;
+    uint32_t const frameBit = 2;
+    uint32_t const noBit = 16;
+
+    auto sendMarker = [](PixelClockPixellator &pcp, uint64_t macrotime,
+                         uint16_t bits) {
+        MarkerEvent marker;
+        marker.macrotime = macrotime;
+        marker.bits = bits;
+        pcp.HandleMarker(marker);
+    };
+
+    auto sendPhoton = [](PixelClockPixellator &pcp, uint64_t macrotime) {
+        ValidPhotonEvent photon;
+        memset(&photon, 0, sizeof(photon));
+        photon.macrotime = macrotime;
+        pcp.HandleValidPhoton(photon);
+    };
+
+    auto sendTimestamp = [](PixelClockPixellator &pcp, uint64_t macrotime) {
+        DecodedEvent timestamp;
+        timestamp.macrotime = macrotime;
+        pcp.HandleTimestamp(timestamp);
+    };
+
+    SECTION("2x2 frames with no photons") {
+        PixelClockPixellator pcp(2, 2, 10, 0, 10, pixelBit, noBit, noBit,
+                                 output);
+
+        sendMarker(pcp, 100, 1 << pixelBit);
+        pcp.Flush();
+        REQUIRE(output->beginFrameCount == 1);
+        output->Reset();
+
+        for (uint64_t t : {110, 120, 130}) {
+            sendMarker(pcp, t, 1 << pixelBit);
+        }
+        pcp.Flush();
+        REQUIRE(output->beginFrameCount == 0);
+        REQUIRE(output->endFrameCount == 0);
+        output->Reset();
+
+        // Last pixel of frame completes when time passes its end
+        sendTimestamp(pcp, 140);
+        pcp.Flush();
+        REQUIRE(output->beginFrameCount == 0);
+        REQUIRE(output->endFrameCount == 1);
+        output->Reset();
+
+        sendMarker(pcp, 140, 1 << pixelBit);
+        pcp.Flush();
+        REQUIRE(output->beginFrameCount == 1);
+        REQUIRE(output->endFrameCount == 0);
+    }
+
+    SECTION("Photons placed correctly in 2x2 frame") {
+        // Delay = 2, time = 5, so pixels range over [2, 7) relative to their
+        // markers.
+        PixelClockPixellator pcp(2, 2, 1, 2, 5, pixelBit, noBit, noBit,
+                                 output);
+
+        for (uint64_t t : {100, 110, 120, 130}) {
+            sendMarker(pcp, t, 1 << pixelBit);
+        }
+        for (uint64_t t : {101, 102, 106, 107, 112, 124, 136, 137}) {
+            sendPhoton(pcp, t);
+        }
+        sendTimestamp(pcp, 1000);
+        pcp.Flush();
+
+        REQUIRE(output->beginFrameCount == 1);
+        REQUIRE(output->endFrameCount == 1);
+        REQUIRE(output->finishCount == 1);
+        REQUIRE(output->errors.empty());
+        REQUIRE(output->pixelPhotons.size() == 5);
+        std::vector<std::pair<uint32_t, uint32_t>> xy;
+        for (auto const &p : output->pixelPhotons) {
+            REQUIRE(p.frame == 0);
+            xy.emplace_back(p.x, p.y);
+        }
+        REQUIRE(xy == std::vector<std::pair<uint32_t, uint32_t>>{
+                          {0, 0}, {0, 0}, {1, 0}, {0, 1}, {1, 1}});
+    }
+
+    SECTION("Line marker skips rest of line") {
+        PixelClockPixellator pcp(3, 2, 10, 0, 5, pixelBit, lineBit, noBit,
+                                 output);
+
+        // Line 0 has only 2 of 3 pixels
+        sendMarker(pcp, 100, (1 << lineBit) | (1 << pixelBit));
+        sendMarker(pcp, 110, 1 << pixelBit);
+        // Line marker preceding pixel marker
+        sendMarker(pcp, 119, 1 << lineBit);
+        sendMarker(pcp, 120, 1 << pixelBit);
+        sendPhoton(pcp, 121);
+        sendTimestamp(pcp, 200);
+        pcp.Flush();
+
+        REQUIRE(pcp.GetSkippedPixelCount() == 1);
+        REQUIRE(output->pixelPhotons.size() == 1);
+        REQUIRE(output->pixelPhotons[0].x == 0);
+        REQUIRE(output->pixelPhotons[0].y == 1);
+        REQUIRE(output->beginFrameCount == 1);
+        REQUIRE(output->endFrameCount == 0);
+    }
+
+    SECTION("Line marker at complete line does not skip") {
+        PixelClockPixellator pcp(2, 2, 10, 0, 5, pixelBit, lineBit, noBit,
+                                 output);
+
+        for (uint64_t t : {100, 110}) {
+            sendMarker(pcp, t, (t == 100 ? 1 << lineBit : 0) |
+                                   (1 << pixelBit));
+        }
+        sendMarker(pcp, 120, (1 << lineBit) | (1 << pixelBit));
+        sendPhoton(pcp, 121);
+        sendTimestamp(pcp, 200);
+        pcp.Flush();
+
+        REQUIRE(pcp.GetSkippedPixelCount() == 0);
+        REQUIRE(output->pixelPhotons.size() == 1);
+        REQUIRE(output->pixelPhotons[0].x == 0);
+        REQUIRE(output->pixelPhotons[0].y == 1);
+    }
+
+    SECTION("Extra pixel marker does not shift next line") {
+        PixelClockPixellator pcp(2, 2, 10, 0, 5, pixelBit, lineBit, noBit,
+                                 output);
+
+        sendMarker(pcp, 100, (1 << lineBit) | (1 << pixelBit));
+        sendMarker(pcp, 110, 1 << pixelBit);
+        sendMarker(pcp, 120, 1 << pixelBit); // Spurious
+        sendPhoton(pcp, 121);
+        sendMarker(pcp, 130, (1 << lineBit) | (1 << pixelBit));
+        sendPhoton(pcp, 131);
+        sendMarker(pcp, 140, 1 << pixelBit);
+        sendPhoton(pcp, 141);
+        sendTimestamp(pcp, 200);
+        pcp.Flush();
+
+        REQUIRE(pcp.GetExtraPixelCount() == 1);
+        REQUIRE(pcp.GetSkippedPixelCount() == 0);
+        REQUIRE(output->pixelPhotons.size() == 2);
+        REQUIRE(output->pixelPhotons[0].x == 0);
+        REQUIRE(output->pixelPhotons[0].y == 1);
+        REQUIRE(output->pixelPhotons[1].x == 1);
+        REQUIRE(output->pixelPhotons[1].y == 1);
+        REQUIRE(output->beginFrameCount == 1);
+        REQUIRE(output->endFrameCount == 1);
+    }
+
+    SECTION("Extra pixel marker after frame awaits frame marker") {
+        PixelClockPixellator pcp(2, 1, 10, 0, 5, pixelBit, noBit, frameBit,
+                                 output);
+
+        sendMarker(pcp, 100, (1 << frameBit) | (1 << pixelBit));
+        sendMarker(pcp, 110, 1 << pixelBit);
+        sendMarker(pcp, 120, 1 << pixelBit); // Spurious
+        sendPhoton(pcp, 121);
+        sendMarker(pcp, 130, (1 << frameBit) | (1 << pixelBit));
+        sendPhoton(pcp, 131);
+        sendTimestamp(pcp, 200);
+        pcp.Flush();
+
+        REQUIRE(pcp.GetExtraPixelCount() == 1);
+        REQUIRE(pcp.GetSkippedPixelCount() == 0);
+        REQUIRE(output->beginFrameCount == 2);
+        REQUIRE(output->endFrameCount == 1);
+        REQUIRE(output->pixelPhotons.size() == 1);
+        REQUIRE(output->pixelPhotons[0].frame == 1);
+        REQUIRE(output->pixelPhotons[0].x == 0);
+    }
+
+    SECTION("Frame marker ends incomplete frame") {
+        PixelClockPixellator pcp(2, 2, 10, 0, 5, pixelBit, lineBit, frameBit,
+                                 output);
+
+        sendMarker(pcp, 100, (1 << frameBit) | (1 << pixelBit));
+        sendMarker(pcp, 110, 1 << pixelBit);
+        sendMarker(pcp, 120, (1 << lineBit) | (1 << pixelBit));
+        sendMarker(pcp, 130, (1 << frameBit) | (1 << pixelBit));
+        sendPhoton(pcp, 131);
+        sendTimestamp(pcp, 200);
+        pcp.Flush();
+
+        REQUIRE(pcp.GetSkippedPixelCount() == 1);
+        REQUIRE(output->beginFrameCount == 2);
+        REQUIRE(output->endFrameCount == 1);
+        REQUIRE(output->pixelPhotons.size() == 1);
+        REQUIRE(output->pixelPhotons[0].frame == 1);
+        REQUIRE(output->pixelPhotons[0].x == 0);
+        REQUIRE(output->pixelPhotons[0].y == 0);
+    }
+
+    SECTION("Finish after maxFrames") {
+        PixelClockPixellator pcp(1, 1, 2, 0, 5, pixelBit, noBit, noBit,
+                                 output);
+
+        for (uint64_t t : {100, 110, 120, 130}) {
+            sendMarker(pcp, t, 1 << pixelBit);
+            sendPhoton(pcp, t + 1);
+        }
+        sendTimestamp(pcp, 200);
+        pcp.Flush();
+
+        REQUIRE(output->beginFrameCount == 2);
+        REQUIRE(output->endFrameCount == 2);
+        REQUIRE(output->finishCount == 1);
+        REQUIRE(output->pixelPhotons.size() == 2);
+        REQUIRE(output->pixelPhotons[1].frame == 1);
+    }
+
+    SECTION("Overlapping pixels are an error") {
+        PixelClockPixellator pcp(2, 2, 10, 0, 15, pixelBit, noBit, noBit,
+                                 output);
+
+        sendMarker(pcp, 100, 1 << pixelBit);
+        sendMarker(pcp, 110, 1 << pixelBit);
+        sendTimestamp(pcp, 200);
+        pcp.Flush();
+
+        REQUIRE(output->errors.size() == 1);
+    }
+
+    SECTION("Invalid arguments") {
+        REQUIRE_THROWS_AS(PixelClockPixellator(2, 2, 1, 0, 5, noBit, noBit,
+                                               noBit, output),
+                          std::invalid_argument);
+        REQUIRE_THROWS_AS(PixelClockPixellator(2, 2, 1, 0, 5, pixelBit,
+                                               pixelBit, noBit, output),
+                          std::invalid_argument);
+        REQUIRE_THROWS_AS(PixelClockPixellator(2, 2, 1, 0, 0, pixelBit,
+                                               noBit, noBit, output),
+                          std::invalid_argument);
+    }
+}
@@ -0,0 +1,124 @@
+#include "FLIMEvents/PixelPhotonRouter.hpp"
+#include <catch2/catch.hpp>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace {
+
+class CallRecorder : public PixelPhotonProcessor {
+  public:
+    std::vector<std::string> calls;
+    std::vector<uint32_t> photonXs;
+
+    void HandleBeginFrame() override { calls.emplace_back("begin"); }
+
+    void HandleEndFrame() override { calls.emplace_back("end"); }
+
+    void HandlePixelPhoton(PixelPhotonEvent const &event) override {
+        calls.emplace_back("photon");
+        photonXs.push_back(event.x);
+    }
+
+    void HandlePixelPhotons(PixelPhotonEvent const *events,
+                            std::size_t count) override {
+        calls.emplace_back("photons");
+        for (std::size_t i = 0; i < count; ++i) {
+            photonXs.push_back(events[i].x);
+        }
+    }
+
+    void HandleError(std::string const &message) override {
+        calls.emplace_back("error");
+    }
+
+    void HandleFinish() override { calls.emplace_back("finish"); }
+};
+
+// x is used to identify photons
+PixelPhotonEvent MakePhoton(uint16_t route, uint32_t x) {
+    PixelPhotonEvent e{};
+    e.route = route;
+    e.x = x;
+    return e;
+}
+
+} // namespace
+
+TEST_CASE("PixelPhotonRouter routes single photons", "[PixelPhotonRouter]") {
+    auto r0 = std::make_shared<CallRecorder>();
+    auto r2 = std::make_shared<CallRecorder>();
+    PixelPhotonRouter router(r0, nullptr, r2);
+
+    router.HandleBeginFrame();
+    router.HandlePixelPhoton(MakePhoton(0, 10));
+    router.HandlePixelPhoton(MakePhoton(1, 11)); // Null downstream
+    router.HandlePixelPhoton(MakePhoton(2, 12));
+    router.HandlePixelPhoton(MakePhoton(3, 13)); // Beyond downstreams
+    router.HandlePixelPhoton(MakePhoton(100, 14)); // Beyond table
+    router.HandleEndFrame();
+    router.HandleFinish();
+
+    CHECK(r0->calls == std::vector<std::string>{"begin", "photon", "end",
+                                                "finish"});
+    CHECK(r0->photonXs == std::vector<uint32_t>{10});
+    CHECK(r2->photonXs == std::vector<uint32_t>{12});
+}
+
+TEST_CASE("PixelPhotonRouter partitions batches", "[PixelPhotonRouter]") {
+    auto a = std::make_shared<CallRecorder>();
+    auto b = std::make_shared<CallRecorder>();
+    // a serves routes 0 and 2
+    PixelPhotonRouter router(
+        std::vector<std::shared_ptr<PixelPhotonProcessor>>{a, b, a});
+
+    SECTION("Mixed routes") {
+        std::vector<PixelPhotonEvent> batch{
+            MakePhoton(0, 1), MakePhoton(1, 2), MakePhoton(2, 3),
+            MakePhoton(5, 4), MakePhoton(1, 5), MakePhoton(0, 6),
+            MakePhoton(999, 7)};
+        router.HandlePixelPhotons(batch.data(), batch.size());
+
+        CHECK(a->calls == std::vector<std::string>{"photons"});
+        CHECK(a->photonXs == std::vector<uint32_t>{1, 3, 6});
+        CHECK(b->calls == std::vector<std::string>{"photons"});
+        CHECK(b->photonXs == std::vector<uint32_t>{2, 5});
+    }
+
+    SECTION("Single downstream") {
+        std::vector<PixelPhotonEvent> batch{MakePhoton(2, 1), MakePhoton(0, 2),
+                                            MakePhoton(2, 3)};
+        router.HandlePixelPhotons(batch.data(), batch.size());
+
+        CHECK(a->photonXs == std::vector<uint32_t>{1, 2, 3});
+        CHECK(b->calls.empty());
+    }
+
+    SECTION("Only discarded routes") {
+        std::vector<PixelPhotonEvent> batch{MakePhoton(3, 1),
+                                            MakePhoton(15, 2)};
+        router.HandlePixelPhotons(batch.data(), batch.size());
+        router.HandlePixelPhotons(batch.data(), 0);
+
+        CHECK(a->calls.empty());
+        CHECK(b->calls.empty());
+    }
+
+    SECTION("Shared downstream receives frame events once") {
+        router.HandleBeginFrame();
+        router.HandleEndFrame();
+        router.HandleError("test");
+
+        CHECK(a->calls ==
+              std::vector<std::string>{"begin", "end", "error"});
+        CHECK(b->calls ==
+              std::vector<std::string>{"begin", "end", "error"});
+    }
+}
+
+TEST_CASE("PixelPhotonRouter rejects more than 16 routes",
+          "[PixelPhotonRouter]") {
+    std::vector<std::shared_ptr<PixelPhotonProcessor>> downstreams(17);
+    CHECK_THROWS_AS(PixelPhotonRouter(downstreams), std::invalid_argument);
+}
@@ -0,0 +1,68 @@
+#include "FLIMEvents/RingBuffer.hpp"
+#include <catch2/catch.hpp>
+
+TEST_CASE("RingBuffer capacity is power of two", "[RingBuffer]") {
+    REQUIRE(RingBuffer<int>(0).GetCapacity() == 1);
+    REQUIRE(RingBuffer<int>(1).GetCapacity() == 1);
+    REQUIRE(RingBuffer<int>(5).GetCapacity() == 8);
+    REQUIRE(RingBuffer<int>(64).GetCapacity() == 64);
+
+    RingBuffer<int> rb(4);
+    rb.Reserve(9);
+    REQUIRE(rb.GetCapacity() == 16);
+}
+
+TEST_CASE("RingBuffer is FIFO across wrap-around and growth",
+          "[RingBuffer]") {
+    RingBuffer<int> rb(4);
+    REQUIRE(rb.IsEmpty());
+
+    int nextIn = 0;
+    int nextOut = 0;
+    // Push 3, pop 2, repeatedly, so that the contents wrap around the end of
+    // the array and the buffer grows while wrapped
+    for (int round = 0; round < 20; ++round) {
+        for (int i = 0; i < 3; ++i) {
+            rb.PushBack(nextIn++);
+        }
+        REQUIRE(rb.GetSize() == static_cast<std::size_t>(nextIn - nextOut));
+        for (std::size_t i = 0; i < rb.GetSize(); ++i) {
+            REQUIRE(rb[i] == nextOut + static_cast<int>(i));
+        }
+        REQUIRE(rb.Front() == nextOut++);
+        rb.PopFront();
+        rb.PopFront(1);
+        ++nextOut;
+    }
+    REQUIRE(rb.GetCapacity() == 32);
+
+    rb.PopFront(rb.GetSize());
+    REQUIRE(rb.IsEmpty());
+    rb.PushBack(42);
+    REQUIRE(rb.Front() == 42);
+    rb.Clear();
+    REQUIRE(rb.IsEmpty());
+}
+
+TEST_CASE("RingBuffer bulk append", "[RingBuffer]") {
+    RingBuffer<int> rb(4);
+    rb.PushBack(-1);
+    rb.PushBack(-2);
+    rb.PopFront(); // Now head is not at start of array
+
+    int const source[] = {1, 2, 3, 4, 5, 6, 7, 8, 9};
+    rb.PushBack(source, 9, [](int v) { return v * 10; });
+    REQUIRE(rb.GetSize() == 10);
+    REQUIRE(rb[0] == -2);
+    for (int i = 0; i < 9; ++i) {
+        REQUIRE(rb[i + 1] == source[i] * 10);
+    }
+
+    rb.PopFront(8);
+    rb.PushBack(source, 3, [](int v) { return v; });
+    REQUIRE(rb.GetSize() == 5);
+    REQUIRE(rb[0] == 80);
+    REQUIRE(rb[1] == 90);
+    REQUIRE(rb[2] == 1);
+    REQUIRE(rb[4] == 3);
+}
@@ -0,0 +1,70 @@
+#include "FLIMEvents/Histogram.hpp"
+#include "FLIMEvents/SpatialBinner.hpp"
+#include <catch2/catch.hpp>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace {
+
+class HistogramCapture : public HistogramProcessor<uint16_t> {
+  public:
+    std::vector<uint16_t> finalHistogram;
+
+    void HandleError(std::string const &message) override {}
+
+    void HandleFrame(Histogram<uint16_t> const &histogram) override {}
+
+    void HandleFinish(Histogram<uint16_t> &&histogram,
+                      bool isCompleteFrame) override {
+        finalHistogram.assign(histogram.Get(),
+                              histogram.Get() +
+                                  histogram.GetNumberOfElements());
+    }
+};
+
+PixelPhotonEvent MakePhoton(uint32_t x, uint32_t y) {
+    PixelPhotonEvent e{};
+    e.x = x;
+    e.y = y;
+    return e;
+}
+
+} // namespace
+
+TEST_CASE("Binned size rounds up", "[SpatialBinner]") {
+    CHECK(SpatialBinner::GetBinnedSize(256, 1) == 256);
+    CHECK(SpatialBinner::GetBinnedSize(256, 4) == 64);
+    CHECK(SpatialBinner::GetBinnedSize(5, 2) == 3);
+}
+
+TEST_CASE("SpatialBinner sums pixels into bins", "[SpatialBinner]") {
+    // 5 x 3 pixels binned 2 x 2 into 3 x 2 intensity bins
+    auto capture = std::make_shared<HistogramCapture>();
+    Histogram<uint16_t> hist(0, 12, false, SpatialBinner::GetBinnedSize(5, 2),
+                             SpatialBinner::GetBinnedSize(3, 2));
+    hist.Clear();
+    auto histogrammer = std::make_shared<CumulativeHistogrammer<uint16_t>>(
+        std::move(hist), capture);
+    SpatialBinner binner(2, histogrammer);
+
+    binner.HandleBeginFrame();
+    binner.HandlePixelPhoton(MakePhoton(0, 0));
+    binner.HandlePixelPhoton(MakePhoton(1, 1));
+    std::vector<PixelPhotonEvent> batch{MakePhoton(2, 0), MakePhoton(3, 1),
+                                        MakePhoton(4, 2), MakePhoton(4, 0)};
+    binner.HandlePixelPhotons(batch.data(), batch.size());
+    binner.HandleEndFrame();
+    binner.HandleFinish();
+
+    // Input batch is not modified
+    CHECK(batch[2].x == 4);
+    CHECK(batch[2].y == 2);
+    CHECK(capture->finalHistogram ==
+          std::vector<uint16_t>{2, 2, 1, 0, 0, 1});
+}
+
+TEST_CASE("SpatialBinner rejects zero factor", "[SpatialBinner]") {
+    CHECK_THROWS_AS(SpatialBinner(0, nullptr), std::invalid_argument);
+}
@@ -0,0 +1,301 @@
+#define CATCH_CONFIG_ENABLE_BENCHMARKING
+#include "FLIMEvents/MemoryArena.hpp"
+#include "FLIMEvents/StreamBuffer.hpp"
+#include <catch2/catch.hpp>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <future>
+#include <stdexcept>
+#include <vector>
+
+namespace {
+
+// Send count buffers, numbered in their first element, from another thread;
+// return the number of buffers received in order.
+template <typename Stream>
+std::size_t SendAndReceive(Stream &stream, EventBufferPool<int> &pool,
+                           int count) {
+    auto producer = std::async(std::launch::async, [&] {
+        for (int i = 0; i < count; ++i) {
+            auto buf = pool.CheckOut();
+            buf->GetData()[0] = i;
+            buf->SetSize(1);
+            stream.Send(buf);
+        }
+        stream.Send({});
+    });
+
+    std::size_t received = 0;
+    for (;;) {
+        auto buf = stream.ReceiveBlocking();
+        if (!buf) {
+            break;
+        }
+        if (buf->GetData()[0] == static_cast<int>(received)) {
+            ++received;
+        }
+    }
+    producer.get();
+    return received;
+}
+
+// Send a buffer to the other thread and wait for it to be sent back, count
+// times.
+template <typename Stream> void PingPong(EventBufferPool<int> &pool, int count) {
+    Stream ping;
+    Stream pong;
+    auto echo = std::async(std::launch::async, [&] {
+        for (;;) {
+            auto buf = ping.ReceiveBlocking();
+            pong.Send(buf);
+            if (!buf) {
+                break;
+            }
+        }
+    });
+
+    auto buf = pool.CheckOut();
+    for (int i = 0; i < count; ++i) {
+        ping.Send(buf);
+        buf = pong.ReceiveBlocking();
+    }
+    buf.reset();
+    ping.Send({});
+    pong.ReceiveBlocking();
+    echo.get();
+}
+
+} // namespace
+
+TEST_CASE("EventBufferPool reuses buffers", "[EventBufferPool]") {
+    EventBufferPool<int> pool(16, 1);
+    REQUIRE(pool.GetBufferSize() == 16);
+
+    auto a = pool.CheckOut();
+    REQUIRE(a->GetCapacity() == 16);
+    auto b = pool.CheckOut();
+    a.reset();
+    auto c = pool.CheckOut();
+    REQUIRE(c->GetSize() == 0);
+
+    auto stats = pool.GetStats();
+    REQUIRE(stats.allocationCount == 2);
+    REQUIRE(stats.peakOutstandingCount == 2);
+    REQUIRE(stats.blockCount == 0);
+    REQUIRE(stats.dropCount == 0);
+}
+
+TEST_CASE("EventBufferPool max count", "[EventBufferPool]") {
+    SECTION("Drop policy") {
+        EventBufferPool<int> pool(16, 0, 2, EventBufferPoolPolicy::Drop);
+        auto a = pool.CheckOut();
+        auto b = pool.CheckOut();
+        REQUIRE(a);
+        REQUIRE(b);
+        REQUIRE(!pool.CheckOut());
+        b.reset();
+        REQUIRE(pool.CheckOut());
+
+        auto stats = pool.GetStats();
+        REQUIRE(stats.allocationCount == 2);
+        REQUIRE(stats.peakOutstandingCount == 2);
+        REQUIRE(stats.dropCount == 1);
+    }
+
+    SECTION("Block policy") {
+        EventBufferPool<int> pool(16, 0, 1, EventBufferPoolPolicy::Block);
+        auto a = pool.CheckOut();
+        auto waiter = std::async(std::launch::async,
+                                 [&pool] { return pool.CheckOut(); });
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        REQUIRE(waiter.wait_for(std::chrono::seconds(0)) !=
+                std::future_status::ready);
+        a.reset();
+        REQUIRE(waiter.get());
+
+        auto stats = pool.GetStats();
+        REQUIRE(stats.allocationCount == 1);
+        REQUIRE(stats.peakOutstandingCount == 1);
+        REQUIRE(stats.blockCount == 1);
+    }
+
+    SECTION("Cancel wakes blocked CheckOut") {
+        EventBufferPool<int> pool(16, 0, 1, EventBufferPoolPolicy::Block);
+        auto a = pool.CheckOut();
+        auto waiter = std::async(std::launch::async,
+                                 [&pool] { return pool.CheckOut(); });
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        pool.Cancel();
+        REQUIRE(!waiter.get());
+        a.reset();
+        REQUIRE(!pool.CheckOut());
+    }
+
+    SECTION("Initial count exceeding max") {
+        REQUIRE_THROWS_AS(EventBufferPool<int>(16, 3, 2),
+                          std::invalid_argument);
+    }
+}
+
+TEST_CASE("MemoryArena", "[MemoryArena]") {
+    MemoryArena arena(100000, true);
+    REQUIRE(arena.GetSize() >= 100000);
+    auto const data = static_cast<char *>(arena.GetData());
+    REQUIRE(data != nullptr);
+    REQUIRE(data[0] == 0);
+    REQUIRE(data[arena.GetSize() - 1] == 0);
+    data[99999] = 42;
+    REQUIRE(data[99999] == 42);
+}
+
+TEST_CASE("EventBufferPool arena mode", "[EventBufferPool]") {
+    auto const stride = EventBufferPool<int>::GetArenaStride(1000);
+    REQUIRE(stride >= 1000 * sizeof(int));
+    REQUIRE(stride % 64 == 0);
+    auto arena = std::make_shared<MemoryArena>(3 * stride, false);
+    auto const begin = static_cast<char const *>(arena->GetData());
+    auto const end = begin + arena->GetSize();
+    // The arena may be rounded up to hold more buffers
+    auto const arenaCount = arena->GetSize() / stride;
+
+    SECTION("Arena buffers only") {
+        EventBufferPool<int> pool(1000, arena, 3,
+                                  EventBufferPoolPolicy::Drop);
+        REQUIRE(pool.GetArenaBufferCount() == 3);
+
+        auto a = pool.CheckOut();
+        auto b = pool.CheckOut();
+        auto c = pool.CheckOut();
+        REQUIRE(!pool.CheckOut());
+
+        // All buffers are distinct and within the arena
+        std::vector<std::shared_ptr<EventBuffer<int>>> bufs{a, b, c};
+        for (auto const &buf : bufs) {
+            REQUIRE(buf->GetCapacity() == 1000);
+            auto const p = reinterpret_cast<char const *>(buf->GetData());
+            REQUIRE(p >= begin);
+            REQUIRE(p + 1000 * sizeof(int) <= end);
+            REQUIRE(reinterpret_cast<std::uintptr_t>(p) % 64 == 0);
+            std::fill_n(buf->GetData(), 1000, 7);
+        }
+        REQUIRE(std::abs(a->GetData() - b->GetData()) >= 1000);
+        REQUIRE(std::abs(b->GetData() - c->GetData()) >= 1000);
+        REQUIRE(std::abs(a->GetData() - c->GetData()) >= 1000);
+
+        bufs.clear();
+        b.reset();
+        REQUIRE(pool.CheckOut());
+
+        auto stats = pool.GetStats();
+        REQUIRE(stats.allocationCount == 3);
+        REQUIRE(stats.peakOutstandingCount == 3);
+        REQUIRE(stats.dropCount == 1);
+    }
+
+    SECTION("Further buffers allocated on demand") {
+        EventBufferPool<int> pool(1000, arena, arenaCount + 2,
+                                  EventBufferPoolPolicy::Drop);
+        REQUIRE(pool.GetArenaBufferCount() == arenaCount);
+
+        std::vector<std::shared_ptr<EventBuffer<int>>> bufs;
+        for (std::size_t i = 0; i < arenaCount + 2; ++i) {
+            bufs.push_back(pool.CheckOut());
+            REQUIRE(bufs.back());
+        }
+        REQUIRE(!pool.CheckOut());
+        std::size_t inArena = 0;
+        for (auto const &buf : bufs) {
+            auto const p = reinterpret_cast<char const *>(buf->GetData());
+            if (p >= begin && p < end) {
+                ++inArena;
+            }
+        }
+        REQUIRE(inArena == arenaCount);
+        REQUIRE(pool.GetStats().allocationCount == arenaCount + 2);
+    }
+
+    SECTION("Arena smaller than a buffer") {
+        REQUIRE_THROWS_AS(
+            EventBufferPool<int>(arena->GetSize(), arena, 0,
+                                 EventBufferPoolPolicy::Drop),
+            std::invalid_argument);
+    }
+
+    REQUIRE(EventBufferPool<int>(16).GetArenaBufferCount() == 0);
+}
+
+TEST_CASE("SPSCEventStream delivers buffers in order", "[SPSCEventStream]") {
+    EventBufferPool<int> pool(1);
+
+    SECTION("Single thread") {
+        SPSCEventStream<int> stream(4);
+        for (int i = 0; i < 10; ++i) {
+            auto buf = pool.CheckOut();
+            buf->GetData()[0] = i;
+            stream.Send(buf);
+            stream.Send({});
+            REQUIRE(stream.ReceiveBlocking()->GetData()[0] == i);
+            REQUIRE(!stream.ReceiveBlocking());
+        }
+    }
+
+    SECTION("Capacity 1") {
+        SPSCEventStream<int> stream(1);
+        REQUIRE(SendAndReceive(stream, pool, 10000) == 10000);
+    }
+
+    SECTION("Default capacity") {
+        SPSCEventStream<int> stream;
+        REQUIRE(SendAndReceive(stream, pool, 10000) == 10000);
+    }
+}
+
+TEST_CASE("SPSCEventStream forwards exception", "[SPSCEventStream]") {
+    EventBufferPool<int> pool(1);
+    SPSCEventStream<int> stream;
+    stream.Send(pool.CheckOut());
+    stream.SendException(
+        std::make_exception_ptr(std::runtime_error("test error")));
+
+    REQUIRE(stream.ReceiveBlocking());
+    REQUIRE_THROWS_WITH(stream.ReceiveBlocking(), "test error");
+}
+
+TEST_CASE("SPSCEventStream wakes sleeping consumer", "[SPSCEventStream]") {
+    SPSCEventStream<int> stream;
+    auto consumer =
+        std::async(std::launch::async, [&] { return stream.ReceiveBlocking(); });
+    // Give the consumer time to go to sleep
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    stream.SendException(
+        std::make_exception_ptr(std::runtime_error("test error")));
+    REQUIRE_THROWS_WITH(consumer.get(), "test error");
+}
+
+TEST_CASE("SPSCEventStream rejects zero capacity", "[SPSCEventStream]") {
+    REQUIRE_THROWS_AS(SPSCEventStream<int>(0), std::invalid_argument);
+}
+
+TEST_CASE("Event stream handoff", "[SPSCEventStream][!benchmark]") {
+    EventBufferPool<int> pool(1, 1100);
+
+    BENCHMARK("EventStream throughput, 1000 buffers") {
+        EventStream<int> stream;
+        return SendAndReceive(stream, pool, 1000);
+    };
+
+    BENCHMARK("SPSCEventStream throughput, 1000 buffers") {
+        SPSCEventStream<int> stream;
+        return SendAndReceive(stream, pool, 1000);
+    };
+
+    BENCHMARK("EventStream round trip latency, x100") {
+        PingPong<EventStream<int>>(pool, 100);
+    };
+
+    BENCHMARK("SPSCEventStream round trip latency, x100") {
+        PingPong<SPSCEventStream<int>>(pool, 100);
+    };
+}